@@ -5,16 +5,19 @@
 
 #include <unistd.h>
 
+#define FRAMES_IN_FLIGHT 2
+
 Hell hm;
 Onyx orb;
 OnyxSwapchain *swapchain;
 
 OnyxScene* scene;
+WoadRenderer* renderer;
 
 OnyxCommandPool cmdpool;
 
-VkFence     fences[2];
-VkSemaphore rendered_semas[2];
+VkFence     fences[FRAMES_IN_FLIGHT];
+VkSemaphore rendered_semas[FRAMES_IN_FLIGHT];
 
 HellWindow *window;
 
@@ -111,7 +114,7 @@ woad_example_handle_input(const HellEvent* event, void* data)
 static void
 woad_example_frame(i64 fi, i64 dt, void *user_data)
 {
-    u32 f = fi % 2;
+    u32 f = fi % FRAMES_IN_FLIGHT;
     ExampleInterface *ex = user_data;
 
     VkCommandBuffer   cmdbuf = cmdpool.cmdbufs[f];
@@ -129,11 +132,11 @@ woad_example_frame(i64 fi, i64 dt, void *user_data)
     if (ex->update_scene)
         ex->update_scene(scene, fi, dt);
 
-    WoadFrame frame = woad_Frame(&swap_img);
+    WoadFrame frame = woad_Frame(renderer, &swap_img);
 
     onyx_begin_command_buffer(cmdbuf);
 
-    woad_Render(scene, &frame, 0, 0, scwidth, scheight, cmdbuf);
+    woad_Render(renderer, scene, &frame, 0, 0, scwidth, scheight, cmdbuf);
 
     onyx_end_command_buffer(cmdbuf);
 
@@ -175,9 +178,10 @@ woad_example_main(ExampleInterface *ex)
     onyx_create_swapchain(orb.instance->vkinstance, orb.instance->device, orb.instance->physical_device, window, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
                          swapchain);
 
-    woad_Init(orb.instance, orb.memory, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-              VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-              swapchain, ex->enable_ray_tracing ? 0 : WOAD_SETTINGS_NO_RAYTRACE_BIT);
+    renderer = woad_Init(orb.instance, orb.memory, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                         VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                         swapchain, FRAMES_IN_FLIGHT, 1,
+                         ex->enable_ray_tracing ? 0 : WOAD_SETTINGS_NO_RAYTRACE_BIT);
 
     scene = onyx_alloc_scene();
     onyx_create_scene(hm.grimoire, orb.memory, 1, 1, 0.01, 100, scene);
@@ -188,10 +192,10 @@ woad_example_main(ExampleInterface *ex)
     cmdpool = onyx_create_command_pool_(
         orb.device,
         onyx_queue_family_index(orb.instance, ONYX_QUEUE_GRAPHICS_TYPE),
-        VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, 2);
+        VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, FRAMES_IN_FLIGHT);
 
-    onyx_create_fences(orb.device, true, 2, fences);
-    onyx_create_semaphores(orb.device, 2, rendered_semas);
+    onyx_create_fences(orb.device, true, FRAMES_IN_FLIGHT, fences);
+    onyx_create_semaphores(orb.device, FRAMES_IN_FLIGHT, rendered_semas);
 
     hell_subscribe(hm.eventqueue, HELL_EVENT_MASK_POINTER_BIT | HELL_EVENT_MASK_KEY_BIT,
                    hell_get_window_i_d(hm.windows[0]), woad_example_handle_input, NULL);
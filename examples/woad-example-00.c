@@ -39,6 +39,13 @@ static void init_scene_prims(OnyxScene *scene)
 
     assert(!err);
 
+    OnyxGeometry packed;
+    if (woad_PackGeometry(orb.memory, &geo, &packed) == 0)
+    {
+        woad_FreeGeometry(&geo);
+        geo = packed;
+    }
+
     hell_gltf_term(&gltf_data);
 
     CoalMat4 xform = COAL_MAT4_IDENT;
@@ -8,11 +8,73 @@ extern "C" {
 #include <onyx/onyx.h>
 
 typedef enum {
-    WOAD_SETTINGS_NO_RAYTRACE_BIT = 1 << 1
+    WOAD_SETTINGS_NO_RAYTRACE_BIT        = 1 << 1,
+    // one set of gbuffer and shadow images per frame in flight, so the next
+    // frame's gbuffer pass can overlap this frame's lighting
+    WOAD_SETTINGS_PER_FRAME_GBUFFER_BIT  = 1 << 2,
+    // woad_Render records nothing and returns WOAD_RENDER_IDLE when the
+    // swapchain image it is given already shows the current frame
+    WOAD_SETTINGS_ON_DEMAND_BIT          = 1 << 3,
+    // the swapchain image is written with dynamic rendering rather than a
+    // render pass and a framebuffer per image. the device must have the
+    // dynamicRendering and synchronization2 features enabled. single view
+    // only; ignored with view_count above 1.
+    WOAD_SETTINGS_DYNAMIC_RENDERING_BIT  = 1 << 4,
+    // shadow rays trace the first coarser level of detail of packed
+    // geometry, for cheaper blas builds and traversal. close, curved
+    // surfaces may shadow themselves slightly.
+    WOAD_SETTINGS_COARSE_SHADOWS_BIT     = 1 << 5,
+    // lighting is shaded by a compute shader in 16x16 tiles, each gathering
+    // the lights that reach it and skipping background, and stored straight
+    // into the lit image. shades the same as the full screen pass. the lit
+    // image is made in the swapchain format if the device can store to it,
+    // otherwise in VK_FORMAT_R16G16B16A16_SFLOAT. the device must have
+    // shaderStorageImageWriteWithoutFormat enabled.
+    WOAD_SETTINGS_COMPUTE_SHADING_BIT    = 1 << 6,
+    // geometry from woad_PackGeometry is rasterized to a visibility buffer
+    // holding only an instance and triangle per pixel. a compute pass then
+    // fetches the triangle's vertices and evaluates its material once per
+    // pixel, however much was overdrawn. other geometry is drawn into the
+    // gbuffer as usual afterwards. the device must have geometryShader
+    // enabled, for the primitive id in fragment shaders.
+    WOAD_SETTINGS_VISIBILITY_BUFFER_BIT  = 1 << 7,
+    // forward+ in place of the gbuffer: a depth prepass, a compute pass
+    // listing the lights that reach each 16x16 tile, then a pass shading
+    // materials and lights as it draws. there are no gbuffer images to
+    // write and read back, which suits small frames with few lights. with
+    // ray tracing, shadows are traced per pixel with ray queries, so the
+    // device must have rayQuery enabled. the shaded draws test for depth
+    // EQUAL to the prepass's as dynamic state, so the device must also
+    // have extendedDynamicState enabled, or be vulkan 1.3. overrides
+    // WOAD_SETTINGS_COMPUTE_SHADING_BIT and
+    // WOAD_SETTINGS_VISIBILITY_BUFFER_BIT.
+    WOAD_SETTINGS_FORWARD_BIT            = 1 << 8,
 } Woad_Settings_Flags;
 
+typedef enum {
+    // some part of the frame was redrawn
+    WOAD_RENDER_DRAWN,
+    // nothing changed. only the previous lit image was copied into the
+    // swapchain image.
+    WOAD_RENDER_REUSED,
+    // nothing was recorded. the swapchain image is already up to date, so
+    // the caller can skip submitting and present it as is. only returned
+    // with WOAD_SETTINGS_ON_DEMAND_BIT.
+    WOAD_RENDER_IDLE,
+} WoadRenderResult;
+
+// Everything one view needs to render a scene: its attachments, descriptor
+// sets, upload buffers and acceleration structures. Pipelines, layouts and
+// bottom level acceleration structures are shared by every renderer in the
+// process, so a second renderer is cheap. Separate renderers may be driven
+// from separate threads as long as each has its own command buffers and
+// OnyxMemory. Woad serializes its own queue submissions; the caller must do
+// the same for theirs.
+typedef struct WoadRenderer WoadRenderer;
+
 typedef struct WoadFrame {
     VkImageView view;
+    VkImage     image;
     VkFormat    format;
     uint32_t    width;
     uint32_t    height;
@@ -20,21 +82,289 @@ typedef struct WoadFrame {
     uint8_t     index;
 } WoadFrame;
 
+// one eye of a stereo pair or one face of a cube capture
+typedef struct WoadView {
+    CoalMat4 view;
+    CoalMat4 proj;
+} WoadView;
+
 WoadFrame
-woad_Frame(const OnyxSwapchainImage *img);
+woad_Frame(WoadRenderer* renderer, const OnyxSwapchainImage *img);
 
-void
+// frames_in_flight (2 to 4) is the number of woad_Render calls that may be
+// pending on the gpu at once. woad cycles through that many sets of per frame
+// resources, one per woad_Render call, so the caller must wait for the
+// commands recorded frames_in_flight calls ago before recording the next.
+// the shared pipelines and blas cache are allocated from the memory of the
+// renderer that first needs them, so that memory must outlive every renderer.
+//
+// view_count above 1 (up to 6) renders that many views in one pass with
+// multiview, which the device must have enabled. scene updates, culling,
+// command recording and the tlas are done once for all of them. the views
+// are written to the layers of an image returned by woad_GetViewImage,
+// left in finalColorLayout, rather than to the swapchain image.
+WoadRenderer*
 woad_Init(const OnyxInstance* instance, OnyxMemory* memory,
                   VkImageLayout finalColorLayout,
                   VkImageLayout finalDepthLayout,
                   const OnyxSwapchain *swapchain,
+                  uint8_t frames_in_flight,
+                  uint8_t view_count,
                   Woad_Settings_Flags flags);
-void
-woad_Render(const OnyxScene* scene, const WoadFrame *fb, uint32_t x, uint32_t y, uint32_t width,
+
+// only the part of the frame that changed since this frame slot was last
+// rendered is redrawn: the screen area of moved prims, or everything when the
+// camera, lights, materials, textures, prim list, region or swapchain change.
+// the swapchain image itself is always written in full.
+WoadRenderResult
+woad_Render(WoadRenderer* renderer, const OnyxScene* scene, const WoadFrame *fb,
+                  uint32_t x, uint32_t y, uint32_t width,
                   uint32_t height, VkCommandBuffer cmdbuf);
 
+// true when nothing has changed since the last woad_Render, so the image it
+// produced is still current. the caller can skip acquiring, rendering and
+// presenting the frame altogether.
+bool
+woad_IsIdle(const WoadRenderer* renderer, const OnyxScene* scene);
+
+// replaces the scene camera with one camera per view. count must be the
+// view_count given to woad_Init.
+void
+woad_SetViews(WoadRenderer* renderer, uint8_t count, const WoadView* views);
+
+// draws depth with position only shaders before the gbuffer pass, which
+// then only shades the surface in front at each pixel. worth it where
+// prims overlap a lot, since overdrawn fragments no longer fetch their
+// materials or write the gbuffer. off by default and may be switched
+// before any woad_Render. ignored with WOAD_SETTINGS_VISIBILITY_BUFFER_BIT
+// and WOAD_SETTINGS_FORWARD_BIT, which draw depth first already. the
+// gbuffer draws then test for depth EQUAL to the prepass's as dynamic
+// state, so the device must have extendedDynamicState enabled, or be
+// vulkan 1.3. without the prepass nothing needs it.
+void
+woad_SetDepthPrepass(WoadRenderer* renderer, bool enable);
+
+// the layered image the last woad_Render wrote its views to. with a single
+// view this is the image composited into the swapchain image, left in
+// VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+VkImage
+woad_GetViewImage(const WoadRenderer* renderer, VkImageView* view);
+
+typedef enum {
+    // the lit image's texels as they are, a layer per view
+    WOAD_READBACK_RAW,
+    // 8 bit bt.709 limited range luma, then cb and cr interleaved at half
+    // the resolution each way, for video encoders. single view only.
+    WOAD_READBACK_NV12,
+} WoadReadbackFormat;
+
+typedef struct WoadReadback {
+    // persistently mapped host memory
+    const uint8_t* data;
+    VkDeviceSize   size;
+    // the woad_Render that recorded it, counting those that recorded from 1
+    uint64_t       frame;
+    uint32_t       width;
+    uint32_t       height;
+    // the lit image's format, or VK_FORMAT_G8_B8R8_2PLANE_420_UNORM for nv12
+    VkFormat       format;
+    // bytes from one row to the next, of both planes for nv12, whose chroma
+    // plane starts rowPitch times the height rounded up to even bytes in
+    uint32_t       rowPitch;
+    // raw readbacks hold one image per view, layerPitch bytes apart
+    uint32_t       layerCount;
+    VkDeviceSize   layerPitch;
+} WoadReadback;
+
+typedef void (*WoadReadbackFn)(void* user, const WoadReadback* readback);
+
+// copies the lit image of every woad_Render that records into a ring of
+// ring_size persistently mapped host buffers, converted first on the gpu
+// for WOAD_READBACK_NV12. there is no fence to wait on: woad_Render hands
+// each one to callback once its frame is known to have completed, which is
+// frames_in_flight recording calls later, when its frame slot comes round.
+// the data stays valid until the commands of the ring_size -
+// frames_in_flight'th woad_Render after that one are submitted, so encoding
+// a frame overlaps rendering the next ones. ring_size must be greater than
+// frames_in_flight and at most 8. the last frames_in_flight frames are
+// never handed over. a NULL callback stops readbacks. no frame may be in
+// flight.
+void
+woad_SetReadback(WoadRenderer* renderer, uint8_t ring_size,
+                 WoadReadbackFormat format, WoadReadbackFn callback,
+                 void* user);
+
+// a sequence of camera poses of one scene, for turntables and datasets
+typedef struct WoadBatch {
+    uint32_t           count;
+    uint32_t           width;
+    uint32_t           height;
+    // view_count cameras per pose, one pose after another
+    const WoadView*    views;
+    // each pose's readback is handed to callback with its target as user
+    void* const*       targets;
+    WoadReadbackFormat format;
+    WoadReadbackFn     callback;
+} WoadBatch;
+
+// renders every pose of batch and reads each back, keeping
+// frames_in_flight of them on the gpu at once and presenting nothing.
+// woad records, submits and waits on its own command buffers, so the
+// scene must not change meanwhile: it is uploaded, and its tlas built,
+// once for the whole batch. the callback runs on this thread while later
+// poses render, and its readback is only valid until it returns. returns
+// once every pose has been handed over. no frame may be in flight. the
+// readbacks set by woad_SetReadback are started over.
+void
+woad_RenderBatch(WoadRenderer* renderer, const OnyxScene* scene,
+                 const WoadBatch* batch);
+
+void
+woad_Cleanup(WoadRenderer* renderer);
+
+// a copy of src prepared for drawing: triangles reordered for the post
+// transform vertex cache and vertices for fetch locality, then packed.
+// coarser levels of detail are made by quadric error simplification, and
+// woad draws each instance at the coarsest one whose error stays under a
+// pixel. the positions stay float in their own stream, for ray tracing and
+// bounds. normals and tangents become octahedral snorm16 and uvs half
+// floats, interleaved in a second stream. dst is suballocated from large
+// buffers shared by all packed geometry, which woad's pipelines read the
+// vertices from directly, so its draws need no vertex buffer binds.
+// src must be host visible and have float positions, normals and uvs, and
+// optionally tangents with their sign. returns 0 on success.
+int
+woad_PackGeometry(OnyxMemory* memory, const OnyxGeometry* src,
+                  OnyxGeometry* dst);
+
+// frees a geometry's vertex and index regions, packed or not. no frame in
+// flight may still draw it.
+void
+woad_FreeGeometry(OnyxGeometry* geo);
+
+// A versioned on-disk cache of packed meshes and serialized bottom level
+// acceleration structures, so a scene loaded before skips parsing, packing
+// and blas builds. Meshes are keyed by the content of their files, so
+// editing one misses rather than reading stale data; blas are keyed by their
+// mesh and the device, and rebuilt when the driver rejects the stored one.
+// Entries are written as they are first made and never pruned.
+typedef struct WoadSceneCache WoadSceneCache;
+
+// dir must exist. the blas are copied in and out on the graphics queue.
+WoadSceneCache*
+woad_OpenSceneCache(const OnyxInstance* instance, const char* dir);
+
+// no loader or renderer may still use it
+void
+woad_CloseSceneCache(WoadSceneCache* cache);
+
+// blas of geometry a loader with the same cache loaded are read from the
+// cache when the scene changes, and stored in it when built. NULL stops.
+void
+woad_SetSceneCache(WoadRenderer* renderer, WoadSceneCache* cache);
+
+// Loads meshes on worker threads so adding content doesn't stall the frame
+// loop. The workers parse and pack each mesh (see woad_PackGeometry) straight
+// into the host visible geometry blocks, so no upload is needed once a load
+// finishes. The loader owns the geometry it loads until it is destroyed.
+typedef struct WoadLoader WoadLoader;
+
+// the workers allocate from memory. onyx memory isn't thread safe, so it
+// must be the loader's alone. with a cache, which may be NULL, meshes found
+// in it are copied straight into the geometry blocks and the rest are
+// stored once packed.
+WoadLoader*
+woad_CreateLoader(OnyxMemory* memory, WoadSceneCache* cache,
+                  uint32_t workerCount);
+
+// queues the first mesh of the glTF file at path, to be added to the scene
+// with xform and material once it is loaded
+void
+woad_LoadMesh(WoadLoader* loader, const char* path,
+              const OnyxGeometryTemplate* templ, CoalMat4 xform,
+              OnyxMaterialHandle material);
+
+// adds at most maxPrims finished meshes to scene, in the order they
+// finished. call it between frames from the thread that renders the scene;
+// a small maxPrims spreads the blas builds of a large batch over several
+// frames. returns the number of loads not yet published.
+uint32_t
+woad_PublishLoads(WoadLoader* loader, OnyxScene* scene, uint32_t maxPrims);
+
+// drops loads that haven't started, waits for the rest and frees everything
+// loaded. no scene may still hold prims of the loader's geometry, and no
+// frame in flight may still draw them.
+void
+woad_DestroyLoader(WoadLoader* loader);
+
+// what a texture is sampled for, which picks its format. albedo is srgb
+// color with alpha, bc7 or bc1. roughness is one channel, bc4, read from red.
+// normals keep only x and y, bc5, and the shaders rebuild z.
+typedef enum {
+    WOAD_TEXTURE_ALBEDO,
+    WOAD_TEXTURE_ROUGHNESS,
+    WOAD_TEXTURE_NORMAL,
+} WoadTextureRole;
+
+// loads a KTX2 file into a mipmapped image for use as an OnyxTexture and
+// records its upload into cmd, leaving it in
+// VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL. the payload must be bc1, bc4,
+// bc5 or bc7 blocks matching role, with its mips, or uncompressed 8 bit
+// texels, whose mips are made on the gpu. blocks the device can't sample are
+// decoded to the role's uncompressed format, except bc7, which fails.
+// staging holds the texels until cmd has run; the caller frees it with
+// onyx_free_buffer. returns 0 on success.
+int
+woad_LoadTexture(const OnyxInstance* instance, OnyxMemory* memory,
+                 VkCommandBuffer cmd, const char* path, WoadTextureRole role,
+                 OnyxImage* image, OnyxBuffer* staging);
+
+// woad_LoadTexture for width by height rgba8 texels already in memory
+int
+woad_CreateTexture(OnyxMemory* memory, VkCommandBuffer cmd,
+                   const uint8_t* rgba, uint32_t width, uint32_t height,
+                   WoadTextureRole role, OnyxImage* image,
+                   OnyxBuffer* staging);
+
+// Streams the mip levels of KTX2 textures in and out against a device memory
+// budget, so a texture set larger than the device can hold stays sharp where
+// it is looked at. The gbuffer pass records the finest level each bound
+// texture was sampled at; woad_StreamTextures reads that back, loads finer
+// levels on a worker thread, and drops levels of textures that need fewer
+// to make room. A texture's image is replaced in place whenever its levels
+// change, and renderers rebind it. The gbuffer shaders write the feedback
+// from the fragment stage, so the device needs fragmentStoresAndAtomics.
+typedef struct WoadTextureStreamer WoadTextureStreamer;
+
+// budget is the device memory, in bytes, the streamed images may take
+WoadTextureStreamer*
+woad_CreateTextureStreamer(const OnyxInstance* instance, OnyxMemory* memory,
+                           VkDeviceSize budget);
+
+// adds a KTX2 file with its full mip chain, in a format the device samples
+// and woad_LoadTexture uploads as is. only levels of 64 texels and under are
+// resident at first; their upload is recorded into cmd, and the caller
+// frees staging once it has run. the image belongs to the streamer and
+// stays valid until it is destroyed; give it to the scene as a texture.
+// NULL if the file can't be streamed.
+OnyxImage*
+woad_StreamTexture(WoadTextureStreamer* streamer, VkCommandBuffer cmd,
+                   const char* path, WoadTextureRole role,
+                   OnyxBuffer* staging);
+
+// call before each woad_Render, with the command buffer it will record
+// into. publishes finished loads, drops levels to stay in budget and starts
+// new loads, recording the copies into cmd. returns true if it recorded
+// anything, in which case cmd must be submitted even if woad_Render then
+// returns WOAD_RENDER_IDLE. a streamer serves a single renderer.
+bool
+woad_StreamTextures(WoadRenderer* renderer, WoadTextureStreamer* streamer,
+                    const OnyxScene* scene, VkCommandBuffer cmd);
+
+// no frame in flight may still sample its textures, and no scene may still
+// hold them
 void
-woad_Cleanup(void);
+woad_DestroyTextureStreamer(WoadTextureStreamer* streamer);
 
 #ifdef __cplusplus
 }
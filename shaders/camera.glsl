@@ -0,0 +1,12 @@
+// one camera per view. outside of a multiview pass gl_ViewIndex is 0.
+#define MAX_VIEWS 6
+
+struct Camera {
+    mat4 view;
+    mat4 proj;
+    mat4 xform;
+};
+
+layout(set = 0, binding = 0) uniform Cameras {
+    Camera view[MAX_VIEWS];
+} cameras;
@@ -0,0 +1,16 @@
+#version 460
+
+// copies the lit image into the swapchain image. the deferred pass only
+// redraws the dirty part of the lit image, so the rest comes from earlier
+// frames.
+
+layout(location = 0) in  vec2 uv;
+
+layout(location = 0) out vec4 outColor;
+
+layout(set = 1, binding = 6) uniform sampler2DArray litImage;
+
+void main()
+{
+    outColor = texelFetch(litImage, ivec3(gl_FragCoord.xy, 0), 0);
+}
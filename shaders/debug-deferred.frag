@@ -1,5 +1,6 @@
 #version 460
 #extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_multiview : enable
 
 #include "common.glsl"
 #include "frag-common.glsl"
@@ -8,15 +9,16 @@ layout(location = 0) in  vec2 uv;
 
 layout(location = 0) out vec4 outColor;
 
-layout(set = 1, binding = 0, rgba32f) uniform image2D imageWorldP;
-layout(set = 1, binding = 1, rgba32f) uniform image2D imageNormal;
-layout(set = 1, binding = 2, rgba8)   uniform image2D imageAlbedo;
-layout(set = 1, binding = 3, r16ui)   uniform uimage2D imageShadow;
-layout(set = 1, binding = 4, r16)     uniform image2D imageRoughness;
+layout(set = 1, binding = 0, rgba32f) uniform image2DArray imageWorldP;
+layout(set = 1, binding = 1, rgba32f) uniform image2DArray imageNormal;
+layout(set = 1, binding = 2, rgba8)   uniform image2DArray imageAlbedo;
+layout(set = 1, binding = 3, r16ui)   uniform uimage2DArray imageShadow;
+layout(set = 1, binding = 4, r16)     uniform image2DArray imageRoughness;
 
 void main()
 {
-    const ivec2 pixel = ivec2(gl_FragCoord.x, gl_FragCoord.y);
+    const ivec3 pixel = ivec3(gl_FragCoord.x, gl_FragCoord.y, gl_ViewIndex);
+    const Camera camera = cameras.view[gl_ViewIndex];
     const uint shadowMask = imageLoad(imageShadow, pixel).r;
     const vec3 P  = imageLoad(imageWorldP, pixel).xyz;
     const vec3 N  = imageLoad(imageNormal, pixel).xyz;
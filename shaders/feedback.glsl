@@ -0,0 +1,34 @@
+// texture streaming feedback. include after the textures array. shaders
+// without implicit derivatives define FEEDBACK_EXPLICIT_LOD first and pass
+// the level they sampled at themselves.
+
+layout(set = 0, binding = 6) buffer TextureFeedback {
+    // per texture, one more than the log2 of the largest size it was
+    // sampled at. 0 where it wasn't sampled.
+    uint size[];
+} feedback;
+
+// one pixel in each 8x8 tile reports, which is plenty to find the level a
+// texture needs and keeps the atomics cheap
+bool reportsFeedback(uvec2 pixel)
+{
+    return ((pixel.x | pixel.y) & 7) == 0;
+}
+
+// the lod is relative to whatever levels are resident, so it is turned
+// into a size, which isn't
+void requestTextureLod(uint id, float lod)
+{
+    const ivec2 size = textureSize(textures[nonuniformEXT(id)], 0);
+    const float need = ceil(log2(float(max(size.x, size.y))) - lod);
+    atomicMax(feedback.size[id], uint(clamp(need, 0.0, 30.0)) + 1);
+}
+
+#ifndef FEEDBACK_EXPLICIT_LOD
+void requestTexture(uint id, vec2 st)
+{
+    if (!reportsFeedback(uvec2(gl_FragCoord.xy)))
+        return;
+    requestTextureLod(id, textureQueryLod(textures[id], st).y);
+}
+#endif
@@ -0,0 +1,151 @@
+// forward shading: what the gbuffer shaders write and the deferred paths
+// then light, in one fragment shader drawn against the depth prepass. the
+// forward*.frag files pick the vertex layout by defining FORWARD_TANGENT or
+// FORWARD_POS, and trace shadows with ray queries by defining
+// FORWARD_RAY_QUERY. without them nothing is shadowed, as in the deferred
+// paths without ray tracing.
+
+#extension GL_EXT_nonuniform_qualifier : enable
+#extension GL_EXT_multiview : enable
+#ifdef FORWARD_RAY_QUERY
+#extension GL_EXT_ray_query : require
+#endif
+
+#define FORWARD_SHADING
+#include "common.glsl"
+#include "frag-common.glsl"
+#include "shading.glsl"
+
+// must match TILE_SIZE in woad.c
+#define TILE_SIZE 16
+
+#if defined(FORWARD_TANGENT)
+layout(location = 0) in       vec3 worldPos;
+layout(location = 1) in       vec2 uv;
+layout(location = 2) flat in  uint matId;
+layout(location = 3) in       mat3 TBN;
+#elif defined(FORWARD_POS)
+layout(location = 0) in       vec3 worldPos;
+layout(location = 1) flat in  uint matId;
+#else
+layout(location = 0) in       vec3 worldPos;
+layout(location = 1) in       vec3 normal;
+layout(location = 2) in       vec2 uv;
+layout(location = 3) flat in  uint matId;
+#endif
+
+layout(location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 3) uniform sampler2D textures[];
+
+#include "feedback.glsl"
+
+layout(set = 0, binding = 4) readonly buffer Materials {
+    Material mat[];
+} materials;
+
+// the lights lightcull.comp found to reach each tile, a bit per light
+layout(set = 1, binding = 9, r16ui) uniform readonly uimage2DArray imageTileLights;
+
+#ifdef FORWARD_POS
+layout (constant_id = 0) const int SIGN = -1;
+#endif
+
+#ifdef FORWARD_RAY_QUERY
+layout(set = 1, binding = 5) uniform accelerationStructureEXT topLevelAS;
+
+// the ray shadow.rgen traces for the deferred paths, from the surface
+// rather than the gbuffer
+bool unshadowed(Surface s, uint i)
+{
+    const Light light  = lights.light[i];
+    const vec3  origin = s.P + s.N * 0.001;
+    vec3  dir  = light.vector * -1;
+    float tMax = 100;
+    if (light.type == POINT_LIGHT)
+    {
+        dir  = light.vector - origin;
+        tMax = 1;
+    }
+
+    rayQueryEXT query;
+    rayQueryInitializeEXT(query, topLevelAS,
+                          gl_RayFlagsOpaqueEXT | gl_RayFlagsTerminateOnFirstHitEXT,
+                          0xFF, origin, 0.0005, dir, tMax);
+    while (rayQueryProceedEXT(query))
+        ;
+    return rayQueryGetIntersectionTypeEXT(query, true) ==
+           gl_RayQueryCommittedIntersectionNoneEXT;
+}
+#else
+bool unshadowed(Surface s, uint i)
+{
+    return true;
+}
+#endif
+
+void main()
+{
+    const Material mat = materials.mat[matId];
+    Surface s;
+    s.P = worldPos;
+
+#ifdef FORWARD_POS
+    s.albedo    = vec3(mat.r, mat.g, mat.b);
+    s.roughness = mat.roughness;
+    vec3 tanget = dFdx(worldPos);
+    vec3 bitang = SIGN * dFdy(worldPos);
+    s.N = normalize(cross(bitang, tanget));
+#else
+    const vec2 st = vec2(uv.x, -uv.y + 1);
+
+    if (mat.textureAlbedo > 0)
+    {
+        s.albedo = texture(textures[mat.textureAlbedo], st).rgb;
+        requestTexture(mat.textureAlbedo, st);
+    }
+    else
+        s.albedo = vec3(mat.r, mat.g, mat.b);
+
+    if (mat.textureRoughness > 0)
+    {
+        s.roughness = texture(textures[mat.textureRoughness], st).r;
+        requestTexture(mat.textureRoughness, st);
+    }
+    else
+        s.roughness = mat.roughness;
+
+#ifdef FORWARD_TANGENT
+    vec3 normal = vec3(0, 0, 1);
+    if (mat.textureNormal > 0)
+    {
+        // normal maps may be two channel, so z is rebuilt from x and y
+        normal.xy = texture(textures[mat.textureNormal], st).xy * 2.0 - 1.0;
+        requestTexture(mat.textureNormal, st);
+        normal.z  = sqrt(max(1.0 - dot(normal.xy, normal.xy), 0.0));
+    }
+    s.N = normalize(TBN * normal);
+#else
+    s.N = normalize(normal);
+#endif
+#endif
+
+    const Camera camera = cameras.view[gl_ViewIndex];
+    const vec3 campos = vec3(camera.xform[3][0], camera.xform[3][1], camera.xform[3][2]);
+    s.eyeDir = normalize(campos - s.P);
+
+    // the tile's lights stand in for the shadow mask, which the rays then
+    // narrow down per pixel
+    const ivec3 tile = ivec3(ivec2(gl_FragCoord.xy) / TILE_SIZE, gl_ViewIndex);
+    s.shadowMask = imageLoad(imageTileLights, tile).r;
+
+    vec3 diffuse  = vec3(0);
+    vec3 specular = vec3(0);
+    for (uint i = 0; i < MAX_LIGHTS; i++)
+    {
+        if (litBy(s, i) && unshadowed(s, i))
+            addLight(s, i, diffuse, specular);
+    }
+
+    outColor = finishShading(s, diffuse, specular);
+}
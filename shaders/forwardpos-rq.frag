@@ -0,0 +1,7 @@
+#version 460
+#extension GL_GOOGLE_include_directive : enable
+
+#define FORWARD_POS
+#define FORWARD_RAY_QUERY
+
+#include "forward.glsl"
@@ -0,0 +1,6 @@
+#version 460
+#extension GL_GOOGLE_include_directive : enable
+
+#define FORWARD_POS
+
+#include "forward.glsl"
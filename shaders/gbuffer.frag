@@ -16,22 +16,34 @@ layout(location = 3) out float outRoughness;
 
 layout(set = 0, binding = 3) uniform sampler2D textures[];
 
-layout(set = 0, binding = 4) uniform Materials {
-    Material mat[14];
+#include "feedback.glsl"
+
+layout(set = 0, binding = 4) readonly buffer Materials {
+    Material mat[];
 } materials;
 
+// the maps any material drawn with this pipeline has. woad.c leaves out
+// those none of them do, so their checks fold away.
+layout(constant_id = 0) const uint MATERIAL_MAPS = ALBEDO_MAP | ROUGHNESS_MAP;
+
 void main()
 {
     const vec2 st = vec2(uv.x, -uv.y + 1);
     const Material mat = materials.mat[matId];
 
-    if (mat.textureAlbedo > 0)
-        outAlbedo    = texture(textures[mat.textureAlbedo], st);
+    if ((MATERIAL_MAPS & ALBEDO_MAP) > 0 && mat.textureAlbedo > 0)
+    {
+        outAlbedo = texture(textures[mat.textureAlbedo], st);
+        requestTexture(mat.textureAlbedo, st);
+    }
     else
         outAlbedo = vec4(mat.r, mat.g, mat.b, 1);
 
-    if (mat.textureRoughness > 0)
+    if ((MATERIAL_MAPS & ROUGHNESS_MAP) > 0 && mat.textureRoughness > 0)
+    {
         outRoughness = texture(textures[mat.textureRoughness], st).r;
+        requestTexture(mat.textureRoughness, st);
+    }
     else
         outRoughness = mat.roughness;
 
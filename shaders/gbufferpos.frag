@@ -14,8 +14,8 @@ layout(location = 3) out float outRoughness;
 
 layout(set = 0, binding = 3) uniform sampler2D textures[];
 
-layout(set = 0, binding = 4) uniform Materials {
-    Material mat[14];
+layout(set = 0, binding = 4) readonly buffer Materials {
+    Material mat[];
 } materials;
 
 layout (constant_id = 0) const int SIGN = -1;
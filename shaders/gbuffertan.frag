@@ -16,30 +16,44 @@ layout(location = 3) out float outRoughness;
 
 layout(set = 0, binding = 3) uniform sampler2D textures[];
 
-layout(set = 0, binding = 4) uniform Materials {
-    Material mat[14];
+#include "feedback.glsl"
+
+layout(set = 0, binding = 4) readonly buffer Materials {
+    Material mat[];
 } materials;
 
+// the maps any material drawn with this pipeline has. woad.c leaves out
+// those none of them do, so their checks fold away.
+layout(constant_id = 0) const uint MATERIAL_MAPS = ALBEDO_MAP | ROUGHNESS_MAP | NORMAL_MAP;
+
 void main()
 {
     const vec2 st = vec2(uv.x, -uv.y + 1);
     const Material mat = materials.mat[matId];
 
-    if (mat.textureAlbedo > 0)
-        outAlbedo    = texture(textures[mat.textureAlbedo], st);
+    if ((MATERIAL_MAPS & ALBEDO_MAP) > 0 && mat.textureAlbedo > 0)
+    {
+        outAlbedo = texture(textures[mat.textureAlbedo], st);
+        requestTexture(mat.textureAlbedo, st);
+    }
     else
         outAlbedo = vec4(mat.r, mat.g, mat.b, 1);
 
-    if (mat.textureRoughness > 0)
+    if ((MATERIAL_MAPS & ROUGHNESS_MAP) > 0 && mat.textureRoughness > 0)
+    {
         outRoughness = texture(textures[mat.textureRoughness], st).r;
+        requestTexture(mat.textureRoughness, st);
+    }
     else
         outRoughness = mat.roughness;
 
     vec3 normal = vec3(0, 0, 1);
-    if (mat.textureNormal > 0)
+    if ((MATERIAL_MAPS & NORMAL_MAP) > 0 && mat.textureNormal > 0)
     {
-        normal = texture(textures[mat.textureNormal], st).xyz;
-        normal = normal * 2.0 - 1.0;
+        // normal maps may be two channel, so z is rebuilt from x and y
+        normal.xy = texture(textures[mat.textureNormal], st).xy * 2.0 - 1.0;
+        requestTexture(mat.textureNormal, st);
+        normal.z  = sqrt(max(1.0 - dot(normal.xy, normal.xy), 0.0));
     }
     outNormal = vec4(normalize(TBN * normal), 1);
 
@@ -0,0 +1,57 @@
+// the instance table and the geometry blocks packed vertices live in,
+// shared by the vertex shaders and the visibility resolve
+
+// one per drawn prim. draws pass their slot as the first instance, so
+// recorded draws stay valid while prims move.
+struct DrawInstance {
+    mat4 xform;
+    uint matId;
+    uint primId;
+    // packed geometry only, see blockPos
+    uint vertexBlock;
+    uint positionOffset;
+    uint attributeOffset;
+    // where the indices of the level being drawn start, and the words per
+    // vertex of the attribute stream
+    uint indexOffset;
+    uint attributeStride;
+};
+
+layout(set = 0, binding = 1) readonly buffer DrawInstances {
+    DrawInstance draw[];
+} instances;
+
+// must match MAX_GEOMETRY_BLOCKS in geometry.h
+#define MAX_GEOMETRY_BLOCKS 16
+
+// the buffers woad_PackGeometry places geometry in
+layout(set = 0, binding = 5) readonly buffer GeometryBlock {
+    uint words[];
+} geometryBlocks[MAX_GEOMETRY_BLOCKS];
+
+// packed vertices are pulled from the instance's block: float positions,
+// then the rest interleaved, stride words per vertex
+vec3 blockPos(const DrawInstance inst, uint vertex)
+{
+    const uint w = inst.positionOffset + vertex * 3u;
+    return uintBitsToFloat(uvec3(geometryBlocks[inst.vertexBlock].words[w],
+                                 geometryBlocks[inst.vertexBlock].words[w + 1],
+                                 geometryBlocks[inst.vertexBlock].words[w + 2]));
+}
+
+uint blockAttribute(const DrawInstance inst, uint vertex, uint stride, uint i)
+{
+    return geometryBlocks[inst.vertexBlock]
+        .words[inst.attributeOffset + vertex * stride + i];
+}
+
+// normals and tangents from woad_PackGeometry are octahedral, folded onto
+// the xy plane
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0,
+                                        n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
@@ -8,3 +8,9 @@ struct Material {
     uint  textureNormal;
     uint  padding;
 };
+
+// the maps a material may sample, as bits of the MATERIAL_MAPS the gbuffer
+// shaders are specialized by. must match woad.c.
+#define ALBEDO_MAP    0x1
+#define ROUGHNESS_MAP 0x2
+#define NORMAL_MAP    0x4
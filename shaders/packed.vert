@@ -0,0 +1,28 @@
+#version 460
+#extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_multiview : enable
+
+#include "vert-common.glsl"
+
+// the layout woad_PackGeometry writes, see regular.vert for the float one.
+// each vertex is an octahedral snorm16 normal and a half uv.
+
+layout(location = 0) out vec3 outWorldPos;
+layout(location = 1) out vec3 outNormal;
+layout(location = 2) out vec2 outUv;
+layout(location = 3) out uint outMatId;
+
+void main()
+{
+    const Camera camera = cameras.view[gl_ViewIndex];
+    const DrawInstance inst = instances.draw[gl_InstanceIndex];
+    const vec3 pos = pulledPos(inst);
+    const vec2 octNorm = unpackSnorm2x16(pulledAttribute(inst, 2, 0));
+    const vec2 uvw = unpackHalf2x16(pulledAttribute(inst, 2, 1));
+    vec4 worldPos = inst.xform * vec4(pos, 1.0);
+    gl_Position = camera.proj * camera.view * worldPos;
+    outWorldPos = worldPos.xyz;
+    outNormal = normalize((inst.xform * vec4(octDecode(octNorm), 0.0)).xyz);
+    outUv = uvw.st;
+    outMatId = inst.matId;
+}
@@ -0,0 +1,17 @@
+#version 460
+#extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_multiview : enable
+
+#include "vert-common.glsl"
+
+// the depth prepass of packed geometry, see pos.vert for the float one.
+// only the position is pulled, and it is transformed exactly as
+// packed.vert does.
+
+void main()
+{
+    const Camera camera = cameras.view[gl_ViewIndex];
+    const DrawInstance inst = instances.draw[gl_InstanceIndex];
+    vec4 worldPos = inst.xform * vec4(pulledPos(inst), 1.0);
+    gl_Position = camera.proj * camera.view * worldPos;
+}
@@ -0,0 +1,39 @@
+#version 460
+#extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_multiview : enable
+
+// the layout woad_PackGeometry writes, see tangent.vert for the float one.
+// each vertex is an octahedral snorm16 normal and tangent, the float
+// bitangent sign and a half uv.
+
+layout(location = 0) out vec3 outWorldPos;
+layout(location = 1) out vec2 outUv;
+layout(location = 2) out uint outMatId;
+layout(location = 3) out mat3 outTBN;
+
+#include "vert-common.glsl"
+
+void main()
+{
+    const Camera camera = cameras.view[gl_ViewIndex];
+    const DrawInstance inst = instances.draw[gl_InstanceIndex];
+    const mat4 xform = inst.xform;
+    const vec3 pos = pulledPos(inst);
+    const vec2 octNorm = unpackSnorm2x16(pulledAttribute(inst, 4, 0));
+    const vec2 octTangent = unpackSnorm2x16(pulledAttribute(inst, 4, 1));
+    const float sign = uintBitsToFloat(pulledAttribute(inst, 4, 2));
+    const vec2 uvw = unpackHalf2x16(pulledAttribute(inst, 4, 3));
+    const vec4 worldPos = xform * vec4(pos, 1.0);
+    gl_Position = camera.proj * camera.view * worldPos;
+    const vec3 norm = octDecode(octNorm);
+    const vec3 tangent = octDecode(octTangent);
+    vec3 bitangent = sign * normalize(cross(norm, tangent));
+    vec3 T = normalize(vec3(xform * vec4(tangent, 0)));
+    vec3 B = normalize(vec3(xform * vec4(bitangent, 0)));
+    vec3 N = normalize(vec3(xform * vec4(norm, 0)));
+
+    outWorldPos = worldPos.xyz;
+    outUv = uvw.st;
+    outMatId = inst.matId;
+    outTBN = mat3(T, B, N);
+}
@@ -1,5 +1,6 @@
 #version 460
 #extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_multiview : enable
 
 #include "vert-common.glsl"
 
@@ -10,9 +11,11 @@ layout(location = 1) out uint outMatId;
 
 void main()
 {
+    const Camera camera = cameras.view[gl_ViewIndex];
+    const DrawInstance inst = instances.draw[gl_InstanceIndex];
     vec3 p = pos;
-    vec4 worldPos = push.xform * vec4(p, 1.0);
+    vec4 worldPos = inst.xform * vec4(p, 1.0);
     gl_Position = camera.proj * camera.view * worldPos;
     outWorldPos = worldPos.xyz; 
-    outMatId = push.matId;
+    outMatId = inst.matId;
 }
@@ -1,5 +1,6 @@
 #version 460
 #extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_multiview : enable
 
 #include "vert-common.glsl"
 
@@ -14,10 +15,12 @@ layout(location = 3) out uint outMatId;
 
 void main()
 {
-    vec4 worldPos = push.xform * vec4(pos, 1.0);
+    const Camera camera = cameras.view[gl_ViewIndex];
+    const DrawInstance inst = instances.draw[gl_InstanceIndex];
+    vec4 worldPos = inst.xform * vec4(pos, 1.0);
     gl_Position = camera.proj * camera.view * worldPos;
     outWorldPos = worldPos.xyz; 
-    outNormal = normalize((push.xform * vec4(norm, 0.0)).xyz); // this is fine as long as we only allow uniform scales
+    outNormal = normalize((inst.xform * vec4(norm, 0.0)).xyz); // this is fine as long as we only allow uniform scales
     outUv = uvw.st;
-    outMatId = push.matId;
+    outMatId = inst.matId;
 }
@@ -0,0 +1,98 @@
+// the lighting of both deferred paths, the full screen deferred.frag and
+// the tiled deferred.comp, and of forward.glsl, so they shade alike. needs
+// common.glsl, camera.glsl and lights.glsl included first. forward shading
+// defines FORWARD_SHADING, as it has no gbuffer to load surfaces from.
+
+// woad.c specializes the deferred paths to the scene's lights, so the
+// light loop has a fixed count and each light's type is known. a count
+// over MAX_LIGHTS leaves both to be read at run time, as forward.glsl
+// does. without shadows every light reaches every pixel.
+layout(constant_id = 1) const uint LIGHT_COUNT = MAX_LIGHTS + 1;
+layout(constant_id = 2) const uint DIR_LIGHTS  = 0;
+layout(constant_id = 3) const bool SHADOWS     = true;
+
+#ifndef FORWARD_SHADING
+layout(set = 1, binding = 0, rgba32f) uniform image2DArray imageWorldP;
+layout(set = 1, binding = 1, rgba32f) uniform image2DArray imageNormal;
+layout(set = 1, binding = 2, rgba8)   uniform image2DArray imageAlbedo;
+layout(set = 1, binding = 3, r16ui)   uniform uimage2DArray imageShadow;
+layout(set = 1, binding = 4, r16)     uniform image2DArray imageRoughness;
+#endif
+
+// what the lit image is cleared to and where nothing was drawn. must match
+// litBackground in woad.c.
+const vec4 BACKGROUND = vec4(0.1, 0.1, 0.1, 1);
+
+struct Surface {
+    vec3  P;
+    vec3  N;
+    vec3  albedo;
+    float roughness;
+    vec3  eyeDir;
+    uint  shadowMask;
+};
+
+#ifndef FORWARD_SHADING
+// the gbuffer shaders write a world position w of 1. the clear leaves 0.
+bool isBackground(ivec3 pixel)
+{
+    return imageLoad(imageWorldP, pixel).w == 0;
+}
+
+Surface loadSurface(ivec3 pixel, Camera camera)
+{
+    Surface s;
+    s.shadowMask = SHADOWS ? imageLoad(imageShadow, pixel).r : ~0u;
+    s.P          = imageLoad(imageWorldP, pixel).xyz;
+    s.N          = imageLoad(imageNormal, pixel).xyz;
+    s.roughness  = imageLoad(imageRoughness, pixel).r;
+    s.albedo     = imageLoad(imageAlbedo, pixel).rgb;
+
+    const vec3 campos = vec3(camera.xform[3][0], camera.xform[3][1], camera.xform[3][2]);
+    s.eyeDir = normalize(campos - s.P);
+    return s;
+}
+#endif
+
+uint lightCount(uint pushed)
+{
+    return LIGHT_COUNT <= MAX_LIGHTS ? LIGHT_COUNT : pushed;
+}
+
+bool isDirLight(uint i)
+{
+    if (LIGHT_COUNT <= MAX_LIGHTS)
+        return (DIR_LIGHTS & (0x01 << i)) > 0;
+    return lights.light[i].type == DIR_LIGHT;
+}
+
+bool litBy(Surface s, uint light)
+{
+    return (s.shadowMask & (0x01 << light)) > 0;
+}
+
+// lights must be added in increasing order for both paths to sum alike
+void addLight(Surface s, uint i, inout vec3 diffuse, inout vec3 specular)
+{
+    if (isDirLight(i))
+    {
+        vec3 dir      = normalize(lights.light[i].vector);
+        diffuse += lights.light[i].color * calcDiffuse(s.N, dir) * lights.light[i].intensity;
+        specular += lights.light[i].color * calcSpecular(s.N, dir, s.eyeDir, SPEC_EXP) * lights.light[i].intensity;
+    }
+    else
+    {
+        vec3 dir      = normalize(s.P - lights.light[i].vector);
+        float falloff =  1.0f / max(length(s.P - lights.light[i].vector), 0.001); // to prevent div by 0
+        diffuse += lights.light[i].color * calcDiffuse(s.N, dir) * lights.light[i].intensity * falloff;
+        specular += lights.light[i].color * calcSpecular(s.N, dir, s.eyeDir, SPEC_EXP) * lights.light[i].intensity * falloff;
+    }
+}
+
+vec4 finishShading(Surface s, vec3 diffuse, vec3 specular)
+{
+    const vec3 ambient = vec3(0.01);
+    specular = specular * (1 - s.roughness);
+    vec3 illume = (diffuse + specular * 4);
+    return vec4(s.albedo, 1) * vec4(illume + ambient, 1);
+}
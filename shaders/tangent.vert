@@ -1,5 +1,6 @@
 #version 460
 #extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_multiview : enable
 
 layout(location = 0) in vec3 pos;
 layout(location = 1) in vec3 norm;
@@ -16,7 +17,9 @@ layout(location = 3) out mat3 outTBN;
 
 void main()
 {
-    const mat4 xform = push.xform;
+    const Camera camera = cameras.view[gl_ViewIndex];
+    const DrawInstance inst = instances.draw[gl_InstanceIndex];
+    const mat4 xform = inst.xform;
     const vec4 worldPos = xform * vec4(pos, 1.0);
     gl_Position = camera.proj * camera.view * worldPos;
     vec3 bitangent = sign * normalize(cross(norm, tangent));
@@ -26,6 +29,6 @@ void main()
 
     outWorldPos = worldPos.xyz; 
     outUv = uvw.st;
-    outMatId = push.matId;
+    outMatId = inst.matId;
     outTBN = mat3(T, B, N);
 }
@@ -1,12 +1,17 @@
-layout(set = 0, binding = 0) uniform Camera {
-    mat4 view;
-    mat4 proj;
-    mat4 xform;
-} camera;
+#include "camera.glsl"
+#include "geometry.glsl"
 
-layout(push_constant) uniform PushConstant {
-    mat4 xform;
-    uint primId;
-    uint matId;
-} push;
+// with a depth prepass everything is drawn twice, by a position only
+// shader and then shaded against its depth, so both must land on exactly
+// the same depths
+invariant gl_Position;
 
+vec3 pulledPos(const DrawInstance inst)
+{
+    return blockPos(inst, uint(gl_VertexIndex));
+}
+
+uint pulledAttribute(const DrawInstance inst, uint stride, uint i)
+{
+    return blockAttribute(inst, uint(gl_VertexIndex), stride, i);
+}
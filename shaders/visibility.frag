@@ -0,0 +1,12 @@
+#version 460
+
+layout(location = 0) flat in uint instance;
+
+// the instance slot plus one, so the clear of 0 marks background, and the
+// triangle within the level being drawn
+layout(location = 0) out uvec2 outVisibility;
+
+void main()
+{
+    outVisibility = uvec2(instance + 1, gl_PrimitiveID);
+}
@@ -0,0 +1,18 @@
+#version 460
+#extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_multiview : enable
+
+#include "vert-common.glsl"
+
+// the visibility buffer only needs where each triangle lands, so nothing
+// but the position is pulled. resolve.comp fetches the rest per pixel.
+
+layout(location = 0) flat out uint outInstance;
+
+void main()
+{
+    const Camera camera = cameras.view[gl_ViewIndex];
+    const DrawInstance inst = instances.draw[gl_InstanceIndex];
+    gl_Position = camera.proj * camera.view * inst.xform * vec4(pulledPos(inst), 1.0);
+    outInstance = gl_InstanceIndex;
+}
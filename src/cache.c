@@ -0,0 +1,534 @@
+#define COAL_SIMPLE_TYPE_NAMES
+#define ONYX_SIMPLE_TYPE_NAMES
+#include "woad.h"
+#include "cache.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <hell/hell.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// bump whenever packing or the file layout changes. entries of other
+// versions are ignored and overwritten.
+#define CACHE_VERSION 1
+#define CACHE_MAGIC   0x44414f57 // "WOAD"
+#define MAX_CACHE_PATH 4096
+
+// mesh blobs start their vertices and indices this aligned
+#define CACHE_ALIGNMENT 16
+// the alignment vulkan asks of serialized acceleration structure addresses
+#define SERIALIZED_ALIGNMENT 256
+// where a serialized acceleration structure's header keeps the size it
+// deserializes to, after the driver and compatibility uuids and its own size
+#define DESERIALIZED_SIZE_OFFSET (2 * VK_UUID_SIZE + 8)
+
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME  0x100000001b3ull
+
+// followed by the vertices and the indices of every level, each
+// CACHE_ALIGNMENT aligned, laid out as geometry_Place copies them
+typedef struct {
+    uint32_t             magic;
+    uint32_t             version;
+    uint64_t             key;
+    GeometryLodTable     table;
+    OnyxGeometryTemplate templ;
+    VkDeviceSize         attributeOffsets[8];
+    uint32_t             vertexCount;
+    uint32_t             indexCount;
+    uint32_t             totalIndexCount;
+    uint32_t             pad;
+    VkDeviceSize         vertexSize;
+} MeshHeader;
+
+// followed by the serialized blas
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint64_t size;
+} BlasHeader;
+
+typedef struct {
+    uint64_t geoId;
+    uint64_t key;
+} GeoKey;
+
+define_array_type(GeoKey, geo_key);
+
+struct WoadSceneCache {
+    char*           dir;
+    VkDevice        device;
+    VkQueue         queue;
+    OnyxCommandPool commandPool;
+    VkFence         fence;
+    uint8_t         deviceUUID[VK_UUID_SIZE];
+
+    // guards geoKeys, which the loader's workers add to
+    pthread_mutex_t lock;
+    GeoKeyArray     geoKeys;
+};
+
+static VkDeviceSize
+alignUp(VkDeviceSize size, VkDeviceSize alignment)
+{
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+// fnv-1a, a word at a time
+static uint64_t
+hashBytes(uint64_t hash, const void* data, size_t size)
+{
+    const uint8_t* bytes = data;
+    size_t         i     = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        hash = (hash ^ word) * FNV_PRIME;
+    }
+    for (; i < size; i++)
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    return hash;
+}
+
+static int
+mapFile(const char* path, CacheMapping* mapping)
+{
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return -1;
+    }
+    mapping->size = st.st_size;
+    mapping->data = mmap(NULL, mapping->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    return mapping->data == MAP_FAILED ? -1 : 0;
+}
+
+static void
+unmapFile(CacheMapping* mapping)
+{
+    munmap(mapping->data, mapping->size);
+}
+
+void
+cache_UnmapMesh(CacheMapping* mapping)
+{
+    unmapFile(mapping);
+}
+
+static int
+hashFile(const char* path, uint64_t* hash)
+{
+    CacheMapping mapping;
+    if (mapFile(path, &mapping) != 0)
+        return -1;
+    *hash = hashBytes(*hash, mapping.data, mapping.size);
+    unmapFile(&mapping);
+    return 0;
+}
+
+static void
+entryPath(const WoadSceneCache* cache, uint64_t key, const char* extension,
+          char path[MAX_CACHE_PATH])
+{
+    snprintf(path, MAX_CACHE_PATH, "%s/%016llx.%s", cache->dir,
+             (unsigned long long)key, extension);
+}
+
+// writes to a temporary file renamed into place, so readers never see a
+// partial entry, even with two workers storing the same one
+static FILE*
+beginEntry(const char* path, char tmpPath[MAX_CACHE_PATH])
+{
+    snprintf(tmpPath, MAX_CACHE_PATH, "%s.%lx.tmp", path,
+             (unsigned long)pthread_self());
+    return fopen(tmpPath, "wb");
+}
+
+static void
+endEntry(FILE* file, const char* path, const char* tmpPath, bool ok)
+{
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(tmpPath, path) != 0)
+    {
+        remove(tmpPath);
+        hell_print("Woad: failed to write %s\n", path);
+    }
+}
+
+static bool
+writePadded(FILE* file, const void* data, size_t size, size_t alignment)
+{
+    static const uint8_t zeros[CACHE_ALIGNMENT] = {0};
+    const size_t         pad = alignUp(size, alignment) - size;
+    return fwrite(data, 1, size, file) == size &&
+           fwrite(zeros, 1, pad, file) == pad;
+}
+
+int
+cache_MeshKey(const char* path, const OnyxGeometryTemplate* templ,
+              uint64_t* key)
+{
+    const uint32_t version = CACHE_VERSION;
+    uint64_t       hash    = hashBytes(FNV_OFFSET, &version, sizeof(version));
+    hash                   = hashBytes(hash, templ, sizeof(*templ));
+    if (hashFile(path, &hash) != 0)
+        return -1;
+
+    // a .gltf's buffers are usually in a .bin beside it
+    const size_t length = strlen(path);
+    if (length > 5 && length < MAX_CACHE_PATH &&
+        strcmp(path + length - 5, ".gltf") == 0)
+    {
+        char binPath[MAX_CACHE_PATH];
+        memcpy(binPath, path, length - 5);
+        strcpy(binPath + length - 5, ".bin");
+        hashFile(binPath, &hash);
+    }
+    *key = hash;
+    return 0;
+}
+
+int
+cache_MapMesh(WoadSceneCache* cache, uint64_t key, PackedMesh* mesh,
+              CacheMapping* mapping)
+{
+    char path[MAX_CACHE_PATH];
+    entryPath(cache, key, "mesh", path);
+    if (mapFile(path, mapping) != 0)
+        return -1;
+
+    const MeshHeader*  header = mapping->data;
+    const VkDeviceSize vertexStart =
+        alignUp(sizeof(MeshHeader), CACHE_ALIGNMENT);
+    if (mapping->size < sizeof(MeshHeader) || header->magic != CACHE_MAGIC ||
+        header->version != CACHE_VERSION || header->key != key ||
+        mapping->size < vertexStart +
+                            alignUp(header->vertexSize, CACHE_ALIGNMENT) +
+                            sizeof(uint32_t) * header->totalIndexCount)
+    {
+        unmapFile(mapping);
+        return -1;
+    }
+
+    uint8_t* vertices = (uint8_t*)mapping->data + vertexStart;
+    *mesh             = (PackedMesh){
+        .table           = header->table,
+        .templ           = header->templ,
+        .vertexCount     = header->vertexCount,
+        .indexCount      = header->indexCount,
+        .totalIndexCount = header->totalIndexCount,
+        .vertexSize      = header->vertexSize,
+        .vertices        = vertices,
+        .indices         = (uint32_t*)(vertices + alignUp(header->vertexSize,
+                                                          CACHE_ALIGNMENT))};
+    memcpy(mesh->attributeOffsets, header->attributeOffsets,
+           sizeof(mesh->attributeOffsets));
+    return 0;
+}
+
+void
+cache_StoreMesh(WoadSceneCache* cache, uint64_t key, const PackedMesh* mesh)
+{
+    MeshHeader header = {.magic           = CACHE_MAGIC,
+                         .version         = CACHE_VERSION,
+                         .key             = key,
+                         .table           = mesh->table,
+                         .templ           = mesh->templ,
+                         .vertexCount     = mesh->vertexCount,
+                         .indexCount      = mesh->indexCount,
+                         .totalIndexCount = mesh->totalIndexCount,
+                         .vertexSize      = mesh->vertexSize};
+    memcpy(header.attributeOffsets, mesh->attributeOffsets,
+           sizeof(header.attributeOffsets));
+
+    char path[MAX_CACHE_PATH], tmpPath[MAX_CACHE_PATH];
+    entryPath(cache, key, "mesh", path);
+    FILE* file = beginEntry(path, tmpPath);
+    if (!file)
+        return;
+    const bool ok =
+        writePadded(file, &header, sizeof(header), CACHE_ALIGNMENT) &&
+        writePadded(file, mesh->vertices, mesh->vertexSize, CACHE_ALIGNMENT) &&
+        writePadded(file, mesh->indices,
+                    sizeof(uint32_t) * mesh->totalIndexCount, 1);
+    endEntry(file, path, tmpPath, ok);
+}
+
+void
+cache_Remember(WoadSceneCache* cache, uint64_t geoId, uint64_t key)
+{
+    pthread_mutex_lock(&cache->lock);
+    geo_key_arr_push(&cache->geoKeys, (GeoKey){.geoId = geoId, .key = key});
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void
+cache_Forget(WoadSceneCache* cache, uint64_t geoId)
+{
+    pthread_mutex_lock(&cache->lock);
+    for (int i = 0; i < cache->geoKeys.count; i++)
+        if (cache->geoKeys.elems[i].geoId == geoId)
+        {
+            cache->geoKeys.elems[i] =
+                cache->geoKeys.elems[cache->geoKeys.count - 1];
+            geo_key_arr_set_count(&cache->geoKeys, cache->geoKeys.count - 1);
+            break;
+        }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+bool
+cache_GeometryKey(WoadSceneCache* cache, uint64_t geoId, uint64_t* key)
+{
+    bool found = false;
+    pthread_mutex_lock(&cache->lock);
+    for (int i = 0; i < cache->geoKeys.count; i++)
+        if (cache->geoKeys.elems[i].geoId == geoId)
+        {
+            *key  = cache->geoKeys.elems[i].key;
+            found = true;
+            break;
+        }
+    pthread_mutex_unlock(&cache->lock);
+    return found;
+}
+
+// a blas only loads on the device that built it
+static uint64_t
+blasKey(const WoadSceneCache* cache, uint64_t key, bool coarse)
+{
+    uint64_t hash = hashBytes(FNV_OFFSET, &key, sizeof(key));
+    hash          = hashBytes(hash, &coarse, sizeof(coarse));
+    return hashBytes(hash, cache->deviceUUID, sizeof(cache->deviceUUID));
+}
+
+static VkCommandBuffer
+beginCommands(WoadSceneCache* cache)
+{
+    VkCommandBuffer cmd = cache->commandPool.cmdbufs[0];
+    onyx_begin_command_buffer_one_time_submit(cmd);
+    return cmd;
+}
+
+static void
+submitCommands(WoadSceneCache* cache)
+{
+    VkCommandBuffer cmd = cache->commandPool.cmdbufs[0];
+    onyx_end_command_buffer(cmd);
+    const VkSubmitInfo info = onyx_submit_info(0, NULL, NULL, 1, &cmd, 0, NULL);
+    V_ASSERT(vkQueueSubmit(cache->queue, 1, &info, cache->fence));
+    V_ASSERT(vkWaitForFences(cache->device, 1, &cache->fence, VK_TRUE,
+                             UINT64_MAX));
+    V_ASSERT(vkResetFences(cache->device, 1, &cache->fence));
+}
+
+// a host buffer of size bytes from a SERIALIZED_ALIGNMENT aligned address,
+// which host points at
+static OnyxBuffer
+requestSerialized(OnyxMemory* memory, VkDeviceSize size,
+                  VkDeviceAddress* address, uint8_t** host)
+{
+    OnyxBuffer region = onyx_request_buffer_region(
+        memory, size + SERIALIZED_ALIGNMENT,
+        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        ONYX_MEMORY_HOST_TRANSFER_TYPE);
+    *address = alignUp(region.address, SERIALIZED_ALIGNMENT);
+    *host    = region.host_data + (*address - region.address);
+    return region;
+}
+
+bool
+cache_LoadBlas(WoadSceneCache* cache, uint64_t key, bool coarse,
+               OnyxMemory* memory, OnyxAccelerationStructure* blas)
+{
+    char path[MAX_CACHE_PATH];
+    key = blasKey(cache, key, coarse);
+    entryPath(cache, key, "blas", path);
+    CacheMapping mapping;
+    if (mapFile(path, &mapping) != 0)
+        return false;
+
+    const BlasHeader* header = mapping.data;
+    const uint8_t*    data = (const uint8_t*)mapping.data + sizeof(BlasHeader);
+    bool              loaded = false;
+    if (mapping.size < sizeof(BlasHeader) || header->magic != CACHE_MAGIC ||
+        header->version != CACHE_VERSION || header->key != key ||
+        header->size < DESERIALIZED_SIZE_OFFSET + sizeof(uint64_t) ||
+        mapping.size - sizeof(BlasHeader) < header->size)
+        goto end;
+
+    // drivers may change their format without the device changing
+    const VkAccelerationStructureVersionInfoKHR versionInfo = {
+        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_VERSION_INFO_KHR,
+        .pVersionData = data};
+    VkAccelerationStructureCompatibilityKHR compatibility;
+    vkGetDeviceAccelerationStructureCompatibilityKHR(
+        cache->device, &versionInfo, &compatibility);
+    if (compatibility !=
+        VK_ACCELERATION_STRUCTURE_COMPATIBILITY_COMPATIBLE_KHR)
+        goto end;
+
+    uint64_t size;
+    memcpy(&size, data + DESERIALIZED_SIZE_OFFSET, sizeof(size));
+    VkDeviceAddress srcAddress;
+    uint8_t*        src;
+    OnyxBuffer      staging =
+        requestSerialized(memory, header->size, &srcAddress, &src);
+    memcpy(src, data, header->size);
+
+    *blas = (OnyxAccelerationStructure){
+        .buffer_region = onyx_request_buffer_region_aligned(
+            memory, size, 256, ONYX_MEMORY_DEVICE_TYPE)};
+    const VkAccelerationStructureCreateInfoKHR createInfo = {
+        .sType  = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR,
+        .buffer = blas->buffer_region.buffer,
+        .offset = blas->buffer_region.offset,
+        .size   = size,
+        .type   = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR};
+    V_ASSERT(vkCreateAccelerationStructureKHR(cache->device, &createInfo, NULL,
+                                              &blas->handle));
+
+    VkCommandBuffer cmd = beginCommands(cache);
+    const VkCopyMemoryToAccelerationStructureInfoKHR copy = {
+        .sType =
+            VK_STRUCTURE_TYPE_COPY_MEMORY_TO_ACCELERATION_STRUCTURE_INFO_KHR,
+        .src.deviceAddress = srcAddress,
+        .dst               = blas->handle,
+        .mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_DESERIALIZE_KHR};
+    vkCmdCopyMemoryToAccelerationStructureKHR(cmd, &copy);
+    // for the tlas builds that read it
+    onyx_v_MemoryBarrier(
+        cmd, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+        VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0,
+        VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
+        VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR);
+    submitCommands(cache);
+    onyx_free_buffer(&staging);
+    loaded = true;
+
+end:
+    unmapFile(&mapping);
+    return loaded;
+}
+
+void
+cache_StoreBlas(WoadSceneCache* cache, uint64_t key, bool coarse,
+                OnyxMemory* memory, const OnyxAccelerationStructure* blas)
+{
+    const VkQueryPoolCreateInfo queryInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType =
+            VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE_KHR,
+        .queryCount = 1};
+    VkQueryPool queryPool;
+    V_ASSERT(vkCreateQueryPool(cache->device, &queryInfo, NULL, &queryPool));
+
+    VkCommandBuffer cmd = beginCommands(cache);
+    vkCmdResetQueryPool(cmd, queryPool, 0, 1);
+    vkCmdWriteAccelerationStructuresPropertiesKHR(
+        cmd, 1, &blas->handle,
+        VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE_KHR, queryPool,
+        0);
+    submitCommands(cache);
+    uint64_t size = 0;
+    vkGetQueryPoolResults(cache->device, queryPool, 0, 1, sizeof(size), &size,
+                          sizeof(size),
+                          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+    vkDestroyQueryPool(cache->device, queryPool, NULL);
+    if (!size)
+        return;
+
+    VkDeviceAddress dstAddress;
+    uint8_t*        dst;
+    OnyxBuffer staging = requestSerialized(memory, size, &dstAddress, &dst);
+    cmd                = beginCommands(cache);
+    const VkCopyAccelerationStructureToMemoryInfoKHR copy = {
+        .sType =
+            VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_TO_MEMORY_INFO_KHR,
+        .src               = blas->handle,
+        .dst.deviceAddress = dstAddress,
+        .mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_SERIALIZE_KHR};
+    vkCmdCopyAccelerationStructureToMemoryKHR(cmd, &copy);
+    onyx_v_MemoryBarrier(
+        cmd, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+        VK_PIPELINE_STAGE_HOST_BIT, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_ACCESS_HOST_READ_BIT);
+    submitCommands(cache);
+
+    const BlasHeader header = {.magic   = CACHE_MAGIC,
+                               .version = CACHE_VERSION,
+                               .key     = blasKey(cache, key, coarse),
+                               .size    = size};
+    char path[MAX_CACHE_PATH], tmpPath[MAX_CACHE_PATH];
+    entryPath(cache, header.key, "blas", path);
+    FILE* file = beginEntry(path, tmpPath);
+    if (file)
+    {
+        const bool ok =
+            fwrite(&header, 1, sizeof(header), file) == sizeof(header) &&
+            fwrite(dst, 1, size, file) == size;
+        endEntry(file, path, tmpPath, ok);
+    }
+    onyx_free_buffer(&staging);
+}
+
+WoadSceneCache*
+woad_OpenSceneCache(const OnyxInstance* instance, const char* dir)
+{
+    struct stat st;
+    if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode))
+    {
+        hell_print("Woad: scene cache directory %s doesn't exist\n", dir);
+        return NULL;
+    }
+
+    WoadSceneCache* cache = calloc(1, sizeof(WoadSceneCache));
+    assert(cache);
+    cache->dir = strdup(dir);
+    assert(cache->dir);
+    cache->device  = onyx_get_device(instance);
+    cache->queue   = onyx_get_graphics_queue(instance, 0);
+    cache->geoKeys = geo_key_arr_create(NULL);
+    pthread_mutex_init(&cache->lock, NULL);
+
+    cache->commandPool = onyx_create_command_pool_(
+        cache->device,
+        onyx_queue_family_index(instance, ONYX_QUEUE_GRAPHICS_TYPE),
+        VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, 1);
+    const VkFenceCreateInfo fenceInfo = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    V_ASSERT(vkCreateFence(cache->device, &fenceInfo, NULL, &cache->fence));
+
+    VkPhysicalDeviceIDProperties idProps = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES};
+    VkPhysicalDeviceProperties2 props = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &idProps};
+    vkGetPhysicalDeviceProperties2(instance->physical_device, &props);
+    memcpy(cache->deviceUUID, idProps.deviceUUID, VK_UUID_SIZE);
+    return cache;
+}
+
+void
+woad_CloseSceneCache(WoadSceneCache* cache)
+{
+    vkDestroyFence(cache->device, cache->fence, NULL);
+    onyx_destroy_command_pool(cache->device, &cache->commandPool);
+    geo_key_arr_free(&cache->geoKeys);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->dir);
+    free(cache);
+}
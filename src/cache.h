@@ -0,0 +1,58 @@
+#ifndef WOAD_CACHE_H
+#define WOAD_CACHE_H
+
+// the scene cache's side of the loader and the blas cache. meshes are keyed
+// by the content of their glTF file, blas by their mesh's key and the device.
+
+#include "woad.h"
+#include "geometry.h"
+
+#include <stdint.h>
+
+// a cached mesh mapped into memory. the packed mesh points into it.
+typedef struct {
+    void*  data;
+    size_t size;
+} CacheMapping;
+
+// the key of the first mesh of the glTF file at path read with templ
+int
+cache_MeshKey(const char* path, const OnyxGeometryTemplate* templ,
+              uint64_t* key);
+
+// maps the cached mesh for key, which mesh then points into until it is
+// unmapped. fails if there is none.
+int
+cache_MapMesh(WoadSceneCache* cache, uint64_t key, PackedMesh* mesh,
+              CacheMapping* mapping);
+
+void
+cache_UnmapMesh(CacheMapping* mapping);
+
+void
+cache_StoreMesh(WoadSceneCache* cache, uint64_t key, const PackedMesh* mesh);
+
+// which mesh key geometry was placed from, for finding its blas. geometry
+// is known by the id in its lod table, which later geometry at the same
+// address doesn't share.
+void
+cache_Remember(WoadSceneCache* cache, uint64_t geoId, uint64_t key);
+
+void
+cache_Forget(WoadSceneCache* cache, uint64_t geoId);
+
+bool
+cache_GeometryKey(WoadSceneCache* cache, uint64_t geoId, uint64_t* key);
+
+// the blas built from a geometry with this key, at the coarse level or not.
+// both submit to the graphics queue and wait, so the caller must hold
+// woad's shared lock.
+bool
+cache_LoadBlas(WoadSceneCache* cache, uint64_t key, bool coarse,
+               OnyxMemory* memory, OnyxAccelerationStructure* blas);
+
+void
+cache_StoreBlas(WoadSceneCache* cache, uint64_t key, bool coarse,
+                OnyxMemory* memory, const OnyxAccelerationStructure* blas);
+
+#endif
@@ -0,0 +1,880 @@
+#define COAL_SIMPLE_TYPE_NAMES
+#define ONYX_SIMPLE_TYPE_NAMES
+#include "woad.h"
+#include "geometry.h"
+
+#include <assert.h>
+#include <hell/hell.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// post transform cache the index order is tuned for. larger than most
+// hardware caches, which still do well with it.
+#define VERTEX_CACHE_SIZE 32
+
+enum { SRC_POS, SRC_NORMAL, SRC_UV, SRC_TANGENT, SRC_SIGN, SRC_COUNT };
+
+static const OnyxAttributeType srcTypes[SRC_COUNT] = {
+    ONYX_ATTRIBUTE_TYPE_POS, ONYX_ATTRIBUTE_TYPE_NORMAL, ONYX_ATTRIBUTE_TYPE_UV,
+    ONYX_ATTRIBUTE_TYPE_TANGENT, ONYX_ATTRIBUTE_TYPE_SIGN};
+static const uint32_t srcSizes[SRC_COUNT] = {12, 12, 8, 12, 4};
+
+// blocks are made this size, or larger for geometry that doesn't fit
+#define GEOMETRY_BLOCK_SIZE 0x2000000
+// each coarser level aims for this fraction of the one before's triangles
+#define LOD_RATIO 3
+// levels stop before going under this many indices
+#define LOD_MIN_INDICES 96
+
+// each geometry's vertices start this aligned within its block
+#define GEOMETRY_ALIGNMENT 16
+// the largest minStorageBufferOffsetAlignment vulkan allows. a block's
+// descriptor starts at its offset rounded down to this.
+#define STORAGE_ALIGNMENT 256
+
+// geometry is bump allocated from a block, and the block freed once all of
+// its geometry is
+typedef struct {
+    OnyxBuffer   region;
+    VkDeviceSize head;
+    uint32_t     geoCount;
+} GeometryBlock;
+
+// the lock also serializes every onyx memory call on blocks, see
+// geometry_LockMemory
+static struct {
+    pthread_mutex_t lock;
+    GeometryBlock   blocks[MAX_GEOMETRY_BLOCKS];
+    uint32_t        generation;
+    uint64_t        lastId;
+} arena = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+// Tom Forsyth's linear speed vertex cache optimisation. a vertex scores
+// higher the more recently it entered the cache and the fewer triangles it
+// has left, and each step emits the best scoring triangle.
+static float
+vertexScore(int cachePos, uint32_t remaining)
+{
+    if (remaining == 0)
+        return -1.0f;
+    float score = 0.0f;
+    // the last triangle's vertices are scored the same, so the next one
+    // doesn't favour one edge
+    if (cachePos >= 0 && cachePos < 3)
+        score = 0.75f;
+    else if (cachePos >= 3)
+        score = powf(1.0f - (float)(cachePos - 3) / (VERTEX_CACHE_SIZE - 3),
+                     1.5f);
+    return score + 2.0f / sqrtf((float)remaining);
+}
+
+static void
+optimizeVertexCache(uint32_t* indices, uint32_t indexCount,
+                    uint32_t vertexCount)
+{
+    const uint32_t triCount = indexCount / 3;
+    uint32_t*      remaining = calloc(vertexCount, sizeof(uint32_t));
+    uint32_t*      adjStart  = calloc(vertexCount + 1, sizeof(uint32_t));
+    uint32_t*      adj       = malloc(sizeof(uint32_t) * indexCount);
+    int*           cachePos  = malloc(sizeof(int) * vertexCount);
+    float*         score     = malloc(sizeof(float) * vertexCount);
+    float*         triScore  = malloc(sizeof(float) * triCount);
+    bool*          emitted   = calloc(triCount, sizeof(bool));
+    uint32_t*      out       = malloc(sizeof(uint32_t) * indexCount);
+    assert(remaining && adjStart && adj && cachePos && score && triScore &&
+           emitted && out);
+
+    for (uint32_t i = 0; i < indexCount; i++)
+        remaining[indices[i]]++;
+    for (uint32_t v = 0; v < vertexCount; v++)
+        adjStart[v + 1] = adjStart[v] + remaining[v];
+    // each vertex's triangles, counting up in cachePos while filling
+    memset(cachePos, 0, sizeof(int) * vertexCount);
+    for (uint32_t t = 0; t < triCount; t++)
+        for (int k = 0; k < 3; k++)
+        {
+            const uint32_t v = indices[t * 3 + k];
+            adj[adjStart[v] + cachePos[v]++] = t;
+        }
+    for (uint32_t v = 0; v < vertexCount; v++)
+    {
+        cachePos[v] = -1;
+        score[v]    = vertexScore(-1, remaining[v]);
+    }
+    for (uint32_t t = 0; t < triCount; t++)
+        triScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] +
+                      score[indices[t * 3 + 2]];
+
+    uint32_t cache[VERTEX_CACHE_SIZE + 3];
+    uint32_t cacheCount = 0;
+    int64_t  best       = -1;
+    uint32_t scan       = 0;
+    for (uint32_t n = 0; n < triCount; n++)
+    {
+        // nothing in the cache is connected to anything left, so start
+        // from the best triangle anywhere
+        if (best < 0)
+        {
+            float bestScore = -1.0f;
+            for (uint32_t t = scan; t < triCount; t++)
+            {
+                if (emitted[t])
+                {
+                    if (t == scan)
+                        scan++;
+                    continue;
+                }
+                if (triScore[t] > bestScore)
+                {
+                    bestScore = triScore[t];
+                    best      = t;
+                }
+            }
+        }
+        const uint32_t  t   = (uint32_t)best;
+        const uint32_t* tri = &indices[t * 3];
+        memcpy(&out[n * 3], tri, sizeof(uint32_t) * 3);
+        emitted[t] = true;
+
+        for (int k = 0; k < 3; k++)
+        {
+            const uint32_t v = tri[k];
+            uint32_t*      list = &adj[adjStart[v]];
+            for (uint32_t a = 0; a < remaining[v]; a++)
+            {
+                if (list[a] != t)
+                    continue;
+                list[a] = list[remaining[v] - 1];
+                break;
+            }
+            remaining[v]--;
+        }
+
+        // the triangle's vertices go to the front, the rest shift back
+        uint32_t newCache[VERTEX_CACHE_SIZE + 3];
+        uint32_t newCount = 0;
+        for (int k = 0; k < 3; k++)
+            newCache[newCount++] = tri[k];
+        for (uint32_t c = 0; c < cacheCount; c++)
+        {
+            const uint32_t v = cache[c];
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                newCache[newCount++] = v;
+        }
+        for (uint32_t c = 0; c < newCount; c++)
+        {
+            const uint32_t v = newCache[c];
+            cachePos[v] = c < VERTEX_CACHE_SIZE ? (int)c : -1;
+            score[v]    = vertexScore(cachePos[v], remaining[v]);
+        }
+
+        // only triangles touching the cache changed score, and the next
+        // one is picked from them
+        best            = -1;
+        float bestScore = -1.0f;
+        for (uint32_t c = 0; c < newCount; c++)
+        {
+            const uint32_t  v    = newCache[c];
+            const uint32_t* list = &adj[adjStart[v]];
+            for (uint32_t a = 0; a < remaining[v]; a++)
+            {
+                const uint32_t* at = &indices[list[a] * 3];
+                triScore[list[a]]  = score[at[0]] + score[at[1]] + score[at[2]];
+                if (triScore[list[a]] > bestScore)
+                {
+                    bestScore = triScore[list[a]];
+                    best      = list[a];
+                }
+            }
+        }
+        cacheCount = newCount < VERTEX_CACHE_SIZE ? newCount : VERTEX_CACHE_SIZE;
+        memcpy(cache, newCache, sizeof(uint32_t) * cacheCount);
+    }
+
+    memcpy(indices, out, sizeof(uint32_t) * triCount * 3);
+    free(remaining);
+    free(adjStart);
+    free(adj);
+    free(cachePos);
+    free(score);
+    free(triScore);
+    free(emitted);
+    free(out);
+}
+
+// symmetric 4x4 matrix summing the squared distances to a set of planes,
+// each weighted by its triangle's area
+typedef struct {
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+    double weight;
+} Quadric;
+
+static void
+quadricAdd(Quadric* q, const Quadric* o)
+{
+    q->a2 += o->a2, q->ab += o->ab, q->ac += o->ac, q->ad += o->ad;
+    q->b2 += o->b2, q->bc += o->bc, q->bd += o->bd;
+    q->c2 += o->c2, q->cd += o->cd, q->d2 += o->d2;
+    q->weight += o->weight;
+}
+
+// mean squared distance of p to the planes
+static float
+quadricError(const Quadric* q, const float* p)
+{
+    const double x = p[0], y = p[1], z = p[2];
+    const double e = q->a2 * x * x + q->b2 * y * y + q->c2 * z * z +
+                     2 * (q->ab * x * y + q->ac * x * z + q->bc * y * z) +
+                     2 * (q->ad * x + q->bd * y + q->cd * z) + q->d2;
+    return q->weight > 0 ? (float)fabs(e / q->weight) : 0.0f;
+}
+
+static void
+triNormal(const float* a, const float* b, const float* c, double* n)
+{
+    const double e0[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    const double e1[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+    n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+    n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+}
+
+static int
+compareU64(const void* a, const void* b)
+{
+    const uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+typedef struct {
+    uint32_t from;
+    uint32_t to;
+    float    cost;
+} Collapse;
+
+static int
+compareCollapse(const void* a, const void* b)
+{
+    const float x = ((const Collapse*)a)->cost, y = ((const Collapse*)b)->cost;
+    return x < y ? -1 : x > y;
+}
+
+// moving from onto to would turn a triangle around from over
+static bool
+collapseFlips(const uint32_t* indices, const uint32_t* adjStart,
+              const uint32_t* adj, const float* pos, uint32_t from,
+              uint32_t to)
+{
+    for (uint32_t a = adjStart[from]; a < adjStart[from + 1]; a++)
+    {
+        const uint32_t* tri = &indices[adj[a] * 3];
+        if (tri[0] == to || tri[1] == to || tri[2] == to)
+            continue;
+        const float* p[3];
+        const float* q[3];
+        for (int k = 0; k < 3; k++)
+        {
+            p[k] = &pos[tri[k] * 3];
+            q[k] = tri[k] == from ? &pos[to * 3] : p[k];
+        }
+        double n0[3], n1[3];
+        triNormal(p[0], p[1], p[2], n0);
+        triNormal(q[0], q[1], q[2], n1);
+        if (n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0.0)
+            return true;
+    }
+    return false;
+}
+
+// Garland and Heckbert's quadric error simplification. vertices are
+// collapsed onto a neighbour rather than moved, so a level shares the
+// vertices of the one it came from. vertices on open edges, which include
+// uv and normal seams since those vertices are split, never move, so the
+// outline and the seams stay put. reduces indices in place to about target
+// and returns the new count, with the largest distance it moved the surface
+// in *error.
+static uint32_t
+simplify(uint32_t* indices, uint32_t indexCount, const float* pos,
+         uint32_t vertexCount, uint32_t target, float* error)
+{
+    const uint32_t triCount = indexCount / 3;
+    Quadric*       quadrics = calloc(vertexCount, sizeof(Quadric));
+    bool*          locked   = calloc(vertexCount, sizeof(bool));
+    bool*          touched  = malloc(sizeof(bool) * vertexCount);
+    uint32_t*      remap    = malloc(sizeof(uint32_t) * vertexCount);
+    uint32_t*      adjStart = malloc(sizeof(uint32_t) * (vertexCount + 1));
+    uint32_t*      adj      = malloc(sizeof(uint32_t) * indexCount);
+    uint64_t*      edges    = malloc(sizeof(uint64_t) * indexCount);
+    Collapse*      collapses = malloc(sizeof(Collapse) * indexCount * 2);
+    assert(quadrics && locked && touched && remap && adjStart && adj &&
+           edges && collapses);
+
+    for (uint32_t t = 0; t < triCount; t++)
+    {
+        const uint32_t* tri = &indices[t * 3];
+        double          n[3];
+        triNormal(&pos[tri[0] * 3], &pos[tri[1] * 3], &pos[tri[2] * 3], n);
+        const double len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (len == 0.0)
+            continue;
+        const double a = n[0] / len, b = n[1] / len, c = n[2] / len;
+        const float* p = &pos[tri[0] * 3];
+        const double d = -(a * p[0] + b * p[1] + c * p[2]);
+        const double w = len * 0.5;
+        const Quadric q = {a * a * w, a * b * w, a * c * w, a * d * w,
+                           b * b * w, b * c * w, b * d * w,
+                           c * c * w, c * d * w, d * d * w, w};
+        for (int k = 0; k < 3; k++)
+            quadricAdd(&quadrics[tri[k]], &q);
+    }
+
+    // an edge that only one triangle, or more than two, uses
+    for (uint32_t t = 0; t < triCount; t++)
+        for (int k = 0; k < 3; k++)
+        {
+            const uint32_t a = indices[t * 3 + k];
+            const uint32_t b = indices[t * 3 + (k + 1) % 3];
+            edges[t * 3 + k] = a < b ? (uint64_t)a << 32 | b
+                                     : (uint64_t)b << 32 | a;
+        }
+    qsort(edges, indexCount, sizeof(uint64_t), compareU64);
+    for (uint32_t i = 0; i < indexCount;)
+    {
+        uint32_t n = 1;
+        while (i + n < indexCount && edges[i + n] == edges[i])
+            n++;
+        if (n != 2)
+        {
+            locked[edges[i] >> 32]        = true;
+            locked[edges[i] & 0xffffffff] = true;
+        }
+        i += n;
+    }
+
+    float maxError = 0.0f;
+    while (indexCount > target)
+    {
+        const uint32_t liveTris = indexCount / 3;
+        memset(adjStart, 0, sizeof(uint32_t) * (vertexCount + 1));
+        for (uint32_t i = 0; i < indexCount; i++)
+            adjStart[indices[i] + 1]++;
+        for (uint32_t v = 0; v < vertexCount; v++)
+            adjStart[v + 1] += adjStart[v];
+        // remap doubles as the fill cursor until the collapses use it
+        memcpy(remap, adjStart, sizeof(uint32_t) * vertexCount);
+        for (uint32_t t = 0; t < liveTris; t++)
+            for (int k = 0; k < 3; k++)
+                adj[remap[indices[t * 3 + k]]++] = t;
+
+        uint32_t collapseCount = 0;
+        for (uint32_t i = 0; i < indexCount; i++)
+        {
+            const uint32_t a = indices[i];
+            const uint32_t b = indices[i - i % 3 + (i % 3 + 1) % 3];
+            if (!locked[a])
+                collapses[collapseCount++] =
+                    (Collapse){a, b, quadricError(&quadrics[a], &pos[b * 3])};
+            if (!locked[b])
+                collapses[collapseCount++] =
+                    (Collapse){b, a, quadricError(&quadrics[b], &pos[a * 3])};
+        }
+        qsort(collapses, collapseCount, sizeof(Collapse), compareCollapse);
+
+        // an interior collapse removes two triangles. each pass does the
+        // cheapest that don't share a neighbourhood, up to the target.
+        const uint32_t goal = (indexCount - target) / 6 + 1;
+        uint32_t       done = 0;
+        memset(touched, 0, sizeof(bool) * vertexCount);
+        for (uint32_t v = 0; v < vertexCount; v++)
+            remap[v] = v;
+        for (uint32_t c = 0; c < collapseCount && done < goal; c++)
+        {
+            const Collapse* col = &collapses[c];
+            if (touched[col->from] || touched[col->to] ||
+                collapseFlips(indices, adjStart, adj, pos, col->from, col->to))
+                continue;
+            remap[col->from] = col->to;
+            quadricAdd(&quadrics[col->to], &quadrics[col->from]);
+            for (uint32_t a = adjStart[col->from]; a < adjStart[col->from + 1];
+                 a++)
+                for (int k = 0; k < 3; k++)
+                    touched[indices[adj[a] * 3 + k]] = true;
+            if (col->cost > maxError)
+                maxError = col->cost;
+            done++;
+        }
+        if (done == 0)
+            break;
+
+        uint32_t kept = 0;
+        for (uint32_t t = 0; t < liveTris; t++)
+        {
+            const uint32_t a = remap[indices[t * 3]];
+            const uint32_t b = remap[indices[t * 3 + 1]];
+            const uint32_t c = remap[indices[t * 3 + 2]];
+            if (a == b || b == c || c == a)
+                continue;
+            indices[kept++] = a;
+            indices[kept++] = b;
+            indices[kept++] = c;
+        }
+        indexCount = kept;
+    }
+
+    *error = sqrtf(maxError);
+    free(quadrics);
+    free(locked);
+    free(touched);
+    free(remap);
+    free(adjStart);
+    free(adj);
+    free(edges);
+    free(collapses);
+    return indexCount;
+}
+
+// appends the coarser levels after the full one in indices, which must
+// have room for MAX_GEOMETRY_LODS times indexCount. returns the total index
+// count.
+static uint32_t
+buildLods(uint32_t* indices, uint32_t indexCount, const float* pos,
+          uint32_t vertexCount, GeometryLodTable* table)
+{
+    table->lods[0] = (GeometryLod){.firstIndex = 0, .indexCount = indexCount};
+    table->lodCount = 1;
+    uint32_t total  = indexCount;
+    float    error  = 0.0f;
+    while (table->lodCount < MAX_GEOMETRY_LODS)
+    {
+        const GeometryLod* prev   = &table->lods[table->lodCount - 1];
+        const uint32_t     target = prev->indexCount / LOD_RATIO / 3 * 3;
+        if (target < LOD_MIN_INDICES)
+            break;
+        uint32_t* level = &indices[total];
+        memcpy(level, &indices[prev->firstIndex],
+               sizeof(uint32_t) * prev->indexCount);
+        float          levelError;
+        const uint32_t count = simplify(level, prev->indexCount, pos,
+                                        vertexCount, target, &levelError);
+        // not worth a level of its own
+        if (count > prev->indexCount * 4 / 5)
+            break;
+        optimizeVertexCache(level, count, vertexCount);
+        // errors add up along the chain, and must not shrink for the
+        // selection to stay monotonic
+        error += levelError;
+        table->lods[table->lodCount++] = (GeometryLod){
+            .firstIndex = total, .indexCount = count, .error = error};
+        total += count;
+    }
+    return total;
+}
+
+static int16_t
+snorm16(float f)
+{
+    f = f < -1.0f ? -1.0f : (f > 1.0f ? 1.0f : f);
+    return (int16_t)lrintf(f * 32767.0f);
+}
+
+// octahedral encoding: the unit sphere folded onto a square, two snorm16s
+static void
+octEncode(const float* n, int16_t* out)
+{
+    const float sum = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+    float       x = sum > 0.0f ? n[0] / sum : 0.0f;
+    float       y = sum > 0.0f ? n[1] / sum : 0.0f;
+    if (n[2] < 0.0f)
+    {
+        const float ox = x;
+        x = (1.0f - fabsf(y)) * (ox >= 0.0f ? 1.0f : -1.0f);
+        y = (1.0f - fabsf(ox)) * (y >= 0.0f ? 1.0f : -1.0f);
+    }
+    out[0] = snorm16(x);
+    out[1] = snorm16(y);
+}
+
+// round to nearest half. values too small for a normal half become zero,
+// too large become infinity.
+static uint16_t
+halfFloat(float f)
+{
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    const uint16_t sign = (bits >> 16) & 0x8000;
+    const int32_t  exp  = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t       mant = bits & 0x7fffff;
+    if (((bits >> 23) & 0xff) == 0xff)
+        return sign | 0x7c00 | (mant ? 0x200 : 0);
+    if (exp <= 0)
+        return sign;
+    if (exp >= 31)
+        return sign | 0x7c00;
+    uint32_t h = ((uint32_t)exp << 10) | (mant >> 13);
+    // a carry into the exponent is still the right rounding
+    if ((mant & 0x1fff) > 0x1000 || ((mant & 0x1fff) == 0x1000 && (h & 1)))
+        h++;
+    return sign | (uint16_t)(h > 0x7c00 ? 0x7c00 : h);
+}
+
+void
+geometry_LockMemory(void)
+{
+    pthread_mutex_lock(&arena.lock);
+}
+
+void
+geometry_UnlockMemory(void)
+{
+    pthread_mutex_unlock(&arena.lock);
+}
+
+uint32_t
+geometry_Generation(void)
+{
+    pthread_mutex_lock(&arena.lock);
+    const uint32_t generation = arena.generation;
+    pthread_mutex_unlock(&arena.lock);
+    return generation;
+}
+
+static VkDeviceSize
+blockBase(const GeometryBlock* block)
+{
+    return block->region.offset & ~(VkDeviceSize)(STORAGE_ALIGNMENT - 1);
+}
+
+void
+geometry_Blocks(VkDescriptorBufferInfo infos[MAX_GEOMETRY_BLOCKS])
+{
+    pthread_mutex_lock(&arena.lock);
+    for (int i = 0; i < MAX_GEOMETRY_BLOCKS; i++)
+    {
+        const GeometryBlock* block = &arena.blocks[i];
+        const VkDeviceSize   base  = blockBase(block);
+        infos[i] = (VkDescriptorBufferInfo){
+            .buffer = block->region.buffer,
+            .offset = base,
+            .range  = block->region.offset - base + block->region.size};
+    }
+    pthread_mutex_unlock(&arena.lock);
+}
+
+static int
+findBlock(const OnyxGeometry* geo)
+{
+    for (int i = 0; i < MAX_GEOMETRY_BLOCKS; i++)
+    {
+        const OnyxBuffer* block = &arena.blocks[i].region;
+        if (block->size && block->buffer == geo->vertex_region.buffer &&
+            geo->vertex_region.offset >= block->offset &&
+            geo->vertex_region.offset < block->offset + block->size)
+            return i;
+    }
+    return -1;
+}
+
+int
+geometry_FindBlock(const OnyxGeometry* geo, VkDeviceSize* base)
+{
+    pthread_mutex_lock(&arena.lock);
+    const int block = findBlock(geo);
+    if (block >= 0)
+        *base = blockBase(&arena.blocks[block]);
+    pthread_mutex_unlock(&arena.lock);
+    return block;
+}
+
+// size bytes from the first block with room, making a block if none has.
+// returns the block, or -1 if every block is in use. must hold the lock.
+static int
+blockAlloc(OnyxMemory* memory, VkDeviceSize size, VkDeviceSize* offset)
+{
+    size = (size + GEOMETRY_ALIGNMENT - 1) & ~(VkDeviceSize)(GEOMETRY_ALIGNMENT - 1);
+    int unused = -1;
+    for (int i = 0; i < MAX_GEOMETRY_BLOCKS; i++)
+    {
+        GeometryBlock* block = &arena.blocks[i];
+        if (block->region.size == 0)
+        {
+            if (unused < 0)
+                unused = i;
+            continue;
+        }
+        if (block->region.size - block->head >= size)
+        {
+            *offset = block->head;
+            block->head += size;
+            block->geoCount++;
+            return i;
+        }
+    }
+    if (unused < 0)
+        return -1;
+
+    GeometryBlock* block = &arena.blocks[unused];
+    block->region = onyx_request_buffer_region(
+        memory, size > GEOMETRY_BLOCK_SIZE ? size : GEOMETRY_BLOCK_SIZE,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+            VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
+        ONYX_MEMORY_HOST_GRAPHICS_TYPE);
+    block->head     = size;
+    block->geoCount = 1;
+    arena.generation++;
+    *offset = 0;
+    return unused;
+}
+
+// the part of a block that one geometry's vertices or indices are in
+static OnyxBuffer
+subRegion(const OnyxBuffer* block, VkDeviceSize offset, VkDeviceSize size)
+{
+    OnyxBuffer region = *block;
+    region.offset += offset;
+    region.address += offset;
+    region.host_data += offset;
+    region.size = size;
+    return region;
+}
+
+// centered on the bounding box of the used vertices, which is close enough
+// for choosing levels
+static void
+boundingSphere(const uint32_t* indices, uint32_t indexCount, const float* pos,
+               float* center, float* radius)
+{
+    float lo[3] = {INFINITY, INFINITY, INFINITY};
+    float hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+    for (uint32_t i = 0; i < indexCount; i++)
+        for (int k = 0; k < 3; k++)
+        {
+            const float f = pos[indices[i] * 3 + k];
+            lo[k] = f < lo[k] ? f : lo[k];
+            hi[k] = f > hi[k] ? f : hi[k];
+        }
+    float r2 = 0.0f;
+    for (int k = 0; k < 3; k++)
+        center[k] = indexCount ? (lo[k] + hi[k]) * 0.5f : 0.0f;
+    for (uint32_t i = 0; i < indexCount; i++)
+    {
+        const float* p = &pos[indices[i] * 3];
+        const float  d[3] = {p[0] - center[0], p[1] - center[1],
+                             p[2] - center[2]};
+        const float  l = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+        r2 = l > r2 ? l : r2;
+    }
+    *radius = sqrtf(r2);
+}
+
+const GeometryLodTable*
+geometry_Lods(const OnyxGeometry* geo)
+{
+    return (const GeometryLodTable*)(geo->vertex_region.host_data -
+                                     sizeof(GeometryLodTable));
+}
+
+int
+geometry_Pack(const OnyxGeometry* src, PackedMesh* mesh)
+{
+    const uint8_t* attrs[SRC_COUNT] = {0};
+    if (!src->vertex_region.host_data || !src->index_region.host_data ||
+        src->index_count % 3 != 0)
+        return -1;
+    for (int i = 0; i < src->templ.attribute_count; i++)
+    {
+        for (int s = 0; s < SRC_COUNT; s++)
+        {
+            if (src->templ.attribute_types[i] != srcTypes[s])
+                continue;
+            if (src->templ.attribute_sizes[i] != srcSizes[s])
+                return -1;
+            attrs[s] = src->vertex_region.host_data +
+                       (src->attribute_offsets[i] - src->vertex_region.offset);
+        }
+    }
+    if (!attrs[SRC_POS] || !attrs[SRC_NORMAL] || !attrs[SRC_UV] ||
+        !attrs[SRC_TANGENT] != !attrs[SRC_SIGN])
+        return -1;
+    const bool tangents = attrs[SRC_TANGENT] != NULL;
+
+    const uint32_t indexCount = src->index_count;
+    // with room for the coarser levels
+    uint32_t*      indices    =
+        malloc(sizeof(uint32_t) * indexCount * MAX_GEOMETRY_LODS);
+    uint32_t*      remap      = malloc(sizeof(uint32_t) * src->vertex_count);
+    float*         positions  = malloc(12 * src->vertex_count);
+    assert(indices && remap && positions);
+    memcpy(indices, src->index_region.host_data, sizeof(uint32_t) * indexCount);
+    memcpy(positions, attrs[SRC_POS], 12 * src->vertex_count);
+    optimizeVertexCache(indices, indexCount, src->vertex_count);
+
+    *mesh = (PackedMesh){.indexCount = indexCount, .indices = indices};
+    mesh->totalIndexCount = buildLods(indices, indexCount, positions,
+                                      src->vertex_count, &mesh->table);
+    boundingSphere(indices, indexCount, positions, mesh->table.center,
+                   &mesh->table.radius);
+    free(positions);
+
+    // vertices in the order the full level first uses them, so fetches walk
+    // forward through memory. the coarser levels only use a subset. unused
+    // vertices are dropped.
+    uint32_t vertexCount = 0;
+    memset(remap, 0xff, sizeof(uint32_t) * src->vertex_count);
+    for (uint32_t i = 0; i < mesh->totalIndexCount; i++)
+    {
+        if (remap[indices[i]] == UINT32_MAX)
+            remap[indices[i]] = vertexCount++;
+        indices[i] = remap[indices[i]];
+    }
+
+    // positions stay float in their own stream, where ray tracing and the
+    // bounds code read them. the rest are 4 bytes each, interleaved.
+    const uint32_t     stride  = tangents ? 16 : 8;
+    const VkDeviceSize posSize = (VkDeviceSize)vertexCount * 12;
+    mesh->vertexCount = vertexCount;
+    mesh->vertexSize  = posSize + (VkDeviceSize)vertexCount * stride;
+    mesh->vertices    = malloc(mesh->vertexSize);
+    assert(mesh->vertices);
+
+    const OnyxAttributeType types[] = {
+        ONYX_ATTRIBUTE_TYPE_POS, ONYX_ATTRIBUTE_TYPE_NORMAL,
+        ONYX_ATTRIBUTE_TYPE_TANGENT, ONYX_ATTRIBUTE_TYPE_SIGN,
+        ONYX_ATTRIBUTE_TYPE_UV};
+    const int typeCount = tangents ? 5 : 3;
+    mesh->templ         = (OnyxGeometryTemplate){.type  = src->templ.type,
+                                                 .flags = src->templ.flags};
+    for (int i = 0, offset = 0; i < typeCount; i++)
+    {
+        // without tangents the uv follows the normal
+        const int t = !tangents && i == 2 ? 4 : i;
+        mesh->templ.attribute_types[i] = types[t];
+        mesh->templ.attribute_sizes[i] = i == 0 ? 12 : 4;
+        mesh->attributeOffsets[i]      = i == 0 ? 0 : posSize + offset;
+        if (i > 0)
+            offset += 4;
+    }
+    mesh->templ.attribute_count = typeCount;
+
+    uint8_t* out = mesh->vertices;
+    for (uint32_t v = 0; v < src->vertex_count; v++)
+    {
+        const uint32_t to = remap[v];
+        if (to == UINT32_MAX)
+            continue;
+        memcpy(out + to * 12, attrs[SRC_POS] + v * 12, 12);
+
+        uint8_t* packed = out + posSize + (VkDeviceSize)to * stride;
+        float    f[3];
+        int16_t  oct[2];
+        memcpy(f, attrs[SRC_NORMAL] + v * 12, sizeof(f));
+        octEncode(f, oct);
+        memcpy(packed, oct, 4);
+        packed += 4;
+        if (tangents)
+        {
+            memcpy(f, attrs[SRC_TANGENT] + v * 12, sizeof(f));
+            octEncode(f, oct);
+            memcpy(packed, oct, 4);
+            memcpy(packed + 4, attrs[SRC_SIGN] + v * 4, 4);
+            packed += 8;
+        }
+        memcpy(f, attrs[SRC_UV] + v * 8, sizeof(float) * 2);
+        const uint16_t uv[2] = {halfFloat(f[0]), halfFloat(f[1])};
+        memcpy(packed, uv, 4);
+    }
+
+    free(remap);
+    return 0;
+}
+
+int
+geometry_Place(OnyxMemory* memory, const PackedMesh* mesh, OnyxGeometry* dst)
+{
+    const VkDeviceSize indexSize = sizeof(uint32_t) * mesh->indexCount;
+    const VkDeviceSize lodsSize  = sizeof(uint32_t) * mesh->totalIndexCount;
+
+    // the lod table, the vertices, then the indices of every level, in one
+    // allocation from a block
+    VkDeviceSize offset;
+    pthread_mutex_lock(&arena.lock);
+    const int block = blockAlloc(
+        memory, sizeof(GeometryLodTable) + mesh->vertexSize + lodsSize, &offset);
+    const OnyxBuffer blockRegion = block >= 0 ? arena.blocks[block].region
+                                              : (OnyxBuffer){0};
+    const uint64_t   id          = ++arena.lastId;
+    pthread_mutex_unlock(&arena.lock);
+    if (block < 0)
+    {
+        hell_print("Woad: all %d geometry blocks are in use\n",
+                   MAX_GEOMETRY_BLOCKS);
+        return -1;
+    }
+
+    *dst = (OnyxGeometry){.templ        = mesh->templ,
+                          .vertex_count = mesh->vertexCount,
+                          .index_count  = mesh->indexCount};
+    offset += sizeof(GeometryLodTable);
+    dst->vertex_region = subRegion(&blockRegion, offset, mesh->vertexSize);
+    // only the full level, for onyx and the blas builds
+    dst->index_region =
+        subRegion(&blockRegion, offset + mesh->vertexSize, indexSize);
+    for (int i = 0; i < mesh->templ.attribute_count; i++)
+        dst->attribute_offsets[i] =
+            dst->vertex_region.offset + mesh->attributeOffsets[i];
+    GeometryLodTable table = mesh->table;
+    table.id               = id;
+    memcpy(dst->vertex_region.host_data - sizeof(GeometryLodTable), &table,
+           sizeof(table));
+    memcpy(dst->vertex_region.host_data, mesh->vertices, mesh->vertexSize);
+    memcpy(dst->index_region.host_data, mesh->indices, lodsSize);
+    return 0;
+}
+
+void
+geometry_FreePacked(PackedMesh* mesh)
+{
+    free(mesh->vertices);
+    free(mesh->indices);
+    *mesh = (PackedMesh){0};
+}
+
+int
+woad_PackGeometry(OnyxMemory* memory, const OnyxGeometry* src,
+                  OnyxGeometry* dst)
+{
+    PackedMesh mesh;
+    if (geometry_Pack(src, &mesh) != 0)
+        return -1;
+    const int err = geometry_Place(memory, &mesh, dst);
+    geometry_FreePacked(&mesh);
+    return err;
+}
+
+void
+woad_FreeGeometry(OnyxGeometry* geo)
+{
+    pthread_mutex_lock(&arena.lock);
+    const int block = findBlock(geo);
+    if (block >= 0)
+    {
+        GeometryBlock* b = &arena.blocks[block];
+        if (--b->geoCount == 0)
+        {
+            onyx_free_buffer(&b->region);
+            *b = (GeometryBlock){0};
+            arena.generation++;
+        }
+    }
+    else
+    {
+        onyx_free_buffer(&geo->vertex_region);
+        onyx_free_buffer(&geo->index_region);
+    }
+    pthread_mutex_unlock(&arena.lock);
+    *geo = (OnyxGeometry){0};
+}
@@ -0,0 +1,94 @@
+#ifndef WOAD_GEOMETRY_H
+#define WOAD_GEOMETRY_H
+
+// woad_PackGeometry places geometry in a few large blocks shared by every
+// renderer. the packed vertex shaders read vertices from the blocks as
+// storage buffers, so draws of packed geometry only differ in the offsets
+// their instance gives, and the blas builds read the same memory.
+
+#include <onyx/onyx.h>
+#include <stdint.h>
+
+// must match MAX_GEOMETRY_BLOCKS in geometry.glsl
+#define MAX_GEOMETRY_BLOCKS 16
+
+// levels of detail per packed geometry, the full one included
+#define MAX_GEOMETRY_LODS 4
+
+typedef struct {
+    // from the start of the geometry's indices
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    // how far the level's surface may be from the full one, in object units
+    float    error;
+} GeometryLod;
+
+// kept just before a packed geometry's vertices. only the first level is in
+// the geometry's index region; the rest follow it in the block.
+typedef struct {
+    uint32_t    lodCount;
+    float       center[3];
+    float       radius;
+    GeometryLod lods[MAX_GEOMETRY_LODS];
+    uint32_t    pad;
+    // set when the geometry is placed and never given out again, so what is
+    // known about a geometry by it doesn't pass to one later packed at the
+    // same address or region
+    uint64_t    id;
+} GeometryLodTable;
+
+// blocks are made from the memory of whoever packs into them first, and
+// freed by whoever frees their last geometry, which may be another thread.
+// onyx memory isn't thread safe, so packing and woad_FreeGeometry hold this
+// lock for their memory calls, and a loader's workers take it for their
+// other calls on the memory they pack with.
+void
+geometry_LockMemory(void);
+
+void
+geometry_UnlockMemory(void);
+
+// bumped whenever a block is made or freed
+uint32_t
+geometry_Generation(void);
+
+// the storage buffer descriptor of every block, a null buffer where the
+// block is unused
+void
+geometry_Blocks(VkDescriptorBufferInfo infos[MAX_GEOMETRY_BLOCKS]);
+
+// the block geo was packed into, or -1. base is where the block's
+// descriptor starts in its buffer, which shader offsets are relative to.
+int
+geometry_FindBlock(const OnyxGeometry* geo, VkDeviceSize* base);
+
+// geo must be packed
+const GeometryLodTable*
+geometry_Lods(const OnyxGeometry* geo);
+
+// woad_PackGeometry in two steps: the packing, which touches no onyx
+// memory, and placing the result in a block
+typedef struct {
+    GeometryLodTable     table;
+    OnyxGeometryTemplate templ;
+    // from the start of the vertices
+    VkDeviceSize         attributeOffsets[8];
+    uint32_t             vertexCount;
+    // the full level's, then every level's
+    uint32_t             indexCount;
+    uint32_t             totalIndexCount;
+    VkDeviceSize         vertexSize;
+    uint8_t*             vertices;
+    uint32_t*            indices;
+} PackedMesh;
+
+int
+geometry_Pack(const OnyxGeometry* src, PackedMesh* mesh);
+
+int
+geometry_Place(OnyxMemory* memory, const PackedMesh* mesh, OnyxGeometry* dst);
+
+void
+geometry_FreePacked(PackedMesh* mesh);
+
+#endif
@@ -0,0 +1,500 @@
+#define COAL_SIMPLE_TYPE_NAMES
+#define ONYX_SIMPLE_TYPE_NAMES
+#include "graph.h"
+
+#include <assert.h>
+#include <onyx/onyx.h>
+#include <string.h>
+
+#define NO_PASS 0xff
+#define NO_IMAGE 0xff
+
+void
+graph_Init(RenderGraph* g, VkDevice device,
+           const VkPhysicalDeviceMemoryProperties* memoryProperties,
+           bool synchronization2)
+{
+    memset(g, 0, sizeof(*g));
+    g->device           = device;
+    g->memoryProperties = *memoryProperties;
+    g->synchronization2 = synchronization2;
+    g->retired          = graph_retired_arr_create(NULL);
+}
+
+static GraphImage
+addImage(RenderGraph* g, GraphImageInfo info)
+{
+    assert(g->imageCount < GRAPH_MAX_IMAGES);
+    info.first = NO_PASS;
+    info.last  = NO_PASS;
+    info.block = NO_IMAGE;
+    g->images[g->imageCount] = info;
+    return g->imageCount++;
+}
+
+GraphImage
+graph_CreateImage(RenderGraph* g, VkFormat format, VkImageUsageFlags usage,
+                  VkImageAspectFlags aspect, uint32_t layers)
+{
+    return addImage(g, (GraphImageInfo){.aspect    = aspect,
+                                        .transient = true,
+                                        .format    = format,
+                                        .usage     = usage,
+                                        .layers    = layers});
+}
+
+GraphImage
+graph_ImportImage(RenderGraph* g, VkImageAspectFlags aspect)
+{
+    return addImage(g, (GraphImageInfo){.aspect = aspect});
+}
+
+void
+graph_ExportImage(RenderGraph* g, GraphImage image, VkImageLayout finalLayout)
+{
+    // a transient image has nothing left in it once the graph is done
+    assert(!g->images[image].transient);
+    g->images[image].exported    = true;
+    g->images[image].finalLayout = finalLayout;
+}
+
+GraphPass
+graph_AddPass(RenderGraph* g, GraphRecordFn record, bool output)
+{
+    assert(g->passCount < GRAPH_MAX_PASSES);
+    g->passes[g->passCount] =
+        (GraphPassInfo){.record = record, .output = output};
+    return g->passCount++;
+}
+
+static void
+addAccess(RenderGraph* g, GraphPass pass, GraphAccess access)
+{
+    GraphPassInfo* p = &g->passes[pass];
+    assert(p->accessCount < GRAPH_MAX_ACCESSES);
+    p->accesses[p->accessCount++] = access;
+}
+
+void
+graph_Read(RenderGraph* g, GraphPass pass, GraphImage image,
+           VkPipelineStageFlags2 stages, VkAccessFlags2 access,
+           VkImageLayout layout)
+{
+    addAccess(g, pass,
+              (GraphAccess){.image  = image,
+                            .stages = stages,
+                            .access = access,
+                            .layout = layout});
+}
+
+void
+graph_Write(RenderGraph* g, GraphPass pass, GraphImage image,
+            VkPipelineStageFlags2 stages, VkAccessFlags2 access,
+            VkImageLayout layout)
+{
+    addAccess(g, pass,
+              (GraphAccess){.image  = image,
+                            .write  = true,
+                            .stages = stages,
+                            .access = access,
+                            .layout = layout});
+}
+
+void
+graph_Compile(RenderGraph* g)
+{
+    // walk back from the end: a pass is kept if it is an output or writes an
+    // image that is exported or read by a kept pass after it. passes may
+    // write only part of an image, so an earlier writer is kept too.
+    bool needed[GRAPH_MAX_IMAGES] = {0};
+    for (int i = 0; i < g->imageCount; i++)
+        needed[i] = g->images[i].exported;
+
+    for (int p = g->passCount - 1; p >= 0; p--)
+    {
+        GraphPassInfo* pass = &g->passes[p];
+        bool           live = pass->output;
+        for (int a = 0; a < pass->accessCount; a++)
+        {
+            if (pass->accesses[a].write && needed[pass->accesses[a].image])
+                live = true;
+        }
+        pass->culled = !live;
+        if (!live)
+            continue;
+        for (int a = 0; a < pass->accessCount; a++)
+            needed[pass->accesses[a].image] = true;
+    }
+
+    for (int p = 0; p < g->passCount; p++)
+    {
+        const GraphPassInfo* pass = &g->passes[p];
+        if (pass->culled)
+            continue;
+        for (int a = 0; a < pass->accessCount; a++)
+        {
+            GraphImageInfo* img = &g->images[pass->accesses[a].image];
+            if (img->first == NO_PASS)
+                img->first = p;
+            img->last = p;
+        }
+    }
+}
+
+static uint32_t
+memoryType(const RenderGraph* g, uint32_t typeBits,
+           VkMemoryPropertyFlags properties)
+{
+    const VkPhysicalDeviceMemoryProperties* props = &g->memoryProperties;
+    for (uint32_t i = 0; i < props->memoryTypeCount; i++)
+    {
+        if ((typeBits & (1u << i)) &&
+            (props->memoryTypes[i].propertyFlags & properties) == properties)
+            return i;
+    }
+    fatal_error("Woad: no suitable memory type for transient image.");
+    return 0;
+}
+
+static void
+retire(RenderGraph* g, VkImage image, VkImageView view, VkDeviceMemory memory,
+       uint64_t retireAt)
+{
+    const GraphRetired retired = {.image    = image,
+                                  .view     = view,
+                                  .memory   = memory,
+                                  .retireAt = retireAt};
+    graph_retired_arr_push(&g->retired, retired);
+}
+
+static void
+retireTransients(RenderGraph* g, uint64_t retireAt)
+{
+    for (int i = 0; i < g->imageCount; i++)
+    {
+        GraphImageInfo* img = &g->images[i];
+        if (img->transient && img->handle != VK_NULL_HANDLE)
+            retire(g, img->handle, img->view, VK_NULL_HANDLE, retireAt);
+        if (img->transient)
+        {
+            img->handle = VK_NULL_HANDLE;
+            img->view   = VK_NULL_HANDLE;
+        }
+    }
+    for (int b = 0; b < g->blockCount; b++)
+        retire(g, VK_NULL_HANDLE, VK_NULL_HANDLE, g->blocks[b].memory,
+               retireAt);
+    g->blockCount = 0;
+}
+
+void
+graph_Allocate(RenderGraph* g, uint32_t width, uint32_t height,
+               uint64_t retireAt)
+{
+    retireTransients(g, retireAt);
+
+    // in order of first use, each image goes into the first block whose
+    // images are all done with before it starts
+    VkMemoryRequirements reqs[GRAPH_MAX_IMAGES];
+    for (int p = 0; p < g->passCount; p++)
+    {
+        for (int i = 0; i < g->imageCount; i++)
+        {
+            GraphImageInfo* img = &g->images[i];
+            if (!img->transient || img->first != p)
+                continue;
+
+            const VkImageCreateInfo imageInfo = {
+                .sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                .imageType     = VK_IMAGE_TYPE_2D,
+                .format        = img->format,
+                .extent        = {width, height, 1},
+                .mipLevels     = 1,
+                .arrayLayers   = img->layers,
+                .samples       = VK_SAMPLE_COUNT_1_BIT,
+                .tiling        = VK_IMAGE_TILING_OPTIMAL,
+                .usage         = img->usage,
+                .sharingMode   = VK_SHARING_MODE_EXCLUSIVE,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED};
+            V_ASSERT(vkCreateImage(g->device, &imageInfo, NULL, &img->handle));
+            vkGetImageMemoryRequirements(g->device, img->handle, &reqs[i]);
+
+            int b = 0;
+            for (; b < g->blockCount; b++)
+            {
+                if (g->blocks[b].last < p &&
+                    (g->blocks[b].typeBits & reqs[i].memoryTypeBits))
+                    break;
+            }
+            if (b == g->blockCount)
+                g->blocks[g->blockCount++] =
+                    (GraphBlock){.typeBits = reqs[i].memoryTypeBits};
+
+            GraphBlock* block = &g->blocks[b];
+            block->typeBits &= reqs[i].memoryTypeBits;
+            if (reqs[i].size > block->size)
+                block->size = reqs[i].size;
+            block->last = img->last;
+            img->block  = b;
+        }
+    }
+
+    for (int b = 0; b < g->blockCount; b++)
+    {
+        GraphBlock* block = &g->blocks[b];
+        const VkMemoryAllocateInfo allocInfo = {
+            .sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .allocationSize  = block->size,
+            .memoryTypeIndex = memoryType(g, block->typeBits,
+                                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)};
+        V_ASSERT(vkAllocateMemory(g->device, &allocInfo, NULL, &block->memory));
+        block->owner = NO_IMAGE;
+        block->state = (GraphState){.layout = VK_IMAGE_LAYOUT_UNDEFINED};
+    }
+
+    for (int i = 0; i < g->imageCount; i++)
+    {
+        GraphImageInfo* img = &g->images[i];
+        if (img->handle == VK_NULL_HANDLE || !img->transient)
+            continue;
+        // every image in a block starts at its beginning, which satisfies
+        // any alignment
+        V_ASSERT(vkBindImageMemory(g->device, img->handle,
+                                   g->blocks[img->block].memory, 0));
+
+        const VkImageViewCreateInfo viewInfo = {
+            .sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image            = img->handle,
+            .viewType         = VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+            .format           = img->format,
+            .subresourceRange = {img->aspect, 0, 1, 0, img->layers}};
+        V_ASSERT(vkCreateImageView(g->device, &viewInfo, NULL, &img->view));
+    }
+}
+
+void
+graph_Collect(RenderGraph* g, uint64_t now)
+{
+    int i = 0;
+    while (i < g->retired.count)
+    {
+        const GraphRetired* retired = &g->retired.elems[i];
+        if (retired->retireAt > now)
+        {
+            i++;
+            continue;
+        }
+        if (retired->view != VK_NULL_HANDLE)
+            vkDestroyImageView(g->device, retired->view, NULL);
+        if (retired->image != VK_NULL_HANDLE)
+            vkDestroyImage(g->device, retired->image, NULL);
+        if (retired->memory != VK_NULL_HANDLE)
+            vkFreeMemory(g->device, retired->memory, NULL);
+        g->retired.elems[i] = g->retired.elems[g->retired.count - 1];
+        graph_retired_arr_set_count(&g->retired, g->retired.count - 1);
+    }
+}
+
+VkImageView
+graph_ImageView(const RenderGraph* g, GraphImage image)
+{
+    return g->images[image].view;
+}
+
+void
+graph_BindImage(RenderGraph* g, GraphImage image, VkImage handle,
+                VkImageLayout layout, VkPipelineStageFlags2 stages)
+{
+    GraphImageInfo* img = &g->images[image];
+    assert(!img->transient);
+    if (img->handle == handle)
+        return;
+    img->handle = handle;
+    // treat the unknown last use as a write, so the first access waits for
+    // it whatever it is
+    img->state  = (GraphState){.writeStages = stages, .layout = layout};
+}
+
+// transient images sharing a block take over its state, and whatever the
+// previous image left in the memory is discarded
+static GraphState*
+imageState(RenderGraph* g, GraphImage image)
+{
+    GraphImageInfo* img = &g->images[image];
+    if (!img->transient)
+        return &img->state;
+    GraphBlock* block = &g->blocks[img->block];
+    if (block->owner != image)
+    {
+        block->owner        = image;
+        block->state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+    return &block->state;
+}
+
+static VkImageMemoryBarrier2
+imageBarrier(const GraphImageInfo* img, const GraphState* state,
+             VkPipelineStageFlags2 srcStages, VkPipelineStageFlags2 dstStages,
+             VkAccessFlags2 dstAccess, VkImageLayout newLayout)
+{
+    return (VkImageMemoryBarrier2){
+        .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .srcStageMask        = srcStages,
+        .srcAccessMask       = state->writeAccess,
+        .dstStageMask        = dstStages,
+        .dstAccessMask       = dstAccess,
+        .oldLayout           = state->layout,
+        .newLayout           = newLayout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image               = img->handle,
+        .subresourceRange    = {img->aspect, 0, VK_REMAINING_MIP_LEVELS, 0,
+                                VK_REMAINING_ARRAY_LAYERS}};
+}
+
+// the stages and access of synchronization2 that vulkan 1.0 lacks are the
+// high 32 bits, each a narrower form of an older one. the rest are the same.
+static VkPipelineStageFlags
+sync1Stages(VkPipelineStageFlags2 stages, VkPipelineStageFlags none)
+{
+    VkPipelineStageFlags flags = (VkPipelineStageFlags)stages;
+    if (stages & (VK_PIPELINE_STAGE_2_COPY_BIT |
+                  VK_PIPELINE_STAGE_2_RESOLVE_BIT |
+                  VK_PIPELINE_STAGE_2_BLIT_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT))
+        flags |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+    if (stages & (VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT |
+                  VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT))
+        flags |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    if (stages & VK_PIPELINE_STAGE_2_PRE_RASTERIZATION_SHADERS_BIT)
+        flags |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                 VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT;
+    // vulkan 1.0 has no empty stage mask
+    return flags ? flags : none;
+}
+
+static VkAccessFlags
+sync1Access(VkAccessFlags2 access)
+{
+    VkAccessFlags flags = (VkAccessFlags)access;
+    if (access & (VK_ACCESS_2_SHADER_SAMPLED_READ_BIT |
+                  VK_ACCESS_2_SHADER_STORAGE_READ_BIT))
+        flags |= VK_ACCESS_SHADER_READ_BIT;
+    if (access & VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT)
+        flags |= VK_ACCESS_SHADER_WRITE_BIT;
+    return flags;
+}
+
+static void
+cmdBarriers(const RenderGraph* g, VkCommandBuffer cmdbuf,
+            const VkImageMemoryBarrier2* barriers, uint32_t count)
+{
+    if (count == 0)
+        return;
+    if (g->synchronization2)
+    {
+        const VkDependencyInfo dep = {
+            .sType                   = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .imageMemoryBarrierCount = count,
+            .pImageMemoryBarriers    = barriers};
+        vkCmdPipelineBarrier2(cmdbuf, &dep);
+        return;
+    }
+
+    // one barrier command takes one set of stages for all its images
+    VkImageMemoryBarrier  sync1[GRAPH_MAX_IMAGES];
+    VkPipelineStageFlags2 srcStages = 0, dstStages = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const VkImageMemoryBarrier2* b = &barriers[i];
+        srcStages |= b->srcStageMask;
+        dstStages |= b->dstStageMask;
+        sync1[i] = (VkImageMemoryBarrier){
+            .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask       = sync1Access(b->srcAccessMask),
+            .dstAccessMask       = sync1Access(b->dstAccessMask),
+            .oldLayout           = b->oldLayout,
+            .newLayout           = b->newLayout,
+            .srcQueueFamilyIndex = b->srcQueueFamilyIndex,
+            .dstQueueFamilyIndex = b->dstQueueFamilyIndex,
+            .image               = b->image,
+            .subresourceRange    = b->subresourceRange};
+    }
+    vkCmdPipelineBarrier(
+        cmdbuf, sync1Stages(srcStages, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT),
+        sync1Stages(dstStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT), 0, 0,
+        NULL, 0, NULL, count, sync1);
+}
+
+void
+graph_Execute(RenderGraph* g, VkCommandBuffer cmdbuf, uint32_t passMask,
+              void* data)
+{
+    VkImageMemoryBarrier2 barriers[GRAPH_MAX_IMAGES];
+    for (int p = 0; p < g->passCount; p++)
+    {
+        const GraphPassInfo* pass = &g->passes[p];
+        if (pass->culled || !(passMask & (1u << p)))
+            continue;
+
+        uint32_t barrierCount = 0;
+        for (int a = 0; a < pass->accessCount; a++)
+        {
+            const GraphAccess* access = &pass->accesses[a];
+            GraphState*        state  = imageState(g, access->image);
+            const bool relayout = state->layout != access->layout;
+
+            // a write or a layout change waits for every use since the last
+            // write. a read only waits for the last write, and only once per
+            // stage.
+            VkPipelineStageFlags2 src = 0;
+            if (access->write || relayout)
+                src = state->writeStages | state->readStages;
+            else if (access->stages & ~state->readStages)
+                src = state->writeStages;
+
+            if (src != 0 || relayout)
+                barriers[barrierCount++] = imageBarrier(
+                    &g->images[access->image], state,
+                    src ? src : VK_PIPELINE_STAGE_2_NONE, access->stages,
+                    access->access, access->layout);
+
+            if (access->write)
+                *state = (GraphState){.writeStages = access->stages,
+                                      .writeAccess = access->access};
+            else if (relayout)
+                // the transition is a write that later readers wait for
+                *state = (GraphState){.writeStages = access->stages,
+                                      .readStages  = access->stages};
+            else
+                state->readStages |= access->stages;
+            state->layout = access->layout;
+        }
+        cmdBarriers(g, cmdbuf, barriers, barrierCount);
+
+        pass->record(cmdbuf, data);
+    }
+
+    uint32_t barrierCount = 0;
+    for (int i = 0; i < g->imageCount; i++)
+    {
+        const GraphImageInfo* img   = &g->images[i];
+        GraphState*           state = &g->images[i].state;
+        if (!img->exported || state->layout == img->finalLayout)
+            continue;
+        barriers[barrierCount++] = imageBarrier(
+            img, state, state->writeStages | state->readStages,
+            VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, 0, img->finalLayout);
+        // whatever uses it after us is unknown
+        *state = (GraphState){.writeStages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                              .layout      = img->finalLayout};
+    }
+    cmdBarriers(g, cmdbuf, barriers, barrierCount);
+}
+
+void
+graph_Free(RenderGraph* g)
+{
+    retireTransients(g, 0);
+    graph_Collect(g, UINT64_MAX);
+    graph_retired_arr_free(&g->retired);
+}
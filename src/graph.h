@@ -0,0 +1,180 @@
+#ifndef WOAD_GRAPH_H
+#define WOAD_GRAPH_H
+
+// a small render graph. passes are added in the order they run and declare
+// the images they read and write. from that the graph drops passes whose
+// results nothing uses, places the image barriers between passes, and lets
+// transient images whose passes don't overlap share memory.
+//
+// the passes and images are declared once. each frame the imported images
+// are bound and the graph is executed with the passes that have work to do.
+
+#include <hell/hell.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#define GRAPH_MAX_PASSES   12
+#define GRAPH_MAX_IMAGES   16
+#define GRAPH_MAX_ACCESSES 8
+
+typedef uint8_t GraphImage;
+typedef uint8_t GraphPass;
+
+typedef void (*GraphRecordFn)(VkCommandBuffer cmdbuf, void* data);
+
+typedef struct {
+    GraphImage            image;
+    bool                  write;
+    VkPipelineStageFlags2 stages;
+    VkAccessFlags2        access;
+    VkImageLayout         layout;
+} GraphAccess;
+
+typedef struct {
+    GraphRecordFn record;
+    GraphAccess   accesses[GRAPH_MAX_ACCESSES];
+    uint8_t       accessCount;
+    // its effects reach beyond the graph's images, so it is never culled
+    bool          output;
+    bool          culled;
+} GraphPassInfo;
+
+// where an image's last use left it. reads since the last write are kept
+// apart so that a later write waits for all of them but a later read
+// waits only for the write.
+typedef struct {
+    VkPipelineStageFlags2 writeStages;
+    VkAccessFlags2        writeAccess;
+    VkPipelineStageFlags2 readStages;
+    VkImageLayout         layout;
+} GraphState;
+
+typedef struct {
+    VkImage            handle;
+    VkImageView        view;
+    VkImageAspectFlags aspect;
+    GraphState         state;
+    bool               transient;
+    // transient images only
+    VkFormat           format;
+    VkImageUsageFlags  usage;
+    uint32_t           layers;
+    uint8_t            block;
+    // first and last pass that uses it, after culling
+    GraphPass          first;
+    GraphPass          last;
+    // exported images are left in finalLayout and keep their passes alive
+    bool               exported;
+    VkImageLayout      finalLayout;
+} GraphImageInfo;
+
+// memory shared by transient images that are never alive at once
+typedef struct {
+    VkDeviceMemory memory;
+    VkDeviceSize   size;
+    uint32_t       typeBits;
+    GraphPass      last;
+    // the image whose contents the memory holds
+    GraphImage     owner;
+    // what the block's last image was doing when the last execute ended
+    GraphState     state;
+} GraphBlock;
+
+// resources a frame in flight may still use, freed once retireAt renders
+// have been made
+typedef struct {
+    VkImage        image;
+    VkImageView    view;
+    VkDeviceMemory memory;
+    uint64_t       retireAt;
+} GraphRetired;
+
+define_array_type(GraphRetired, graph_retired);
+
+typedef struct {
+    VkDevice                         device;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    // barriers are recorded with vkCmdPipelineBarrier2, else translated to
+    // vulkan 1.0 ones
+    bool                             synchronization2;
+    GraphPassInfo                    passes[GRAPH_MAX_PASSES];
+    GraphImageInfo                   images[GRAPH_MAX_IMAGES];
+    GraphBlock                       blocks[GRAPH_MAX_IMAGES];
+    uint8_t                          passCount;
+    uint8_t                          imageCount;
+    uint8_t                          blockCount;
+    GraphRetiredArray                retired;
+} RenderGraph;
+
+void
+graph_Init(RenderGraph* graph, VkDevice device,
+           const VkPhysicalDeviceMemoryProperties* memoryProperties,
+           bool synchronization2);
+
+// an image owned by the graph, made by graph_Allocate. its contents do not
+// outlive the passes that use it in one execute.
+GraphImage
+graph_CreateImage(RenderGraph* graph, VkFormat format, VkImageUsageFlags usage,
+                  VkImageAspectFlags aspect, uint32_t layers);
+
+// an image owned by the caller and bound with graph_BindImage before each
+// execute
+GraphImage
+graph_ImportImage(RenderGraph* graph, VkImageAspectFlags aspect);
+
+// the image is used after the graph, so the passes writing it are kept and
+// it is left in finalLayout
+void
+graph_ExportImage(RenderGraph* graph, GraphImage image,
+                  VkImageLayout finalLayout);
+
+GraphPass
+graph_AddPass(RenderGraph* graph, GraphRecordFn record, bool output);
+
+void
+graph_Read(RenderGraph* graph, GraphPass pass, GraphImage image,
+           VkPipelineStageFlags2 stages, VkAccessFlags2 access,
+           VkImageLayout layout);
+
+void
+graph_Write(RenderGraph* graph, GraphPass pass, GraphImage image,
+            VkPipelineStageFlags2 stages, VkAccessFlags2 access,
+            VkImageLayout layout);
+
+// culls passes and works out when each transient image is alive. called
+// once, after every pass is declared.
+void
+graph_Compile(RenderGraph* graph);
+
+// (re)makes the transient images at the given size, letting images that are
+// never alive at once share memory. the previous ones are freed by the
+// graph_Collect call that is passed retireAt or later.
+void
+graph_Allocate(RenderGraph* graph, uint32_t width, uint32_t height,
+               uint64_t retireAt);
+
+void
+graph_Collect(RenderGraph* graph, uint64_t now);
+
+VkImageView
+graph_ImageView(const RenderGraph* graph, GraphImage image);
+
+// layout is where the image is now and stages where it was last used, 0 if
+// that is known to have completed. if the handle is the one bound to the
+// last execute, the graph keeps what that execute left instead.
+void
+graph_BindImage(RenderGraph* graph, GraphImage image, VkImage handle,
+                VkImageLayout layout, VkPipelineStageFlags2 stages);
+
+// records the passes in passMask, bit i for pass i, that were not culled,
+// with the barriers between them. data is given to each record function.
+void
+graph_Execute(RenderGraph* graph, VkCommandBuffer cmdbuf, uint32_t passMask,
+              void* data);
+
+// the caller must have waited for every execute
+void
+graph_Free(RenderGraph* graph);
+
+#endif
@@ -0,0 +1,285 @@
+#define COAL_SIMPLE_TYPE_NAMES
+#define ONYX_SIMPLE_TYPE_NAMES
+#include "woad.h"
+#include "cache.h"
+#include "geometry.h"
+
+#include <assert.h>
+#include <hell/hell.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LOAD_WORKERS 8
+
+typedef struct LoadJob {
+    struct LoadJob*      next;
+    char*                path;
+    OnyxGeometryTemplate templ;
+    Mat4                 xform;
+    OnyxMaterialHandle   material;
+    // the result, NULL if the load failed
+    OnyxGeometry*        geo;
+} LoadJob;
+
+typedef struct {
+    LoadJob* head;
+    LoadJob* tail;
+} LoadQueue;
+
+typedef OnyxGeometry* GeoPtr;
+
+define_array_type(GeoPtr, geo_ptr);
+
+struct WoadLoader {
+    OnyxMemory*     memory;
+    // may be NULL
+    WoadSceneCache* cache;
+    pthread_t       workers[MAX_LOAD_WORKERS];
+    uint32_t        workerCount;
+
+    // guards everything below
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;
+    LoadQueue       queued;
+    LoadQueue       finished;
+    // queued, being loaded, or finished but not yet published
+    uint32_t        pending;
+    bool            quit;
+    // everything loaded, freed with the loader
+    GeoPtrArray     geos;
+};
+
+static void
+pushJob(LoadQueue* queue, LoadJob* job)
+{
+    job->next = NULL;
+    if (queue->tail)
+        queue->tail->next = job;
+    else
+        queue->head = job;
+    queue->tail = job;
+}
+
+static LoadJob*
+popJob(LoadQueue* queue)
+{
+    LoadJob* job = queue->head;
+    if (job)
+    {
+        queue->head = job->next;
+        if (!queue->head)
+            queue->tail = NULL;
+    }
+    return job;
+}
+
+static void
+freeJobs(LoadQueue* queue)
+{
+    for (LoadJob* job; (job = popJob(queue));)
+    {
+        free(job->path);
+        free(job);
+    }
+}
+
+static OnyxGeometry*
+placeMesh(WoadLoader* l, const PackedMesh* mesh)
+{
+    OnyxGeometry* geo = malloc(sizeof(OnyxGeometry));
+    assert(geo);
+    if (geometry_Place(l->memory, mesh, geo) != 0)
+    {
+        free(geo);
+        return NULL;
+    }
+    return geo;
+}
+
+// straight from the cache, skipping the parsing and packing
+static OnyxGeometry*
+loadCachedMesh(WoadLoader* l, uint64_t key)
+{
+    PackedMesh   mesh;
+    CacheMapping mapping;
+    if (cache_MapMesh(l->cache, key, &mesh, &mapping) != 0)
+        return NULL;
+    OnyxGeometry* geo = placeMesh(l, &mesh);
+    cache_UnmapMesh(&mapping);
+    return geo;
+}
+
+// the first mesh of the file, packed into a geometry block. NULL on failure.
+static OnyxGeometry*
+loadMesh(WoadLoader* l, LoadJob* job)
+{
+    uint64_t   key;
+    const bool cached =
+        l->cache && cache_MeshKey(job->path, &job->templ, &key) == 0;
+    if (cached)
+    {
+        OnyxGeometry* geo = loadCachedMesh(l, key);
+        if (geo)
+        {
+            cache_Remember(l->cache, geometry_Lods(geo)->id, key);
+            return geo;
+        }
+    }
+
+    HellGltfData gltf;
+    if (hell_gltf_init(job->path, &gltf) != 0)
+        return NULL;
+
+    // the app thread may free blocks made from this memory meanwhile. only
+    // the parsing and packing run in parallel.
+    OnyxGeometry src;
+    geometry_LockMemory();
+    const int err = hell_gltf_read_mesh(&gltf, l->memory, &job->templ, &src);
+    geometry_UnlockMemory();
+    hell_gltf_term(&gltf);
+    if (err)
+        return NULL;
+
+    PackedMesh    mesh;
+    OnyxGeometry* geo    = NULL;
+    const bool    packed = geometry_Pack(&src, &mesh) == 0;
+
+    woad_FreeGeometry(&src);
+    if (packed)
+        geo = placeMesh(l, &mesh);
+    if (!packed)
+        return NULL;
+    if (cached)
+    {
+        cache_StoreMesh(l->cache, key, &mesh);
+        if (geo)
+            cache_Remember(l->cache, geometry_Lods(geo)->id, key);
+    }
+    geometry_FreePacked(&mesh);
+    return geo;
+}
+
+static void*
+loadWorker(void* data)
+{
+    WoadLoader* l = data;
+    pthread_mutex_lock(&l->lock);
+    while (!l->quit)
+    {
+        LoadJob* job = popJob(&l->queued);
+        if (!job)
+        {
+            pthread_cond_wait(&l->wake, &l->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&l->lock);
+        job->geo = loadMesh(l, job);
+        pthread_mutex_lock(&l->lock);
+        if (job->geo)
+            geo_ptr_arr_push(&l->geos, job->geo);
+        pushJob(&l->finished, job);
+    }
+    pthread_mutex_unlock(&l->lock);
+    return NULL;
+}
+
+WoadLoader*
+woad_CreateLoader(OnyxMemory* memory, WoadSceneCache* cache,
+                  uint32_t workerCount)
+{
+    WoadLoader* l = calloc(1, sizeof(WoadLoader));
+    assert(l);
+    l->memory = memory;
+    l->cache  = cache;
+    l->geos   = geo_ptr_arr_create(NULL);
+    pthread_mutex_init(&l->lock, NULL);
+    pthread_cond_init(&l->wake, NULL);
+    if (workerCount < 1)
+        workerCount = 1;
+    if (workerCount > MAX_LOAD_WORKERS)
+        workerCount = MAX_LOAD_WORKERS;
+    l->workerCount = workerCount;
+    for (uint32_t i = 0; i < workerCount; i++)
+    {
+        const int err = pthread_create(&l->workers[i], NULL, loadWorker, l);
+        assert(!err);
+    }
+    return l;
+}
+
+void
+woad_LoadMesh(WoadLoader* l, const char* path,
+              const OnyxGeometryTemplate* templ, Mat4 xform,
+              OnyxMaterialHandle material)
+{
+    LoadJob* job = calloc(1, sizeof(LoadJob));
+    assert(job);
+    job->path = strdup(path);
+    assert(job->path);
+    job->templ    = *templ;
+    job->xform    = xform;
+    job->material = material;
+
+    pthread_mutex_lock(&l->lock);
+    pushJob(&l->queued, job);
+    l->pending++;
+    pthread_cond_signal(&l->wake);
+    pthread_mutex_unlock(&l->lock);
+}
+
+uint32_t
+woad_PublishLoads(WoadLoader* l, OnyxScene* scene, uint32_t maxPrims)
+{
+    LoadQueue ready = {0};
+    pthread_mutex_lock(&l->lock);
+    for (uint32_t i = 0; i < maxPrims; i++)
+    {
+        LoadJob* job = popJob(&l->finished);
+        if (!job)
+            break;
+        pushJob(&ready, job);
+        l->pending--;
+    }
+    const uint32_t pending = l->pending;
+    pthread_mutex_unlock(&l->lock);
+
+    // the scene is only touched here, on the caller's thread
+    for (LoadJob* job; (job = popJob(&ready));)
+    {
+        if (job->geo)
+            onyx_scene_add_prim(scene, job->geo, job->xform, job->material);
+        else
+            hell_print("Woad: failed to load %s\n", job->path);
+        free(job->path);
+        free(job);
+    }
+    return pending;
+}
+
+void
+woad_DestroyLoader(WoadLoader* l)
+{
+    pthread_mutex_lock(&l->lock);
+    l->quit = true;
+    pthread_cond_broadcast(&l->wake);
+    pthread_mutex_unlock(&l->lock);
+    for (uint32_t i = 0; i < l->workerCount; i++)
+        pthread_join(l->workers[i], NULL);
+
+    // loads that never started are dropped
+    freeJobs(&l->queued);
+    freeJobs(&l->finished);
+    for (int i = 0; i < l->geos.count; i++)
+    {
+        // the app may have freed it already
+        if (l->cache && l->geos.elems[i]->vertex_region.host_data)
+            cache_Forget(l->cache, geometry_Lods(l->geos.elems[i])->id);
+        woad_FreeGeometry(l->geos.elems[i]);
+        free(l->geos.elems[i]);
+    }
+    geo_ptr_arr_free(&l->geos);
+    pthread_mutex_destroy(&l->lock);
+    pthread_cond_destroy(&l->wake);
+    free(l);
+}
@@ -0,0 +1,584 @@
+#define COAL_SIMPLE_TYPE_NAMES
+#define ONYX_SIMPLE_TYPE_NAMES
+#include "woad.h"
+#include "streaming.h"
+#include "texture.h"
+
+#include <assert.h>
+#include <hell/hell.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// levels this size and under are loaded with the texture and never dropped
+#define STREAM_TAIL_SIZE 64
+// a texture not sampled in this many updates that could have seen it, those
+// whose demand was complete, only needs its tail, so the rest may be dropped
+// to make room
+#define STREAM_IDLE_UPDATES 120
+#define MAX_STREAM_LOADS 4
+#define STAGING_ALIGNMENT 16
+
+typedef struct {
+    // what the scene samples. replaced in place whenever the levels change,
+    // so the scene's pointer to it stays good.
+    OnyxImage image;
+    char*     path;
+    Ktx2Info  info;
+    VkFormat  format;
+    uint32_t  mipCount;
+    // the first level that is always resident
+    uint32_t  tailMip;
+    // the first level in image, mipCount before there is one
+    uint32_t  residentMip;
+    // the finest level the gbuffer pass last asked for
+    uint32_t  wantedMip;
+    uint64_t  lastSeen;
+    // complete updates since it was last seen
+    uint32_t  missed;
+    // the scene texture it was last found at
+    uint32_t  slot;
+    bool      loading;
+} StreamedTexture;
+
+typedef StreamedTexture* StreamedTexturePtr;
+
+define_array_type(StreamedTexturePtr, streamed_texture_ptr);
+
+// levels firstMip up to lastMip of a texture, read by the worker
+typedef struct StreamLoad {
+    struct StreamLoad* next;
+    StreamedTexture*   tex;
+    uint32_t           firstMip;
+    uint32_t           lastMip;
+    // the device memory reserved for the levels
+    VkDeviceSize       cost;
+    // the levels, STAGING_ALIGNMENT apart. NULL if the read failed.
+    uint8_t*           data;
+    VkDeviceSize       offsets[MAX_TEXTURE_LEVELS];
+    VkDeviceSize       size;
+} StreamLoad;
+
+typedef struct {
+    StreamLoad* head;
+    StreamLoad* tail;
+} LoadQueue;
+
+// a replaced image and the staging buffer of the levels that replaced it,
+// freed once the gpu is done with both
+typedef struct {
+    OnyxImage  image;
+    OnyxBuffer staging;
+    uint64_t   retireAt;
+} RetiredImage;
+
+define_array_type(RetiredImage, retired_image);
+
+struct WoadTextureStreamer {
+    const OnyxInstance*     instance;
+    OnyxMemory*             memory;
+    VkDeviceSize            budget;
+    // the levels in every image, and those being loaded
+    VkDeviceSize            resident;
+    VkDeviceSize            reserved;
+    uint64_t                updates;
+    uint32_t                loadCount;
+    StreamedTexturePtrArray textures;
+    RetiredImageArray       retired;
+
+    pthread_t       worker;
+    // guards everything below
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;
+    LoadQueue       queued;
+    LoadQueue       finished;
+    bool            quit;
+};
+
+static void
+pushLoad(LoadQueue* queue, StreamLoad* load)
+{
+    load->next = NULL;
+    if (queue->tail)
+        queue->tail->next = load;
+    else
+        queue->head = load;
+    queue->tail = load;
+}
+
+static StreamLoad*
+popLoad(LoadQueue* queue)
+{
+    StreamLoad* load = queue->head;
+    if (load)
+    {
+        queue->head = load->next;
+        if (!queue->head)
+            queue->tail = NULL;
+    }
+    return load;
+}
+
+static void
+freeLoads(LoadQueue* queue)
+{
+    for (StreamLoad* load; (load = popLoad(queue));)
+    {
+        free(load->data);
+        free(load);
+    }
+}
+
+static VkDeviceSize
+mipSize(const StreamedTexture* tex, uint32_t mip)
+{
+    return texture_LevelSize(tex->format,
+                             texture_LevelDim(tex->info.width, mip),
+                             texture_LevelDim(tex->info.height, mip));
+}
+
+// the device memory of levels firstMip down
+static VkDeviceSize
+chainSize(const StreamedTexture* tex, uint32_t firstMip)
+{
+    VkDeviceSize size = 0;
+    for (uint32_t m = firstMip; m < tex->mipCount; m++)
+        size += mipSize(tex, m);
+    return size;
+}
+
+static void
+readLevels(StreamLoad* load)
+{
+    const StreamedTexture* tex = load->tex;
+    load->size                 = 0;
+    for (uint32_t m = load->firstMip; m < load->lastMip; m++)
+    {
+        load->offsets[m] = load->size;
+        load->size = (load->size + mipSize(tex, m) + STAGING_ALIGNMENT - 1) &
+                     ~(VkDeviceSize)(STAGING_ALIGNMENT - 1);
+    }
+
+    load->data = NULL;
+    FILE* file = fopen(tex->path, "rb");
+    if (!file)
+        return;
+    load->data = malloc(load->size);
+    assert(load->data);
+    for (uint32_t m = load->firstMip; m < load->lastMip; m++)
+    {
+        const VkDeviceSize size = mipSize(tex, m);
+        if (fseek(file, (long)tex->info.offsets[m], SEEK_SET) != 0 ||
+            fread(load->data + load->offsets[m], 1, size, file) != size)
+        {
+            free(load->data);
+            load->data = NULL;
+            break;
+        }
+    }
+    fclose(file);
+}
+
+static void*
+streamWorker(void* data)
+{
+    WoadTextureStreamer* s = data;
+    pthread_mutex_lock(&s->lock);
+    while (!s->quit)
+    {
+        StreamLoad* load = popLoad(&s->queued);
+        if (!load)
+        {
+            pthread_cond_wait(&s->wake, &s->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&s->lock);
+        readLevels(load);
+        pthread_mutex_lock(&s->lock);
+        pushLoad(&s->finished, load);
+    }
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
+}
+
+// records the move of tex to a new image holding levels firstMip down. the
+// load's levels come from a staging buffer, the rest from the old image.
+// returns the old image and the staging buffer, which the caller retires.
+static RetiredImage
+replaceImage(WoadTextureStreamer* s, StreamedTexture* tex,
+             VkCommandBuffer cmd, uint32_t firstMip, const StreamLoad* load)
+{
+    const uint32_t mipCount = tex->mipCount - firstMip;
+    OnyxImage      image    = onyx_create_image(
+        s->memory, texture_LevelDim(tex->info.width, firstMip),
+        texture_LevelDim(tex->info.height, firstMip), tex->format,
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT, VK_SAMPLE_COUNT_1_BIT, mipCount,
+        ONYX_MEMORY_DEVICE_TYPE);
+    texture_Barrier(cmd, image.handle, 0, mipCount, VK_IMAGE_LAYOUT_UNDEFINED,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0,
+                    VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    RetiredImage old = {.image = tex->image};
+    if (load)
+    {
+        old.staging = onyx_request_buffer_region(
+            s->memory, load->size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            ONYX_MEMORY_HOST_TRANSFER_TYPE);
+        memcpy(old.staging.host_data, load->data, load->size);
+
+        VkBufferImageCopy regions[MAX_TEXTURE_LEVELS];
+        uint32_t          regionCount = 0;
+        for (uint32_t m = load->firstMip; m < load->lastMip; m++)
+            regions[regionCount++] = (VkBufferImageCopy){
+                .bufferOffset     = old.staging.offset + load->offsets[m],
+                .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, m - firstMip,
+                                     0, 1},
+                .imageExtent      = {texture_LevelDim(tex->info.width, m),
+                                     texture_LevelDim(tex->info.height, m),
+                                     1}};
+        vkCmdCopyBufferToImage(cmd, old.staging.buffer, image.handle,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               regionCount, regions);
+    }
+
+    // the levels both images have are copied across
+    const uint32_t keptMip =
+        tex->residentMip > firstMip ? tex->residentMip : firstMip;
+    if (keptMip < tex->mipCount)
+    {
+        const uint32_t keptCount = tex->mipCount - keptMip;
+        texture_Barrier(cmd, tex->image.handle, keptMip - tex->residentMip,
+                        keptCount, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                        VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                        TEXTURE_SAMPLE_STAGES,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        VkImageCopy regions[MAX_TEXTURE_LEVELS];
+        for (uint32_t i = 0; i < keptCount; i++)
+        {
+            const uint32_t m = keptMip + i;
+            regions[i]       = (VkImageCopy){
+                .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT,
+                                   m - tex->residentMip, 0, 1},
+                .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, m - firstMip, 0,
+                                   1},
+                .extent         = {texture_LevelDim(tex->info.width, m),
+                                   texture_LevelDim(tex->info.height, m), 1}};
+        }
+        vkCmdCopyImage(cmd, tex->image.handle,
+                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image.handle,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, keptCount,
+                       regions);
+    }
+
+    texture_Barrier(cmd, image.handle, 0, mipCount,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    TEXTURE_SAMPLE_STAGES);
+    image.layout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    tex->image       = image;
+    tex->residentMip = firstMip;
+    return old;
+}
+
+static void
+freeRetired(RetiredImage* retired)
+{
+    if (retired->image.handle != VK_NULL_HANDLE)
+        onyx_free_image(&retired->image);
+    if (retired->staging.buffer != VK_NULL_HANDLE)
+        onyx_free_buffer(&retired->staging);
+}
+
+static void
+collectRetired(WoadTextureStreamer* s, uint64_t now)
+{
+    int i = 0;
+    while (i < s->retired.count)
+    {
+        RetiredImage* retired = &s->retired.elems[i];
+        if (retired->retireAt > now)
+        {
+            i++;
+            continue;
+        }
+        freeRetired(retired);
+        *retired = s->retired.elems[s->retired.count - 1];
+        retired_image_arr_set_count(&s->retired, s->retired.count - 1);
+    }
+}
+
+// demand is one more than the log2 of the largest size the texture was
+// sampled at. finer levels than the tail's are all it can ask for.
+static uint32_t
+demandedMip(const StreamedTexture* tex, uint8_t demand)
+{
+    const uint32_t top  = tex->mipCount - 1;
+    const uint32_t size = demand - 1u;
+    const uint32_t mip  = size >= top ? 0 : top - size;
+    return mip < tex->tailMip ? mip : tex->tailMip;
+}
+
+// drops levels nobody wants, from the textures seen longest ago, until need
+// more bytes fit in the budget or there is nothing left to drop
+static bool
+makeRoom(WoadTextureStreamer* s, VkDeviceSize need, VkCommandBuffer cmd,
+         uint64_t retireAt)
+{
+    while (s->resident + s->reserved + need > s->budget)
+    {
+        StreamedTexture* victim = NULL;
+        for (int i = 0; i < s->textures.count; i++)
+        {
+            StreamedTexture* tex = s->textures.elems[i];
+            if (tex->loading || tex->wantedMip <= tex->residentMip)
+                continue;
+            if (!victim || tex->lastSeen < victim->lastSeen)
+                victim = tex;
+        }
+        if (!victim)
+            return false;
+
+        s->resident -= chainSize(victim, victim->residentMip) -
+                       chainSize(victim, victim->wantedMip);
+        RetiredImage old =
+            replaceImage(s, victim, cmd, victim->wantedMip, NULL);
+        old.retireAt = retireAt;
+        retired_image_arr_push(&s->retired, old);
+    }
+    return true;
+}
+
+// the texture furthest from the levels it wants, ties going to the one seen
+// last
+static StreamedTexture*
+nextLoad(WoadTextureStreamer* s)
+{
+    StreamedTexture* next    = NULL;
+    uint32_t         nextGap = 0;
+    for (int i = 0; i < s->textures.count; i++)
+    {
+        StreamedTexture* tex = s->textures.elems[i];
+        if (tex->loading || tex->wantedMip >= tex->residentMip)
+            continue;
+        const uint32_t gap = tex->residentMip - tex->wantedMip;
+        if (gap > nextGap ||
+            (gap == nextGap && tex->lastSeen > next->lastSeen))
+        {
+            next    = tex;
+            nextGap = gap;
+        }
+    }
+    return next;
+}
+
+bool
+streaming_Update(WoadTextureStreamer* s, const uint8_t* demand,
+                 bool complete, const OnyxTexture* textures,
+                 uint32_t textureCount,
+                 VkCommandBuffer cmd, uint64_t now, uint64_t retireAt)
+{
+    collectRetired(s, now);
+    s->updates++;
+    bool recorded = false;
+
+    for (int i = 0; i < s->textures.count; i++)
+    {
+        StreamedTexture* tex = s->textures.elems[i];
+        if (tex->slot >= textureCount ||
+            textures[tex->slot].dev_image != &tex->image)
+        {
+            tex->slot = UINT32_MAX;
+            for (uint32_t t = 0; t < textureCount; t++)
+                if (textures[t].dev_image == &tex->image)
+                {
+                    tex->slot = t;
+                    break;
+                }
+        }
+        if (tex->slot != UINT32_MAX && demand[tex->slot])
+        {
+            tex->wantedMip = demandedMip(tex, demand[tex->slot]);
+            tex->lastSeen  = s->updates;
+            tex->missed    = 0;
+        }
+        else if (complete && ++tex->missed > STREAM_IDLE_UPDATES)
+            tex->wantedMip = tex->tailMip;
+    }
+
+    pthread_mutex_lock(&s->lock);
+    LoadQueue finished = s->finished;
+    s->finished        = (LoadQueue){0};
+    pthread_mutex_unlock(&s->lock);
+
+    for (StreamLoad* load; (load = popLoad(&finished));)
+    {
+        StreamedTexture* tex = load->tex;
+        tex->loading         = false;
+        s->reserved -= load->cost;
+        s->loadCount--;
+        if (load->data)
+        {
+            RetiredImage old = replaceImage(s, tex, cmd, load->firstMip, load);
+            old.retireAt     = retireAt;
+            retired_image_arr_push(&s->retired, old);
+            s->resident += load->cost;
+            recorded = true;
+        }
+        else
+            hell_print("Woad: failed to stream %s\n", tex->path);
+        free(load->data);
+        free(load);
+    }
+
+    // loads of textures that want finer levels, as many as fit once unwanted
+    // levels are dropped. a load jumps straight to the wanted level.
+    for (StreamedTexture* tex;
+         s->loadCount < MAX_STREAM_LOADS && (tex = nextLoad(s));)
+    {
+        uint32_t     firstMip = tex->wantedMip;
+        VkDeviceSize cost =
+            chainSize(tex, firstMip) - chainSize(tex, tex->residentMip);
+        const int retiredCount = s->retired.count;
+        makeRoom(s, cost, cmd, retireAt);
+        recorded |= s->retired.count != retiredCount;
+        while (firstMip < tex->residentMip &&
+               s->resident + s->reserved + cost > s->budget)
+        {
+            firstMip++;
+            cost = chainSize(tex, firstMip) - chainSize(tex, tex->residentMip);
+        }
+        if (firstMip == tex->residentMip)
+            break;
+
+        StreamLoad* load = calloc(1, sizeof(StreamLoad));
+        assert(load);
+        load->tex      = tex;
+        load->firstMip = firstMip;
+        load->lastMip  = tex->residentMip;
+        load->cost     = cost;
+        tex->loading   = true;
+        s->reserved += cost;
+        s->loadCount++;
+
+        pthread_mutex_lock(&s->lock);
+        pushLoad(&s->queued, load);
+        pthread_cond_signal(&s->wake);
+        pthread_mutex_unlock(&s->lock);
+    }
+    return recorded;
+}
+
+WoadTextureStreamer*
+woad_CreateTextureStreamer(const OnyxInstance* instance, OnyxMemory* memory,
+                           VkDeviceSize budget)
+{
+    WoadTextureStreamer* s = calloc(1, sizeof(WoadTextureStreamer));
+    assert(s);
+    s->instance = instance;
+    s->memory   = memory;
+    s->budget   = budget;
+    s->textures = streamed_texture_ptr_arr_create(NULL);
+    s->retired  = retired_image_arr_create(NULL);
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->wake, NULL);
+    const int err = pthread_create(&s->worker, NULL, streamWorker, s);
+    assert(!err);
+    return s;
+}
+
+OnyxImage*
+woad_StreamTexture(WoadTextureStreamer* s, VkCommandBuffer cmd,
+                   const char* path, WoadTextureRole role,
+                   OnyxBuffer* staging)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return NULL;
+    uint8_t head[KTX2_HEAD_SIZE];
+    fseek(file, 0, SEEK_END);
+    const long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    const size_t headSize = fread(head, 1, sizeof(head), file);
+    fclose(file);
+
+    Ktx2Info info;
+    if (fileSize <= 0 ||
+        texture_ParseKtx2(head, headSize, fileSize, &info) != 0)
+        return NULL;
+    const VkFormat format = texture_SampledFormat(role, info.format);
+    if (format == VK_FORMAT_UNDEFINED ||
+        info.levelCount < texture_MipCount(info.width, info.height) ||
+        !texture_CanSample(s->instance, format))
+    {
+        hell_print("Woad: %s can't be streamed\n", path);
+        return NULL;
+    }
+
+    StreamedTexture* tex = calloc(1, sizeof(StreamedTexture));
+    assert(tex);
+    tex->path = strdup(path);
+    assert(tex->path);
+    tex->info        = info;
+    tex->format      = format;
+    tex->mipCount    = info.levelCount;
+    tex->residentMip = tex->mipCount;
+    tex->slot        = UINT32_MAX;
+    tex->lastSeen    = s->updates;
+    while (tex->tailMip < tex->mipCount - 1 &&
+           (texture_LevelDim(info.width, tex->tailMip) > STREAM_TAIL_SIZE ||
+            texture_LevelDim(info.height, tex->tailMip) > STREAM_TAIL_SIZE))
+        tex->tailMip++;
+    tex->wantedMip = tex->tailMip;
+
+    StreamLoad load = {.tex      = tex,
+                       .firstMip = tex->tailMip,
+                       .lastMip  = tex->mipCount};
+    readLevels(&load);
+    if (!load.data)
+    {
+        free(tex->path);
+        free(tex);
+        return NULL;
+    }
+    *staging = replaceImage(s, tex, cmd, tex->tailMip, &load).staging;
+    free(load.data);
+    s->resident += chainSize(tex, tex->tailMip);
+    streamed_texture_ptr_arr_push(&s->textures, tex);
+    return &tex->image;
+}
+
+void
+woad_DestroyTextureStreamer(WoadTextureStreamer* s)
+{
+    pthread_mutex_lock(&s->lock);
+    s->quit = true;
+    pthread_cond_broadcast(&s->wake);
+    pthread_mutex_unlock(&s->lock);
+    pthread_join(s->worker, NULL);
+
+    freeLoads(&s->queued);
+    freeLoads(&s->finished);
+    for (int i = 0; i < s->retired.count; i++)
+        freeRetired(&s->retired.elems[i]);
+    retired_image_arr_free(&s->retired);
+    for (int i = 0; i < s->textures.count; i++)
+    {
+        StreamedTexture* tex = s->textures.elems[i];
+        onyx_free_image(&tex->image);
+        free(tex->path);
+        free(tex);
+    }
+    streamed_texture_ptr_arr_free(&s->textures);
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->wake);
+    free(s);
+}
@@ -0,0 +1,23 @@
+#ifndef WOAD_STREAMING_H
+#define WOAD_STREAMING_H
+
+// the texture streamer's side of woad_StreamTextures
+
+#include "woad.h"
+
+#include <stdint.h>
+
+// demand has an entry per texture, one more than the log2 of the largest
+// size the gbuffer pass sampled it at, 0 where it wasn't sampled. it is
+// complete when it covers a frame redrawn in full, so that textures missing
+// from it weren't seen; otherwise they may just not have been redrawn. levels
+// are loaded and dropped against the budget, and the copies recorded into
+// cmd. images replaced by the call are freed once now reaches retireAt.
+// true when anything was recorded.
+bool
+streaming_Update(WoadTextureStreamer* s, const uint8_t* demand,
+                 bool complete, const OnyxTexture* textures,
+                 uint32_t textureCount,
+                 VkCommandBuffer cmd, uint64_t now, uint64_t retireAt);
+
+#endif
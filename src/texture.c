@@ -0,0 +1,611 @@
+#define COAL_SIMPLE_TYPE_NAMES
+#define ONYX_SIMPLE_TYPE_NAMES
+#include "woad.h"
+#include "texture.h"
+
+#include <assert.h>
+#include <hell/hell.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// levels are copied from the staging buffer at offsets aligned to this,
+// which covers every texel block size we load
+#define STAGING_ALIGNMENT 16
+
+static const uint8_t ktx2Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2',
+                                           '0',  0xBB, '\r', '\n', 0x1A, '\n'};
+
+// the fixed part of a ktx2 header, followed by one Ktx2Level per level
+typedef struct {
+    uint8_t  identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+} Ktx2Header;
+
+_Static_assert(KTX2_HEAD_SIZE == sizeof(Ktx2Header) +
+                                     MAX_TEXTURE_LEVELS * sizeof(Ktx2Level),
+               "KTX2_HEAD_SIZE is out of date");
+
+typedef struct {
+    const uint8_t* data;
+    VkDeviceSize   size;
+} Level;
+
+typedef enum {
+    BLOCK_NONE,
+    BLOCK_BC1,
+    BLOCK_BC4,
+    BLOCK_BC5,
+    BLOCK_BC7,
+} BlockKind;
+
+static BlockKind
+blockKind(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:  return BLOCK_BC1;
+    case VK_FORMAT_BC4_UNORM_BLOCK:      return BLOCK_BC4;
+    case VK_FORMAT_BC5_UNORM_BLOCK:      return BLOCK_BC5;
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:       return BLOCK_BC7;
+    default:                             return BLOCK_NONE;
+    }
+}
+
+static uint32_t
+blockBytes(BlockKind kind)
+{
+    return kind == BLOCK_BC1 || kind == BLOCK_BC4 ? 8 : 16;
+}
+
+// channels of an uncompressed 8 bit format, 0 if it isn't one we load
+static uint32_t
+texelChannels(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_R8_UNORM:       return 1;
+    case VK_FORMAT_R8G8_UNORM:     return 2;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:  return 4;
+    default:                       return 0;
+    }
+}
+
+// what an uncompressed texture of each role is stored as. albedo is srgb
+// color with alpha, roughness is read from red, and normals only keep x and
+// y; the shaders rebuild z.
+static VkFormat
+uncompressedFormat(WoadTextureRole role)
+{
+    switch (role)
+    {
+    case WOAD_TEXTURE_ROUGHNESS: return VK_FORMAT_R8_UNORM;
+    case WOAD_TEXTURE_NORMAL:    return VK_FORMAT_R8G8_UNORM;
+    default:                     return VK_FORMAT_R8G8B8A8_SRGB;
+    }
+}
+
+// the block format a role is stored in, given the one the file has. color
+// is always sampled as srgb, whatever the file says.
+static VkFormat
+roleBlockFormat(WoadTextureRole role, VkFormat format)
+{
+    const BlockKind kind = blockKind(format);
+    switch (role)
+    {
+    case WOAD_TEXTURE_ALBEDO:
+        if (kind == BLOCK_BC1)
+            return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+        if (kind == BLOCK_BC7)
+            return VK_FORMAT_BC7_SRGB_BLOCK;
+        return VK_FORMAT_UNDEFINED;
+    case WOAD_TEXTURE_ROUGHNESS:
+        return kind == BLOCK_BC4 ? format : VK_FORMAT_UNDEFINED;
+    case WOAD_TEXTURE_NORMAL:
+        return kind == BLOCK_BC5 ? format : VK_FORMAT_UNDEFINED;
+    default:
+        return VK_FORMAT_UNDEFINED;
+    }
+}
+
+uint32_t
+texture_LevelDim(uint32_t dim, uint32_t level)
+{
+    dim >>= level;
+    return dim ? dim : 1;
+}
+
+uint32_t
+texture_MipCount(uint32_t width, uint32_t height)
+{
+    uint32_t count = 1;
+    while ((width | height) >> count)
+        count++;
+    return count;
+}
+
+VkDeviceSize
+texture_LevelSize(VkFormat format, uint32_t width, uint32_t height)
+{
+    const BlockKind kind = blockKind(format);
+    if (kind != BLOCK_NONE)
+        return (VkDeviceSize)((width + 3) / 4) * ((height + 3) / 4) *
+               blockBytes(kind);
+    return (VkDeviceSize)width * height * texelChannels(format);
+}
+
+bool
+texture_CanSample(const OnyxInstance* instance, VkFormat format)
+{
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(instance->physical_device, format,
+                                        &props);
+    return props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+}
+
+// block decoding, for devices without bc support
+
+static void
+unpack565(uint16_t c, uint8_t rgb[3])
+{
+    const uint32_t r = c >> 11, g = (c >> 5) & 0x3f, b = c & 0x1f;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+static void
+decodeBc1(const uint8_t* block, uint8_t out[16][4])
+{
+    const uint16_t c0 = block[0] | block[1] << 8;
+    const uint16_t c1 = block[2] | block[3] << 8;
+    uint8_t        palette[4][4];
+    unpack565(c0, palette[0]);
+    unpack565(c1, palette[1]);
+    palette[0][3] = palette[1][3] = 255;
+    for (int c = 0; c < 3; c++)
+    {
+        const uint32_t a = palette[0][c], b = palette[1][c];
+        if (c0 > c1)
+        {
+            palette[2][c] = (2 * a + b) / 3;
+            palette[3][c] = (a + 2 * b) / 3;
+        }
+        else
+        {
+            palette[2][c] = (a + b) / 2;
+            palette[3][c] = 0;
+        }
+    }
+    palette[2][3] = 255;
+    palette[3][3] = c0 > c1 ? 255 : 0;
+
+    const uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 |
+                             (uint32_t)block[7] << 24;
+    for (int i = 0; i < 16; i++)
+        memcpy(out[i], palette[(indices >> (2 * i)) & 3], 4);
+}
+
+static void
+decodeBc4(const uint8_t* block, uint8_t out[16])
+{
+    const uint32_t r0 = block[0], r1 = block[1];
+    uint8_t        palette[8] = {r0, r1};
+    if (r0 > r1)
+    {
+        for (int i = 1; i < 7; i++)
+            palette[i + 1] = ((7 - i) * r0 + i * r1) / 7;
+    }
+    else
+    {
+        for (int i = 1; i < 5; i++)
+            palette[i + 1] = ((5 - i) * r0 + i * r1) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; i++)
+        indices |= (uint64_t)block[2 + i] << (8 * i);
+    for (int i = 0; i < 16; i++)
+        out[i] = palette[(indices >> (3 * i)) & 7];
+}
+
+// one level of bc1, bc4 or bc5 blocks as the role's uncompressed format.
+// NULL for bc7, which we don't decode.
+static uint8_t*
+decodeLevel(BlockKind kind, const uint8_t* blocks, uint32_t width,
+            uint32_t height, uint32_t channels)
+{
+    if (kind == BLOCK_BC7)
+        return NULL;
+    uint8_t* texels = malloc((size_t)width * height * channels);
+    assert(texels);
+
+    const uint32_t blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+    for (uint32_t by = 0; by < blocksHigh; by++)
+        for (uint32_t bx = 0; bx < blocksWide; bx++)
+        {
+            const uint8_t* block =
+                blocks + (by * blocksWide + bx) * blockBytes(kind);
+            uint8_t rgba[16][4] = {0};
+            if (kind == BLOCK_BC1)
+                decodeBc1(block, rgba);
+            else
+            {
+                uint8_t channel[16];
+                decodeBc4(block, channel);
+                for (int i = 0; i < 16; i++)
+                    rgba[i][0] = channel[i];
+                if (kind == BLOCK_BC5)
+                {
+                    decodeBc4(block + 8, channel);
+                    for (int i = 0; i < 16; i++)
+                        rgba[i][1] = channel[i];
+                }
+            }
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                const uint32_t x = bx * 4 + i % 4, y = by * 4 + i / 4;
+                if (x < width && y < height)
+                    memcpy(texels + ((size_t)y * width + x) * channels,
+                           rgba[i], channels);
+            }
+        }
+    return texels;
+}
+
+void
+texture_Barrier(VkCommandBuffer cmd, VkImage image, uint32_t level,
+                uint32_t count, VkImageLayout oldLayout,
+                VkImageLayout newLayout, VkAccessFlags srcAccess,
+                VkAccessFlags dstAccess, VkPipelineStageFlags srcStage,
+                VkPipelineStageFlags dstStage)
+{
+    const VkImageMemoryBarrier b = {
+        .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask       = srcAccess,
+        .dstAccessMask       = dstAccess,
+        .oldLayout           = oldLayout,
+        .newLayout           = newLayout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image               = image,
+        .subresourceRange    = {VK_IMAGE_ASPECT_COLOR_BIT, level, count, 0, 1}};
+
+    vkCmdPipelineBarrier(cmd, srcStage, dstStage, 0, 0, NULL, 0, NULL, 1, &b);
+}
+
+// makes a mipCount level image and records the copy of the given levels
+// into it. levels past levelCount are blitted down from the last one given,
+// so the format must be uncompressed if there are any.
+static int
+upload(OnyxMemory* memory, VkCommandBuffer cmd, VkFormat format,
+       uint32_t width, uint32_t height, uint32_t levelCount,
+       uint32_t mipCount, const Level* levels, OnyxImage* image,
+       OnyxBuffer* staging)
+{
+    VkDeviceSize offsets[MAX_TEXTURE_LEVELS];
+    VkDeviceSize size = 0;
+    for (uint32_t i = 0; i < levelCount; i++)
+    {
+        offsets[i] = size;
+        size = (size + levels[i].size + STAGING_ALIGNMENT - 1) &
+               ~(VkDeviceSize)(STAGING_ALIGNMENT - 1);
+    }
+
+    *staging = onyx_request_buffer_region(memory, size,
+                                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                          ONYX_MEMORY_HOST_TRANSFER_TYPE);
+    for (uint32_t i = 0; i < levelCount; i++)
+        memcpy(staging->host_data + offsets[i], levels[i].data,
+               levels[i].size);
+
+    VkImageUsageFlags usage =
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    if (mipCount > levelCount)
+        usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    *image = onyx_create_image(memory, width, height, format, usage,
+                               VK_IMAGE_ASPECT_COLOR_BIT,
+                               VK_SAMPLE_COUNT_1_BIT, mipCount,
+                               ONYX_MEMORY_DEVICE_TYPE);
+
+    texture_Barrier(cmd, image->handle, 0, mipCount, VK_IMAGE_LAYOUT_UNDEFINED,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0,
+                    VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    VkBufferImageCopy regions[MAX_TEXTURE_LEVELS];
+    for (uint32_t i = 0; i < levelCount; i++)
+        regions[i] = (VkBufferImageCopy){
+            .bufferOffset     = staging->offset + offsets[i],
+            .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1},
+            .imageExtent      = {texture_LevelDim(width, i),
+                                 texture_LevelDim(height, i), 1}};
+    vkCmdCopyBufferToImage(cmd, staging->buffer, image->handle,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount,
+                           regions);
+
+    // each generated level is a linear blit of the one above it, which is
+    // moved to transfer src once it has been written
+    for (uint32_t i = levelCount; i < mipCount; i++)
+    {
+        texture_Barrier(cmd, image->handle, i - 1, 1,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                        VK_ACCESS_TRANSFER_WRITE_BIT,
+                        VK_ACCESS_TRANSFER_READ_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        const VkImageBlit blit = {
+            .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i - 1, 0, 1},
+            .srcOffsets     = {{0, 0, 0},
+                               {texture_LevelDim(width, i - 1),
+                                texture_LevelDim(height, i - 1), 1}},
+            .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1},
+            .dstOffsets     = {{0, 0, 0},
+                               {texture_LevelDim(width, i),
+                                texture_LevelDim(height, i), 1}}};
+        vkCmdBlitImage(cmd, image->handle,
+                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image->handle,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
+                       VK_FILTER_LINEAR);
+    }
+
+    // the generated levels were left in transfer src, bar the last
+    const uint32_t srcLevels = mipCount > levelCount ? mipCount - 1 : 0;
+    if (srcLevels)
+        texture_Barrier(cmd, image->handle, 0, srcLevels,
+                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                        VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        TEXTURE_SAMPLE_STAGES);
+    texture_Barrier(cmd, image->handle, srcLevels, mipCount - srcLevels,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    TEXTURE_SAMPLE_STAGES);
+    image->layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    return 0;
+}
+
+int
+woad_CreateTexture(OnyxMemory* memory, VkCommandBuffer cmd,
+                   const uint8_t* rgba, uint32_t width, uint32_t height,
+                   WoadTextureRole role, OnyxImage* image,
+                   OnyxBuffer* staging)
+{
+    if (!width || !height ||
+        texture_MipCount(width, height) > MAX_TEXTURE_LEVELS)
+        return -1;
+
+    // keep just the channels the role's format has
+    const VkFormat format   = uncompressedFormat(role);
+    const uint32_t channels = texelChannels(format);
+    const size_t   count    = (size_t)width * height;
+    uint8_t*       texels   = malloc(count * channels);
+    assert(texels);
+    for (size_t i = 0; i < count; i++)
+        memcpy(texels + i * channels, rgba + i * 4, channels);
+
+    const Level level = {texels, count * channels};
+    const int   err   = upload(memory, cmd, format, width, height, 1,
+                               texture_MipCount(width, height), &level, image,
+                               staging);
+    free(texels);
+    return err;
+}
+
+static int
+readFile(const char* path, uint8_t** data, size_t* size)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return -1;
+    fseek(file, 0, SEEK_END);
+    const long end = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (end <= 0)
+    {
+        fclose(file);
+        return -1;
+    }
+    *size = end;
+    *data = malloc(*size);
+    assert(*data);
+    const size_t read = fread(*data, 1, *size, file);
+    fclose(file);
+    if (read != *size)
+    {
+        free(*data);
+        return -1;
+    }
+    return 0;
+}
+
+// an uncompressed file is widened to rgba and goes through
+// woad_CreateTexture, so only its first level is used
+static int
+loadUncompressed(OnyxMemory* memory, VkCommandBuffer cmd,
+                 const Ktx2Info* info, const Level* level,
+                 WoadTextureRole role, OnyxImage* image, OnyxBuffer* staging)
+{
+    const uint32_t channels = texelChannels(info->format);
+    const size_t   count    = (size_t)info->width * info->height;
+    uint8_t*       rgba  = malloc(count * 4);
+    assert(rgba);
+    for (size_t i = 0; i < count; i++)
+    {
+        uint8_t* texel = rgba + i * 4;
+        memset(texel, 0, 3);
+        texel[3] = 255;
+        memcpy(texel, level->data + i * channels, channels);
+    }
+    const int err =
+        woad_CreateTexture(memory, cmd, rgba, info->width, info->height, role,
+                           image, staging);
+    free(rgba);
+    return err;
+}
+
+// bc levels are uploaded as they are, or decoded to the role's uncompressed
+// format when the device can't sample them
+static int
+loadBlocks(const OnyxInstance* instance, OnyxMemory* memory,
+           VkCommandBuffer cmd, const Ktx2Info* info, const Level* levels,
+           VkFormat format, WoadTextureRole role, OnyxImage* image,
+           OnyxBuffer* staging)
+{
+    const uint32_t width = info->width, height = info->height;
+    const uint32_t levelCount = info->levelCount;
+    if (texture_CanSample(instance, format))
+        return upload(memory, cmd, format, width, height, levelCount,
+                      levelCount, levels, image, staging);
+
+    const VkFormat fallback = uncompressedFormat(role);
+    const uint32_t channels = texelChannels(fallback);
+    const BlockKind kind    = blockKind(format);
+    Level          decoded[MAX_TEXTURE_LEVELS];
+    uint32_t       decodedCount = 0;
+    for (; decodedCount < levelCount; decodedCount++)
+    {
+        const uint32_t w = texture_LevelDim(width, decodedCount);
+        const uint32_t h = texture_LevelDim(height, decodedCount);
+        decoded[decodedCount].data =
+            decodeLevel(kind, levels[decodedCount].data, w, h, channels);
+        decoded[decodedCount].size = (VkDeviceSize)w * h * channels;
+        if (!decoded[decodedCount].data)
+            break;
+    }
+
+    int err = -1;
+    if (decodedCount == levelCount)
+        err = upload(memory, cmd, fallback, width, height, levelCount,
+                     levelCount, decoded, image, staging);
+    else
+        hell_print("Woad: this device can't sample bc7 textures\n");
+    for (uint32_t i = 0; i < decodedCount; i++)
+        free((void*)decoded[i].data);
+    return err;
+}
+
+int
+texture_ParseKtx2(const uint8_t* head, size_t headSize, uint64_t fileSize,
+                  Ktx2Info* info)
+{
+    const Ktx2Header* header = (const Ktx2Header*)head;
+    if (headSize < sizeof(Ktx2Header) ||
+        memcmp(header->identifier, ktx2Identifier, sizeof(ktx2Identifier)) ||
+        header->supercompressionScheme != 0 || header->pixelDepth > 1 ||
+        header->layerCount > 1 || header->faceCount != 1 ||
+        !header->pixelWidth || !header->pixelHeight ||
+        texture_MipCount(header->pixelWidth, header->pixelHeight) >
+            MAX_TEXTURE_LEVELS)
+        return -1;
+
+    // a level count of 0 asks for the mips to be made at load
+    info->format     = header->vkFormat;
+    info->width      = header->pixelWidth;
+    info->height     = header->pixelHeight;
+    info->levelCount = header->levelCount ? header->levelCount : 1;
+    if (info->levelCount > texture_MipCount(info->width, info->height) ||
+        headSize < sizeof(Ktx2Header) + info->levelCount * sizeof(Ktx2Level))
+        return -1;
+    if (!blockKind(info->format) && !texelChannels(info->format))
+        return -1;
+
+    const Ktx2Level* index = (const Ktx2Level*)(head + sizeof(Ktx2Header));
+    for (uint32_t i = 0; i < info->levelCount; i++)
+    {
+        const VkDeviceSize size =
+            texture_LevelSize(info->format, texture_LevelDim(info->width, i),
+                              texture_LevelDim(info->height, i));
+        if (index[i].byteOffset > fileSize || index[i].byteLength < size ||
+            fileSize - index[i].byteOffset < size)
+            return -1;
+        info->offsets[i] = index[i].byteOffset;
+    }
+    return 0;
+}
+
+VkFormat
+texture_SampledFormat(WoadTextureRole role, VkFormat format)
+{
+    if (blockKind(format))
+        return roleBlockFormat(role, format);
+    const VkFormat uncompressed = uncompressedFormat(role);
+    return texelChannels(format) == texelChannels(uncompressed)
+               ? uncompressed
+               : VK_FORMAT_UNDEFINED;
+}
+
+int
+woad_LoadTexture(const OnyxInstance* instance, OnyxMemory* memory,
+                 VkCommandBuffer cmd, const char* path, WoadTextureRole role,
+                 OnyxImage* image, OnyxBuffer* staging)
+{
+    uint8_t* file;
+    size_t   fileSize;
+    if (readFile(path, &file, &fileSize) != 0)
+        return -1;
+
+    int      err = -1;
+    Ktx2Info info;
+    if (texture_ParseKtx2(file, fileSize, fileSize, &info) != 0)
+        goto end;
+
+    Level levels[MAX_TEXTURE_LEVELS];
+    for (uint32_t i = 0; i < info.levelCount; i++)
+    {
+        levels[i].data = file + info.offsets[i];
+        levels[i].size = texture_LevelSize(info.format,
+                                           texture_LevelDim(info.width, i),
+                                           texture_LevelDim(info.height, i));
+    }
+
+    if (texelChannels(info.format))
+    {
+        err = loadUncompressed(memory, cmd, &info, &levels[0], role, image,
+                               staging);
+        goto end;
+    }
+
+    const VkFormat format = roleBlockFormat(role, info.format);
+    if (format == VK_FORMAT_UNDEFINED)
+    {
+        hell_print("Woad: %s has no format for its role\n", path);
+        goto end;
+    }
+    if (info.levelCount < texture_MipCount(info.width, info.height))
+        hell_print("Woad: %s is missing mips\n", path);
+    err = loadBlocks(instance, memory, cmd, &info, levels, format, role,
+                     image, staging);
+
+end:
+    free(file);
+    return err;
+}
@@ -0,0 +1,70 @@
+#ifndef WOAD_TEXTURE_H
+#define WOAD_TEXTURE_H
+
+// the ktx2 reading and upload helpers behind woad_LoadTexture, shared with
+// the texture streamer
+
+#include "woad.h"
+
+#include <stdint.h>
+
+#define MAX_TEXTURE_LEVELS 16
+
+// enough of the start of a ktx2 file to hold its header and level index
+#define KTX2_HEAD_SIZE (80 + MAX_TEXTURE_LEVELS * 24)
+
+// where textures are sampled: the gbuffer fragment shaders, and the
+// visibility resolve
+#define TEXTURE_SAMPLE_STAGES                                                  \
+    (VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |                                   \
+     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+
+typedef struct {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+} Ktx2Level;
+
+typedef struct {
+    VkFormat format;
+    uint32_t width;
+    uint32_t height;
+    // at least 1. files may hold less than the full chain.
+    uint32_t levelCount;
+    // where each level starts in the file, the full size one first
+    uint64_t offsets[MAX_TEXTURE_LEVELS];
+} Ktx2Info;
+
+// head is the start of a ktx2 file of fileSize bytes, enough of it to hold
+// the header and level index. fails for anything we can't load, and for
+// levels that don't fit in the file.
+int
+texture_ParseKtx2(const uint8_t* head, size_t headSize, uint64_t fileSize,
+                  Ktx2Info* info);
+
+// the format a file's texels can be sampled as for role without
+// conversion, or VK_FORMAT_UNDEFINED
+VkFormat
+texture_SampledFormat(WoadTextureRole role, VkFormat format);
+
+bool
+texture_CanSample(const OnyxInstance* instance, VkFormat format);
+
+uint32_t
+texture_LevelDim(uint32_t dim, uint32_t level);
+
+// levels in a full chain down to 1x1
+uint32_t
+texture_MipCount(uint32_t width, uint32_t height);
+
+VkDeviceSize
+texture_LevelSize(VkFormat format, uint32_t width, uint32_t height);
+
+void
+texture_Barrier(VkCommandBuffer cmd, VkImage image, uint32_t level,
+                uint32_t count, VkImageLayout oldLayout,
+                VkImageLayout newLayout, VkAccessFlags srcAccess,
+                VkAccessFlags dstAccess, VkPipelineStageFlags srcStage,
+                VkPipelineStageFlags dstStage);
+
+#endif
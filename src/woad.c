@@ -1,16 +1,23 @@
 #define COAL_SIMPLE_TYPE_NAMES
 #define ONYX_SIMPLE_TYPE_NAMES
 #include "woad.h"
+#include "cache.h"
+#include "geometry.h"
+#include "graph.h"
+#include "streaming.h"
 
 #include <assert.h>
 #include <coal/coal.h>
 #include <hell/hell.h>
 #include <hell/len.h>
 #include <hell/io.h>
+#include <math.h>
 #include <memory.h>
 #include <onyx/attribute.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 typedef OnyxCommand               Command;
@@ -24,8 +31,13 @@ typedef OnyxPrimitive             Prim;
 #define WOAD_SPV_PREFIX "build/shaders/woad_shaders"
 #define ONYX_SPV_PREFIX "build/pome/src/onyx/shaders/onyx_shaders"
 
-// quick hack
-#define ONYX_S_MAX_MATERIALS 10
+// materials and draw instances live in storage buffers that grow to fit
+// the scene, starting from this many entries
+#define MIN_MATERIAL_CAPACITY 64
+#define MIN_INSTANCE_CAPACITY 256
+// size of the partially bound texture array. only the slots the scene uses
+// are ever written.
+#define MAX_TEXTURE_COUNT 4096
 
 typedef OnyxMask AttrMask;
 
@@ -51,6 +63,8 @@ enum {
     PIPELINE_GBUFFER_POS_NOR_UV,
     PIPELINE_GBUFFER_POS_NOR_UV_TAN,
     PIPELINE_GBUFFER_POS,
+    PIPELINE_GBUFFER_PACKED_NOR_UV,
+    PIPELINE_GBUFFER_PACKED_NOR_UV_TAN,
     GBUFFER_PIPELINE_COUNT
 };
 
@@ -58,74 +72,522 @@ _Static_assert(GBUFFER_PIPELINE_COUNT < ONYX_MAX_PIPELINES,
                "GRAPHICS_PIPELINE_COUNT must be less than ONYX_MAX_PIPELINES");
 
 #define MAX_PRIM_COUNT ONYX_S_MAX_PRIMS
+#define MAX_GEO_ATTRIBUTES 8
 #define MAX_LIGHT_COUNT 16
+// the most lights the deferred shaders are specialized to, and the type
+// they tell apart. must match MAX_LIGHTS and DIR_LIGHT in lights.glsl.
+#define MAX_SPECIALIZED_LIGHTS 8
+#define DIR_LIGHT_TYPE 1
 
 // TODO: This is what we need to initialize....
 typedef struct {
     Light elems[MAX_LIGHT_COUNT];
 } Lights;
 
-// we may be able to use this space to update certain prim transforms
-// faster than running through the whole list of them
-// especially when dealing with many hundreds of prims.
-// currently though this is not used.
+// what the gbuffer vertex shaders know about a prim. each draw passes its
+// slot in the instance table as its first instance, so recorded draws don't
+// change when prims move or change material. must match geometry.glsl.
 typedef struct {
-    Mat4 xform[16];
-} Xforms;
-
+    Mat4     xform;
+    uint32_t materialId;
+    uint32_t primId;
+    // packed geometry only: the geometry block its vertices are pulled from
+    // and where its two streams start there, in 4 byte words
+    uint32_t vertexBlock;
+    uint32_t positionOffset;
+    uint32_t attributeOffset;
+    // also packed only, for the visibility resolve: where the indices of
+    // the level being drawn start in the block, and the words per vertex
+    // of the attribute stream
+    uint32_t indexOffset;
+    uint32_t attributeStride;
+    uint32_t pad;
+} DrawInstance;
+
+// one per view, indexed by gl_ViewIndex in the shaders
 typedef struct {
     Mat4 view;
     Mat4 proj;
     Mat4 camera;
 } Camera;
 
-#define MAX_FRAMES_IN_FLIGHT 2
+// upper bound. the number of frames in flight is picked at init.
+#define MAX_FRAMES_IN_FLIGHT 4
+#define MIN_FRAMES_IN_FLIGHT 2
+#define MAX_SWAPCHAIN_IMAGES 8
+// views rendered by one pass with multiview. 2 for stereo, 6 for a cube.
+// must match MAX_VIEWS in camera.glsl
+#define MAX_VIEWS 6
+// the pixels a workgroup of the compute shading pass, or of the forward
+// mode's light culling, covers along each side. must match TILE_SIZE in
+// deferred.comp, forward.glsl and lightcull.comp
+#define TILE_SIZE 16
+// the pixels a workgroup of the visibility resolve covers along each side.
+// must match GROUP_SIZE in resolve.comp
+#define RESOLVE_GROUP_SIZE 8
+
+// A draw in one of the gbuffer pipeline buckets. The pipeline is implied by
+// the bucket, so the key only orders draws within it:
+//
+//   [63:44] geometry  [43:24] material  [23:0] view depth
+//
+// Draws sharing geometry end up adjacent so their vertex and index buffers
+// are bound once, and within a geometry/material run they go front to back
+// to help early-z.
+typedef struct {
+    uint64_t            key;
+    OnyxPrimitiveHandle prim;
+    uint32_t            instance;
+} Draw;
+
+#define DRAW_KEY_GEO_SHIFT   44
+#define DRAW_KEY_MAT_SHIFT   24
+#define DRAW_KEY_FIELD_MASK  0xfffff
+#define DRAW_KEY_DEPTH_MASK  0xffffff
 
 define_array_type(AccelerationStructure, accel_struct);
+define_array_type(Draw, draw);
+typedef OnyxPrimitiveHandle PrimHandle;
+
+define_array_type(PrimHandle, prim_handle);
+
+// the gbuffer draws of one frame slot, recorded once into a secondary
+// command buffer and replayed until the draw list changes. dynamic state
+// isn't inherited, so the viewport and scissor are part of the recording.
+typedef struct {
+    VkCommandBuffer cmdbuf;
+    VkRect2D        viewport;
+    VkRect2D        scissor;
+    bool            valid;
+} GbufferCache;
+
+// what a blas was built from. the address alone would hand the old blas to
+// geometry freed and made again there, so packed geometry is told apart by
+// its id and the rest by its regions.
+typedef struct {
+    const OnyxGeometry* geo;
+    uint64_t            id;
+    VkBuffer            vertexBuffer;
+    VkDeviceSize        vertexOffset;
+    VkBuffer            indexBuffer;
+    VkDeviceSize        indexOffset;
+} BlasKey;
+
+// Per mesh bottom level acceleration structures, shared by every renderer
+// whose scene references the geometry. Refcounted by the number of visible
+// prims across all renderers that use it.
+typedef struct {
+    BlasKey               key;
+    AccelerationStructure blas;
+    uint32_t              refs;
+    // built from the first coarser level, for WOAD_SETTINGS_COARSE_SHADOWS_BIT
+    bool                  coarse;
+} BlasEntry;
+
+define_array_type(BlasEntry, blas_entry);
+define_array_type(BlasKey, blas_key);
+
+// Camera, lights and materials live in device local memory. We keep a host
+// mirror of each with a per element count of frames that still need the
+// element, and copy only those ranges in through a staging buffer at the
+// start of the frame.
+typedef struct {
+    uint8_t* elems;
+    uint8_t* dirty; // frames that still need each element
+    uint32_t elem_size;
+    uint32_t count;
+    uint32_t capacity;
+} UploadMirror;
+
+// one staging buffer per frame in flight, used round robin. a frame's
+// buffer is only reused once that frame has completed.
+typedef struct {
+    BufferRegion buffer;
+    VkDeviceSize head;
+} StagingBuffer;
+
+#define MIN_STAGING_SIZE 0x10000
+#define MAX_COPY_REGIONS 64
+
+// what each frame's texture array currently points at, so we only write the
+// slots that changed
+typedef struct {
+    VkImageView view;
+    VkSampler   sampler;
+} TextureSlot;
+
+// an image with one layer per view. onyx_create_image only makes single
+// layer images, so these own their memory.
+typedef struct {
+    VkImage            handle;
+    VkImageView        view;
+    VkDeviceMemory     memory;
+    uint32_t           width;
+    uint32_t           height;
+    VkFormat           format;
+    VkImageUsageFlags  usage;
+    VkImageAspectFlags aspect;
+} LayeredImage;
+
+// attachments are made in steps of this many pixels in each dimension, so
+// resizing within a step keeps them. framebuffers match the attachments and
+// rendering is limited to the frame by the render area and viewport.
+#define ATTACHMENT_SIZE_STEP 256
+// attachments no longer in use are kept around for a later resize back to
+// their size, up to this many
+#define MAX_POOLED_IMAGES 24
+
+// an image or framebuffer that frames in flight may still use. once every
+// render up to retireAt has completed, images go back to the pool and
+// framebuffers are destroyed.
+typedef struct {
+    LayeredImage  image;
+    VkFramebuffer framebuffer;
+    uint64_t      retireAt;
+} Retired;
 
-static VkRenderPass gbufferRenderPass;
-static VkRenderPass deferredRenderPass;
-static uint32_t     graphic_queue_family_index;
+define_array_type(LayeredImage, layered_image);
+define_array_type(Retired, retired);
 
-static VkFramebuffer gframebuffer;
-static VkFramebuffer swapImageBuffer[MAX_FRAMES_IN_FLIGHT];
+// a pixel rect, empty when x1 <= x0 or y1 <= y0
+typedef struct {
+    int32_t x0, y0;
+    int32_t x1, y1;
+} Rect;
+
+#define RECT_FULL ((Rect){0, 0, INT32_MAX, INT32_MAX})
 
-static VkPipeline gbufferPipelines[GBUFFER_PIPELINE_COUNT];
-static VkPipeline defferedPipeline;
+// a copy of the geometry's table, as the block may be uncached to the host
+typedef struct {
+    GeometryLodTable table;
+    uint8_t          level;
+} InstanceLod;
 
-static VkPipeline              raytracePipeline;
-static OnyxShaderBindingTable shaderBindingTable;
+// a level is picked when its error covers at most this many pixels. a
+// coarser level is only switched to once its error is under the fraction,
+// so instances near the threshold don't flicker between two.
+#define LOD_PIXEL_ERROR 1.0f
+#define LOD_HYSTERESIS  0.5f
 
-static BufferRegion cameraBuffers[MAX_FRAMES_IN_FLIGHT];
-static BufferRegion xformsBuffers[MAX_FRAMES_IN_FLIGHT];
-static BufferRegion lightsBuffers[MAX_FRAMES_IN_FLIGHT];
-static BufferRegion materialsBuffers[MAX_FRAMES_IN_FLIGHT];
+// what we last drew a prim with, to find the screen area it moved out of
+typedef struct {
+    Mat4 xform;
+    Vec3 min;
+    Vec3 max;
+    // 0 until the bounds are needed, -1 if the vertices aren't host visible
+    int8_t boundsState;
+} PrimBounds;
+
+// the images of the frame graph, in the order they are declared
+enum {
+    GRAPH_WORLD_P,
+    GRAPH_NORMAL,
+    GRAPH_ALBEDO,
+    GRAPH_ROUGHNESS,
+    GRAPH_DEPTH,
+    GRAPH_VISIBILITY,
+    GRAPH_SHADOW,
+    GRAPH_LIT,
+    GRAPH_SWAPCHAIN,
+    GRAPH_TILE_LIGHTS,
+};
 
-static const OnyxInstance* instance;
-static OnyxMemory*         memory;
-static VkDevice             device;
+enum {
+    GRAPH_PASS_VISIBILITY,
+    GRAPH_PASS_RESOLVE,
+    GRAPH_PASS_PREPASS,
+    GRAPH_PASS_GBUFFER,
+    GRAPH_PASS_SHADOW,
+    GRAPH_PASS_DEFERRED,
+    GRAPH_PASS_LIGHT_CULL,
+    GRAPH_PASS_FORWARD,
+    GRAPH_PASS_COMPOSITE,
+    GRAPH_PASS_READBACK_COPY,
+    GRAPH_PASS_READBACK_CONVERT,
+};
 
-static OnyxPrimitiveList pipelinePrimLists[GBUFFER_PIPELINE_COUNT];
+// the attachments the gbuffer pass writes and the shadow and deferred passes
+// read. either one set shared by every frame, or one per frame in flight so
+// consecutive frames don't serialize on them. the depth buffer, the
+// visibility buffer, and the shadow image with ray tracing, are transient
+// images of the graph. the forward mode has none of the gbuffer images, only
+// the depth and the tile lights.
+typedef struct {
+    LayeredImage  worldP;
+    LayeredImage  normal;
+    // only without ray tracing, holding no shadow everywhere
+    LayeredImage  shadow;
+    LayeredImage  albedo;
+    LayeredImage  roughness;
+    // the lights reaching each tile, a texel per tile
+    LayeredImage  tileLights;
+    VkFramebuffer framebuffer;
+    // the depth prepass's, over the graph's depth image. not made in the
+    // visibility buffer mode, whose visibility pass draws depth first.
+    VkFramebuffer depthFramebuffer;
+    // the visibility buffer mode's, over the graph's visibility and depth
+    // images
+    VkFramebuffer visibilityFramebuffer;
+    RenderGraph   graph;
+    // attachment size, 0 until first used
+    uint32_t      width;
+    uint32_t      height;
+    // bumped when the images are replaced, so each frame slot knows to
+    // rewrite its descriptors
+    uint32_t      generation;
+} GBuffer;
+
+// one buffer of the readback ring and what it last held, a frame of 0 if
+// nothing
+#define MAX_READBACK_RING 8
 
-// raytrace stuff
+typedef struct {
+    BufferRegion buffer;
+    WoadReadback info;
+} Readback;
 
-static AccelerationStructureArray blas_array;
-static AccelerationStructure tlas[MAX_FRAMES_IN_FLIGHT];
+// a pipeline made for one permutation of its shaders' specialization
+// constants, the first time a recording needs it
+typedef struct {
+    uint32_t   key;
+    VkPipeline pipeline;
+} Permutation;
 
-// raytrace stuff
+define_array_type(Permutation, permutation);
 
-static VkDescriptorSetLayout descriptorSetLayouts[DESC_SET_COUNT];
-static VkDescriptorPool      descriptorPool;
-static VkDescriptorSet       descriptorSets[MAX_FRAMES_IN_FLIGHT][2];
+// caps each cache of permutations. once full, recordings keep to the
+// pipeline that reads what it would have been specialized to at run time.
+#define MAX_PERMUTATIONS 32
 
-static VkPipelineLayout pipelineLayout;
+// the shaders that pipelines with permutations are made from
+enum {
+    SHADER_REGULAR_VERT,
+    SHADER_TANGENT_VERT,
+    SHADER_POS_VERT,
+    SHADER_PACKED_VERT,
+    SHADER_PACKED_TAN_VERT,
+    SHADER_GBUFFER_FRAG,
+    SHADER_GBUFFER_TAN_FRAG,
+    SHADER_GBUFFER_POS_FRAG,
+    SHADER_FULL_SCREEN_VERT,
+    SHADER_DEFERRED_FRAG,
+    SHADER_DEFERRED_COMP,
+    PERMUTED_SHADER_COUNT
+};
 
-static Image renderTargetDepth;
-static Image imageWorldP;
-static Image imageNormal;
-static Image imageShadow;
-static Image imageAlbedo;
-static Image imageRoughness;
+// State that doesn't depend on the scene or the swapchain. Created by the
+// first woad_Init and destroyed by the last woad_Cleanup. The lock guards
+// the refcounts and the blas cache, and serializes our queue submissions
+// since vulkan queues must be externally synchronized.
+typedef struct {
+    pthread_mutex_t lock;
+    uint32_t        refs;
+    VkDevice        device;
+
+    // indexed by view count - 1. multiview passes are only compatible with
+    // pipelines made for the same view mask.
+    VkRenderPass          gbufferRenderPass[MAX_VIEWS];
+    VkPipeline            gbufferPipelines[MAX_VIEWS][GBUFFER_PIPELINE_COUNT];
+    // the gbuffer pipelines specialized to the maps their bucket's
+    // materials have, keyed by bucket and maps
+    PermutationArray      gbufferPermutations[MAX_VIEWS];
+    // the gbuffer pass after a depth prepass, keeping its depth. compatible
+    // with the one above.
+    VkRenderPass          gbufferPrepassedRenderPass[MAX_VIEWS];
+    // for the visibility buffer mode, only made once a renderer uses it.
+    // the gbuffer pass then loads what the resolve wrote, with a render
+    // pass compatible with the one above.
+    VkRenderPass          visibilityRenderPass[MAX_VIEWS];
+    VkRenderPass          gbufferLoadRenderPass[MAX_VIEWS];
+    VkPipeline            visibilityPipelines[MAX_VIEWS];
+    VkPipeline            resolvePipeline;
+    // the depth prepass, drawn with position only vertex shaders, and the
+    // forward mode's light culling
+    VkRenderPass          depthRenderPass[MAX_VIEWS];
+    VkPipeline            depthPipelines[MAX_VIEWS][GBUFFER_PIPELINE_COUNT];
+    VkPipeline            lightCullPipeline;
+    // converts lit images for nv12 readbacks, once a renderer asks for them
+    VkPipeline            readbackPipeline;
+    VkPipeline            raytracePipeline;
+    OnyxShaderBindingTable shaderBindingTable;
+    VkDescriptorSetLayout descriptorSetLayouts[DESC_SET_COUNT];
+    VkPipelineLayout      pipelineLayout;
+    VkSampler             litSampler;
+
+    BlasEntryArray blasCache;
+    // read by the first initPipelines and kept for as long as the process,
+    // since any recording may need another permutation made from them
+    ByteArray      permutedShaders[PERMUTED_SHADER_COUNT];
+} Shared;
+
+static Shared shared = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+struct WoadRenderer {
+    const OnyxInstance* instance;
+    OnyxMemory*         memory;
+    VkDevice            device;
+    uint32_t            graphic_queue_family_index;
+    bool                raytracing_disabled;
+
+    // these depend on the swapchain format, so they are not shared. with
+    // compute shading there is no deferred render pass, and the pipeline is
+    // a compute one.
+    VkRenderPass  deferredRenderPass;
+    VkPipeline    defferedPipeline;
+    bool          computeShading;
+    // the deferred pipeline specialized to the scene's lights, keyed by
+    // their count and types
+    PermutationArray deferredPermutations;
+    // forward shading replaces the deferred pass and the gbuffer with one
+    // that draws into the lit image, through the lit framebuffers
+    bool          forward;
+    VkRenderPass  forwardRenderPass;
+    VkPipeline    forwardPipelines[GBUFFER_PIPELINE_COUNT];
+    // the gbuffer pass draws against depth from a prepass, so overdrawn
+    // fragments skip their material fetches and writes. set between frames
+    // with woad_SetDepthPrepass.
+    bool          depthPrepass;
+    VkFramebuffer swapImageBuffer[MAX_SWAPCHAIN_IMAGES];
+    // track uuid for each swapimage
+    int64_t       swapImageUuids[MAX_SWAPCHAIN_IMAGES];
+    bool          swapImageSeen[MAX_SWAPCHAIN_IMAGES];
+    // bumped whenever any lit image is redrawn. each swapchain image
+    // remembers the one it was composited at, 0 if never.
+    uint32_t      litVersion;
+    uint32_t      swapImageVersion[MAX_SWAPCHAIN_IMAGES];
+    bool          onDemand;
+
+    uint8_t       viewCount;
+    WoadView      views[MAX_VIEWS];
+    bool          viewsSet;
+    bool          viewsDirty;
+
+    // the deferred pass shades into a lit image per frame slot. with one
+    // view the composite pass then copies it to the swapchain image; with
+    // more the caller reads it directly.
+    VkFormat      litFormat;
+    VkImageLayout litLayout;
+    LayeredImage  litImages[MAX_FRAMES_IN_FLIGHT];
+    VkFramebuffer litBuffers[MAX_FRAMES_IN_FLIGHT];
+    uint8_t       lastFrameIndex;
+    VkRenderPass  compositeRenderPass;
+    VkPipeline    compositePipeline;
+    // composite straight into the swapchain image with dynamic rendering,
+    // so swapchain images need no framebuffers
+    bool          dynamicRendering;
+    VkImageLayout finalColorLayout;
+
+    // the lit image of each recorded frame is copied into the ring entry
+    // its render count picks and handed to readbackFn once the frame has
+    // completed. see woad_SetReadback.
+    WoadReadbackFn     readbackFn;
+    void*              readbackUser;
+    WoadReadbackFormat readbackFormat;
+    uint8_t            readbackRingSize;
+    Readback           readbacks[MAX_READBACK_RING];
+    // the lit image holds linear values the swapchain's srgb format encodes
+    bool               litLinear;
+
+    // the part of the frame each slot's lit image, and gbuffer, is missing.
+    // changes are added to every slot and a slot's rect is cleared once it
+    // has been redrawn.
+    Rect          pendingRects[MAX_FRAMES_IN_FLIGHT];
+    bool          shadowsMoved[MAX_FRAMES_IN_FLIGHT];
+    VkRect2D      lastRegion;
+    PrimBounds*   primBounds;
+    uint32_t      primBoundsCount;
+    uint32_t      primBoundsCapacity;
+
+    BufferRegion cameraBuffers[MAX_FRAMES_IN_FLIGHT];
+    BufferRegion instancesBuffers[MAX_FRAMES_IN_FLIGHT];
+    uint32_t     instancesCapacity[MAX_FRAMES_IN_FLIGHT];
+    BufferRegion lightsBuffers[MAX_FRAMES_IN_FLIGHT];
+    BufferRegion materialsBuffers[MAX_FRAMES_IN_FLIGHT];
+    uint32_t     materialsCapacity[MAX_FRAMES_IN_FLIGHT];
+
+    UploadMirror  cameraMirror;
+    UploadMirror  instancesMirror;
+    UploadMirror  lightsMirror;
+    UploadMirror  materialsMirror;
+    StagingBuffer stagingRing[MAX_FRAMES_IN_FLIGHT];
+    // the frame's material or instance table was reallocated and must be
+    // filled in whole
+    bool          materialsReplaced[MAX_FRAMES_IN_FLIGHT];
+    bool          instancesReplaced[MAX_FRAMES_IN_FLIGHT];
+
+    TextureSlot boundTextures[MAX_FRAMES_IN_FLIGHT][MAX_TEXTURE_COUNT];
+    // the streaming feedback each slot's gbuffer pass writes, and the
+    // largest sizes read back from it since woad_StreamTextures last ran
+    BufferRegion feedbackBuffers[MAX_FRAMES_IN_FLIGHT];
+    uint8_t      textureDemand[MAX_TEXTURE_COUNT];
+    // only redrawn pixels report demand. set for a slot whose last frame
+    // redrew the whole region, and then for the demand once that is read,
+    // since only then does an unsampled texture mean an unseen one.
+    bool         feedbackComplete[MAX_FRAMES_IN_FLIGHT];
+    bool         demandComplete;
+
+    DrawArray pipelineDraws[GBUFFER_PIPELINE_COUNT];
+    Draw*     drawSortScratch;
+    uint32_t  drawSortScratchCapacity;
+    // the camera or prims moved since the draws were depth sorted. they are
+    // only resorted when the draws are next recorded.
+    bool      drawDepthsStale;
+
+    // the prim behind each instance slot, and the table built from them
+    PrimHandleArray instancePrims;
+    DrawInstance*   instanceScratch;
+    uint32_t        instanceScratchCapacity;
+    // the level of detail each instance slot draws, and the levels its
+    // geometry has. no levels for geometry that isn't packed.
+    InstanceLod*    instanceLods;
+    uint32_t        instanceLodsCapacity;
+    bool            coarseShadows;
+    // may be NULL
+    WoadSceneCache* sceneCache;
+
+    VkCommandPool gbufferCachePool;
+    // the gbuffer pass's draws, or in the forward mode the forward pass's
+    GbufferCache  gbufferCache[MAX_FRAMES_IN_FLIGHT];
+    // packed geometry is drawn to the visibility buffer and resolved into
+    // the gbuffer by a compute pass. the gbuffer pass only draws the rest.
+    bool          visibilityBuffer;
+    // the draws of whatever pass comes before the gbuffer or forward pass:
+    // the visibility buffer or the depth prepass
+    GbufferCache  prepassCache[MAX_FRAMES_IN_FLIGHT];
+
+    // raytrace stuff
+
+    // the geometry of each blas we hold a reference on, and a copy of the
+    // blas itself in the order the tlas expects
+    BlasKeyArray               blasGeos;
+    AccelerationStructureArray blas_array;
+    AccelerationStructure      tlas[MAX_FRAMES_IN_FLIGHT];
+
+    // raytrace stuff
+
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet  descriptorSets[MAX_FRAMES_IN_FLIGHT][2];
+
+    GBuffer  gbuffers[MAX_FRAMES_IN_FLIGHT];
+    uint8_t  gbufferCount;
+    uint32_t slotGbufferGeneration[MAX_FRAMES_IN_FLIGHT];
+    // the geometry blocks each slot's main set points at
+    uint32_t slotGeometryGeneration[MAX_FRAMES_IN_FLIGHT];
+
+    // woad_Render calls that recorded anything. the caller has waited for
+    // all but the last framesInFlight of them.
+    uint64_t            renderCount;
+    RetiredArray        retired;
+    LayeredImageArray   imagePool;
+
+    uint8_t framesInFlight;
+    // frame slot the next woad_Render call records into
+    uint8_t frameCounter;
+
+    uint8_t asNeedUpdate;
+    uint8_t texturesNeedUpdate;
+    bool    mirrorsSynced;
+};
 
 static const VkFormat depthFormat  = VK_FORMAT_D32_SFLOAT;
 static const VkFormat formatImageP = VK_FORMAT_R32G32B32A32_SFLOAT;
@@ -134,152 +596,402 @@ static const VkFormat formatImageShadow =
     VK_FORMAT_R16_UINT; // maximum of 16 lights.
 static const VkFormat formatImageAlbedo    = VK_FORMAT_R8G8B8A8_UNORM;
 static const VkFormat formatImageRoughness = VK_FORMAT_R32_SFLOAT;
+// instance slot + 1, 0 for background, and triangle
+static const VkFormat formatImageVisibility = VK_FORMAT_R32G32_UINT;
+// a bit per light, like the shadow image
+static const VkFormat formatImageTileLights = VK_FORMAT_R16_UINT;
+
+// what the lit image starts as, and what shading leaves where nothing was
+// drawn. must match BACKGROUND in shading.glsl
+static const VkClearColorValue litBackground = {.float32 = {0.1, 0.1, 0.1,
+                                                            1.0}};
+
+// every stage that reads the push constants
+static const VkShaderStageFlags pushStages = VK_SHADER_STAGE_FRAGMENT_BIT |
+                                             VK_SHADER_STAGE_RAYGEN_BIT_KHR |
+                                             VK_SHADER_STAGE_COMPUTE_BIT;
 
 // declarations for overview and navigation
-static void initDescriptorSetsAndPipelineLayouts(void);
-static void updateDescriptors(void);
+static void initSharedLayouts(void);
+static void initDescriptorSets(WoadRenderer* r);
+static void updateDescriptors(WoadRenderer* r);
+static void updateDrawDepths(WoadRenderer* r, const OnyxScene* scene);
+static void resetLods(WoadRenderer* r, const OnyxScene* scene);
 static void syncScene(const uint32_t frameIndex);
 
-static bool raytracing_disabled = false;
-
 void r_InitRenderer(const OnyxScene* scene_, VkImageLayout finalImageLayout,
                     bool openglStyle);
 void r_CleanUp(void);
 uint8_t
-r_GetMaxFramesInFlight(void)
+r_GetMaxFramesInFlight(const WoadRenderer* r)
+{
+    return r->framesInFlight;
+}
+
+static GBuffer*
+frameGbuffer(WoadRenderer* r, uint32_t frameIndex)
+{
+    return &r->gbuffers[frameIndex % r->gbufferCount];
+}
+
+static uint32_t
+findMemoryType(const WoadRenderer* r, uint32_t typeBits,
+               VkMemoryPropertyFlags properties)
+{
+    VkPhysicalDeviceMemoryProperties memProps;
+    vkGetPhysicalDeviceMemoryProperties(r->instance->physical_device,
+                                        &memProps);
+    for (uint32_t i = 0; i < memProps.memoryTypeCount; i++)
+    {
+        if ((typeBits & (1u << i)) &&
+            (memProps.memoryTypes[i].propertyFlags & properties) == properties)
+            return i;
+    }
+    fatal_error("Woad: no suitable memory type for image.");
+    return 0;
+}
+
+static LayeredImage
+createLayeredImage(const WoadRenderer* r, uint32_t width, uint32_t height,
+                   VkFormat format, VkImageUsageFlags usage,
+                   VkImageAspectFlags aspect)
 {
-    return MAX_FRAMES_IN_FLIGHT;
+    LayeredImage img = {.width  = width,
+                        .height = height,
+                        .format = format,
+                        .usage  = usage,
+                        .aspect = aspect};
+
+    const VkImageCreateInfo imageInfo = {
+        .sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType     = VK_IMAGE_TYPE_2D,
+        .format        = format,
+        .extent        = {width, height, 1},
+        .mipLevels     = 1,
+        .arrayLayers   = r->viewCount,
+        .samples       = VK_SAMPLE_COUNT_1_BIT,
+        .tiling        = VK_IMAGE_TILING_OPTIMAL,
+        .usage         = usage,
+        .sharingMode   = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED};
+
+    V_ASSERT(vkCreateImage(r->device, &imageInfo, NULL, &img.handle));
+
+    VkMemoryRequirements reqs;
+    vkGetImageMemoryRequirements(r->device, img.handle, &reqs);
+
+    const VkMemoryAllocateInfo allocInfo = {
+        .sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize  = reqs.size,
+        .memoryTypeIndex = findMemoryType(r, reqs.memoryTypeBits,
+                                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)};
+
+    V_ASSERT(vkAllocateMemory(r->device, &allocInfo, NULL, &img.memory));
+    V_ASSERT(vkBindImageMemory(r->device, img.handle, img.memory, 0));
+
+    // always an array view, even with one view, so the shaders have a
+    // single image type to declare
+    const VkImageViewCreateInfo viewInfo = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image            = img.handle,
+        .viewType         = VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+        .format           = format,
+        .subresourceRange = {aspect, 0, 1, 0, r->viewCount}};
+
+    V_ASSERT(vkCreateImageView(r->device, &viewInfo, NULL, &img.view));
+
+    return img;
 }
 
 static void
-initAttachments(uint32_t windowWidth, uint32_t windowHeight)
+freeLayeredImage(const WoadRenderer* r, LayeredImage* img)
 {
-    renderTargetDepth = onyx_create_image(
-        memory, windowWidth, windowHeight, VK_FORMAT_D32_SFLOAT,
-        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
-            VK_IMAGE_USAGE_SAMPLED_BIT,
-        VK_IMAGE_ASPECT_DEPTH_BIT, VK_SAMPLE_COUNT_1_BIT, 1,
-        ONYX_MEMORY_DEVICE_TYPE);
+    vkDestroyImageView(r->device, img->view, NULL);
+    vkDestroyImage(r->device, img->handle, NULL);
+    vkFreeMemory(r->device, img->memory, NULL);
+    *img = (LayeredImage){0};
+}
 
-    imageWorldP = onyx_create_image(
-        memory, windowWidth, windowHeight, formatImageP,
-        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
-        VK_IMAGE_ASPECT_COLOR_BIT, VK_SAMPLE_COUNT_1_BIT, 1,
-        ONYX_MEMORY_DEVICE_TYPE);
+// onyx's transition and clear helpers only touch the first layer. this
+// covers every layer, and makes the image ready for transfer writes.
+static void
+cmdTransitionLayers(VkCommandBuffer cmdbuf, VkImage image,
+                    VkImageLayout oldLayout, VkImageLayout newLayout)
+{
+    const VkImageMemoryBarrier barrier = {
+        .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT |
+                               VK_ACCESS_SHADER_READ_BIT |
+                               VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .oldLayout           = oldLayout,
+        .newLayout           = newLayout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image               = image,
+        .subresourceRange    = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0,
+                                VK_REMAINING_ARRAY_LAYERS}};
+
+    vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT |
+                             VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT,
+                         0, 0, NULL, 0, NULL, 1, &barrier);
+}
 
-    imageNormal = onyx_create_image(
-        memory, windowWidth, windowHeight, formatImageN,
-        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
-        VK_IMAGE_ASPECT_COLOR_BIT, VK_SAMPLE_COUNT_1_BIT, 1,
-        ONYX_MEMORY_DEVICE_TYPE);
+static uint32_t
+bucketSize(uint32_t n)
+{
+    const uint32_t steps = (n + ATTACHMENT_SIZE_STEP - 1) / ATTACHMENT_SIZE_STEP;
+    return (steps ? steps : 1) * ATTACHMENT_SIZE_STEP;
+}
 
-    imageShadow = onyx_create_image(
-        memory, windowWidth, windowHeight, formatImageShadow,
-        VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-        VK_IMAGE_ASPECT_COLOR_BIT, VK_SAMPLE_COUNT_1_BIT, 1,
-        ONYX_MEMORY_DEVICE_TYPE);
+// an image from the pool if one matches, otherwise a new one. its contents
+// and layout are undefined either way.
+static LayeredImage
+acquireImage(WoadRenderer* r, uint32_t width, uint32_t height, VkFormat format,
+             VkImageUsageFlags usage, VkImageAspectFlags aspect)
+{
+    LayeredImageArray* pool = &r->imagePool;
+    for (int i = 0; i < pool->count; i++)
+    {
+        const LayeredImage img = pool->elems[i];
+        if (img.width != width || img.height != height ||
+            img.format != format || img.usage != usage || img.aspect != aspect)
+            continue;
+        pool->elems[i] = pool->elems[pool->count - 1];
+        layered_image_arr_set_count(pool, pool->count - 1);
+        return img;
+    }
+    return createLayeredImage(r, width, height, format, usage, aspect);
+}
+
+// the frame being recorded, and any still in flight, may use these
+static void
+retireImage(WoadRenderer* r, const LayeredImage* img)
+{
+    const Retired retired = {.image    = *img,
+                             .retireAt = r->renderCount + r->framesInFlight};
+    retired_arr_push(&r->retired, retired);
+}
+
+static void
+retireFramebuffer(WoadRenderer* r, VkFramebuffer framebuffer)
+{
+    const Retired retired = {.framebuffer = framebuffer,
+                             .retireAt    = r->renderCount + r->framesInFlight};
+    retired_arr_push(&r->retired, retired);
+}
+
+// pools or destroys whatever the gpu is done with. the pool drops its oldest
+// images past MAX_POOLED_IMAGES.
+static void
+collectRetired(WoadRenderer* r)
+{
+    int i = 0;
+    while (i < r->retired.count)
+    {
+        Retired* retired = &r->retired.elems[i];
+        if (retired->retireAt > r->renderCount)
+        {
+            i++;
+            continue;
+        }
+        if (retired->framebuffer != VK_NULL_HANDLE)
+            onyx_destroy_framebuffer(r->device, retired->framebuffer);
+        if (retired->image.handle != VK_NULL_HANDLE)
+        {
+            LayeredImageArray* pool = &r->imagePool;
+            if (pool->count == MAX_POOLED_IMAGES)
+            {
+                freeLayeredImage(r, &pool->elems[0]);
+                memmove(pool->elems, pool->elems + 1,
+                        sizeof(LayeredImage) * (pool->count - 1));
+                layered_image_arr_set_count(pool, pool->count - 1);
+            }
+            layered_image_arr_push(pool, retired->image);
+        }
+        *retired = r->retired.elems[r->retired.count - 1];
+        retired_arr_set_count(&r->retired, r->retired.count - 1);
+    }
+    for (int g = 0; g < r->gbufferCount; g++)
+        graph_Collect(&r->gbuffers[g].graph, r->renderCount);
+}
+
+// the forward mode's tile lights, in place of the gbuffer images. they are
+// only read where the light culling has just written them.
+// a texel per tile of the forward mode's frame, holding the lights found
+// to reach it
+static void
+initTileLights(WoadRenderer* r, VkCommandBuffer cmdbuf, GBuffer* gbuf,
+               uint32_t width, uint32_t height)
+{
+    gbuf->tileLights = acquireImage(
+        r, (width + TILE_SIZE - 1) / TILE_SIZE,
+        (height + TILE_SIZE - 1) / TILE_SIZE, formatImageTileLights,
+        VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+    cmdTransitionLayers(cmdbuf, gbuf->tileLights.handle,
+                        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+}
 
-    imageAlbedo = onyx_create_image(
-        memory, windowWidth, windowHeight, formatImageAlbedo,
+static void
+initGbufferImages(WoadRenderer* r, VkCommandBuffer cmdbuf, GBuffer* gbuf,
+                  uint32_t width, uint32_t height)
+{
+    gbuf->worldP = acquireImage(
+        r, width, height, formatImageP,
         VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
-        VK_IMAGE_ASPECT_COLOR_BIT, VK_SAMPLE_COUNT_1_BIT, 1,
-        ONYX_MEMORY_DEVICE_TYPE);
+        VK_IMAGE_ASPECT_COLOR_BIT);
 
-    imageRoughness = onyx_create_image(
-        memory, windowWidth, windowHeight, formatImageRoughness,
+    gbuf->normal = acquireImage(
+        r, width, height, formatImageN,
         VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
-        VK_IMAGE_ASPECT_COLOR_BIT, VK_SAMPLE_COUNT_1_BIT, 1,
-        ONYX_MEMORY_DEVICE_TYPE);
+        VK_IMAGE_ASPECT_COLOR_BIT);
 
-    OnyxCommandPool pool =
-        onyx_create_command_pool_(device, graphic_queue_family_index,
-                               VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, 1);
-    VkCommandBuffer cmdbuf = pool.cmdbufs[0];
-    onyx_begin_command_buffer(cmdbuf);
+    gbuf->albedo = acquireImage(
+        r, width, height, formatImageAlbedo,
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT);
 
-    OnyxBarrierScopes b  = {};
-    b.src.access_mask = 0;
-    b.dst.access_mask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    b.src.stage_mask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-    b.dst.stage_mask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    gbuf->roughness = acquireImage(
+        r, width, height, formatImageRoughness,
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT);
 
-    onyx_cmd_transition_image_layout(cmdbuf, b, VK_IMAGE_LAYOUT_UNDEFINED,
-                                  VK_IMAGE_LAYOUT_GENERAL, 1,
-                                  imageShadow.handle);
+    // only the dirty part of the gbuffer is redrawn each frame, so the color
+    // attachments live in GENERAL and are never discarded by a transition
+    const VkImage colorImages[] = {gbuf->worldP.handle, gbuf->normal.handle,
+                                   gbuf->albedo.handle, gbuf->roughness.handle};
+    for (int i = 0; i < LEN(colorImages); i++)
+        cmdTransitionLayers(cmdbuf, colorImages[i], VK_IMAGE_LAYOUT_UNDEFINED,
+                            VK_IMAGE_LAYOUT_GENERAL);
 
-    onyx_cmd_clear_color_image(cmdbuf, imageShadow.handle, VK_IMAGE_LAYOUT_GENERAL,
-                            0, 1, 1.0, 0, 0, 0);
+    if (r->raytracing_disabled)
+    {
+        gbuf->shadow = acquireImage(
+            r, width, height, formatImageShadow,
+            VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            VK_IMAGE_ASPECT_COLOR_BIT);
+        cmdTransitionLayers(cmdbuf, gbuf->shadow.handle,
+                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+
+        const VkImageSubresourceRange allLayers = {
+            VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, VK_REMAINING_ARRAY_LAYERS};
+        const VkClearColorValue clearColor = {.float32 = {1.0, 0, 0, 0}};
+        vkCmdClearColorImage(cmdbuf, gbuf->shadow.handle,
+                             VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1,
+                             &allLayers);
+    }
+}
 
-    onyx_end_command_buffer(cmdbuf);
+// records the setup of freshly acquired gbuffer images into cmdbuf
+static void
+initAttachments(WoadRenderer* r, VkCommandBuffer cmdbuf, GBuffer* gbuf,
+                uint32_t width, uint32_t height)
+{
+    if (r->forward)
+        initTileLights(r, cmdbuf, gbuf, width, height);
+    else
+        initGbufferImages(r, cmdbuf, gbuf, width, height);
 
-    VkSubmitInfo si = onyx_submit_info(0, NULL, NULL, 1, &cmdbuf, 0, NULL);
+    graph_Allocate(&gbuf->graph, width, height,
+                   r->renderCount + r->framesInFlight);
 
-    VkQueue queue = onyx_get_graphics_queue(instance, 0);
-    VkFence fence;
-    onyx_create_fence(device, false, &fence);
-    vkQueueSubmit(queue, 1, &si, fence);
-    onyx_wait_for_fence(device, &fence);
+    gbuf->width  = width;
+    gbuf->height = height;
+    gbuf->generation++;
+}
 
-    onyx_destroy_fence(device, fence);
-    onyx_destroy_command_pool(device, &pool);
+static void
+retireAttachments(WoadRenderer* r, GBuffer* gbuf)
+{
+    if (gbuf->width == 0)
+        return;
+    if (!r->visibilityBuffer)
+        retireFramebuffer(r, gbuf->depthFramebuffer);
+    if (r->forward)
+    {
+        retireImage(r, &gbuf->tileLights);
+        return;
+    }
+    retireFramebuffer(r, gbuf->framebuffer);
+    const LayeredImage* images[] = {&gbuf->worldP, &gbuf->normal,
+                                    &gbuf->albedo, &gbuf->roughness};
+    for (int i = 0; i < LEN(images); i++)
+        retireImage(r, images[i]);
+    if (r->raytracing_disabled)
+        retireImage(r, &gbuf->shadow);
+    if (r->visibilityBuffer)
+        retireFramebuffer(r, gbuf->visibilityFramebuffer);
 }
 
+// with load, the pass draws over what the visibility resolve left in the
+// gbuffer, depth tested against the visibility pass's depth. with only
+// loadDepth it clears the gbuffer and tests against the depth prepass's.
 static void
-initGbufRenderPass(void)
+initGbufRenderPass(uint8_t viewCount, bool load, bool loadDepth,
+                   VkRenderPass* renderPass)
 {
+    const VkAttachmentLoadOp loadOp =
+        load ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+
     VkAttachmentDescription attachmentWorldP = {
         .flags          = 0,
         .format         = formatImageP,
         .samples        = VK_SAMPLE_COUNT_1_BIT,
-        .loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .loadOp         = loadOp,
         .storeOp        = VK_ATTACHMENT_STORE_OP_STORE,
         .stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED,
+        .initialLayout  = VK_IMAGE_LAYOUT_GENERAL,
         .finalLayout    = VK_IMAGE_LAYOUT_GENERAL};
 
     VkAttachmentDescription attachmentNormal = {
         .flags          = 0,
         .format         = formatImageN,
         .samples        = VK_SAMPLE_COUNT_1_BIT,
-        .loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .loadOp         = loadOp,
         .storeOp        = VK_ATTACHMENT_STORE_OP_STORE,
         .stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED,
+        .initialLayout  = VK_IMAGE_LAYOUT_GENERAL,
         .finalLayout    = VK_IMAGE_LAYOUT_GENERAL};
 
     VkAttachmentDescription attachmentAlbedo = {
         .flags          = 0,
         .format         = formatImageAlbedo,
         .samples        = VK_SAMPLE_COUNT_1_BIT,
-        .loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .loadOp         = loadOp,
         .storeOp        = VK_ATTACHMENT_STORE_OP_STORE,
         .stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED,
+        .initialLayout  = VK_IMAGE_LAYOUT_GENERAL,
         .finalLayout    = VK_IMAGE_LAYOUT_GENERAL};
 
     VkAttachmentDescription attachmentRoughness = {
         .flags          = 0,
         .format         = formatImageRoughness,
         .samples        = VK_SAMPLE_COUNT_1_BIT,
-        .loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .loadOp         = loadOp,
         .storeOp        = VK_ATTACHMENT_STORE_OP_STORE,
         .stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED,
+        .initialLayout  = VK_IMAGE_LAYOUT_GENERAL,
         .finalLayout    = VK_IMAGE_LAYOUT_GENERAL};
 
     VkAttachmentDescription attachmentDepth = {
         .flags          = 0,
         .format         = depthFormat,
         .samples        = VK_SAMPLE_COUNT_1_BIT,
-        .loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .loadOp         = loadDepth ? VK_ATTACHMENT_LOAD_OP_LOAD
+                                    : VK_ATTACHMENT_LOAD_OP_CLEAR,
         .storeOp        = VK_ATTACHMENT_STORE_OP_DONT_CARE,
         .stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED,
+        // depth is cleared over whatever area gets redrawn, so it needn't
+        // survive between frames like the color attachments do
+        .initialLayout  = loadDepth
+                              ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+                              : VK_IMAGE_LAYOUT_UNDEFINED,
         .finalLayout    = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
 
     VkAttachmentReference refWorldP = {
@@ -344,9 +1056,20 @@ initGbufRenderPass(void)
         attachmentWorldP, attachmentNormal, attachmentAlbedo,
         attachmentRoughness, attachmentDepth};
 
+    // every view sees the same geometry, so let the driver share work
+    // across them where it can
+    const uint32_t viewMask = (1u << viewCount) - 1;
+
+    const VkRenderPassMultiviewCreateInfo multiviewInfo = {
+        .sType                = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO,
+        .subpassCount         = 1,
+        .pViewMasks           = &viewMask,
+        .correlationMaskCount = 1,
+        .pCorrelationMasks    = &viewMask};
+
     VkRenderPassCreateInfo rpiInfo = {
         .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-        .pNext           = NULL,
+        .pNext           = viewCount > 1 ? &multiviewInfo : NULL,
         .flags           = 0,
         .attachmentCount = LEN(attachments),
         .pAttachments    = attachments,
@@ -355,32 +1078,365 @@ initGbufRenderPass(void)
         .dependencyCount = LEN(deps),
         .pDependencies   = deps};
 
-    V_ASSERT(vkCreateRenderPass(device, &rpiInfo, NULL, &gbufferRenderPass));
+    V_ASSERT(vkCreateRenderPass(shared.device, &rpiInfo, NULL, renderPass));
+}
+
+// clears the visibility buffer and depth over the render area and draws
+// packed geometry into them. depth is kept for the gbuffer pass after the
+// resolve.
+static void
+initVisibilityRenderPass(uint8_t viewCount)
+{
+    const VkAttachmentDescription attachments[] = {
+        {.format         = formatImageVisibility,
+         .samples        = VK_SAMPLE_COUNT_1_BIT,
+         .loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR,
+         .storeOp        = VK_ATTACHMENT_STORE_OP_STORE,
+         .stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+         .initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED,
+         .finalLayout    = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+        {.format         = depthFormat,
+         .samples        = VK_SAMPLE_COUNT_1_BIT,
+         .loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR,
+         .storeOp        = VK_ATTACHMENT_STORE_OP_STORE,
+         .stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+         .initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED,
+         .finalLayout    = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL}};
+
+    const VkAttachmentReference refVisibility = {
+        .attachment = 0, .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    const VkAttachmentReference refDepth = {
+        .attachment = 1,
+        .layout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+    const VkSubpassDescription subpass = {
+        .pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .colorAttachmentCount    = 1,
+        .pColorAttachments       = &refVisibility,
+        .pDepthStencilAttachment = &refDepth};
+
+    const VkSubpassDependency deps[] = {
+        {.srcSubpass    = VK_SUBPASS_EXTERNAL,
+         .dstSubpass    = 0,
+         .srcStageMask  = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+         .dstStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                          VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+         .srcAccessMask = 0,
+         .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+         .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT},
+        {// the resolve reads the visibility buffer
+         .srcSubpass      = 0,
+         .dstSubpass      = VK_SUBPASS_EXTERNAL,
+         .srcStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+         .dstStageMask    = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+         .srcAccessMask   = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+         .dstAccessMask   = VK_ACCESS_SHADER_READ_BIT,
+         .dependencyFlags = 0}};
+
+    const uint32_t viewMask = (1u << viewCount) - 1;
+
+    const VkRenderPassMultiviewCreateInfo multiviewInfo = {
+        .sType                = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO,
+        .subpassCount         = 1,
+        .pViewMasks           = &viewMask,
+        .correlationMaskCount = 1,
+        .pCorrelationMasks    = &viewMask};
+
+    const VkRenderPassCreateInfo rpiInfo = {
+        .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .pNext           = viewCount > 1 ? &multiviewInfo : NULL,
+        .attachmentCount = LEN(attachments),
+        .pAttachments    = attachments,
+        .subpassCount    = 1,
+        .pSubpasses      = &subpass,
+        .dependencyCount = LEN(deps),
+        .pDependencies   = deps};
+
+    V_ASSERT(vkCreateRenderPass(shared.device, &rpiInfo, NULL,
+                                &shared.visibilityRenderPass[viewCount - 1]));
+}
+
+// the forward mode's depth prepass. depth is cleared over the render area
+// and kept for the light culling and the forward pass.
+static void
+initDepthRenderPass(uint8_t viewCount)
+{
+    const VkAttachmentDescription attachment = {
+        .format         = depthFormat,
+        .samples        = VK_SAMPLE_COUNT_1_BIT,
+        .loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp        = VK_ATTACHMENT_STORE_OP_STORE,
+        .stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED,
+        .finalLayout    = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+    const VkAttachmentReference refDepth = {
+        .attachment = 0,
+        .layout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+    const VkSubpassDescription subpass = {
+        .pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .pDepthStencilAttachment = &refDepth};
+
+    const VkSubpassDependency deps[] = {
+        {.srcSubpass    = VK_SUBPASS_EXTERNAL,
+         .dstSubpass    = 0,
+         .srcStageMask  = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+         .dstStageMask  = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+         .srcAccessMask = 0,
+         .dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+         .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT},
+        {// the light culling samples it, the forward pass tests against it
+         .srcSubpass      = 0,
+         .dstSubpass      = VK_SUBPASS_EXTERNAL,
+         .srcStageMask    = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+         .dstStageMask    = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+         .srcAccessMask   = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+         .dstAccessMask   = VK_ACCESS_SHADER_READ_BIT |
+                            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+         .dependencyFlags = 0}};
+
+    const uint32_t viewMask = (1u << viewCount) - 1;
+
+    const VkRenderPassMultiviewCreateInfo multiviewInfo = {
+        .sType                = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO,
+        .subpassCount         = 1,
+        .pViewMasks           = &viewMask,
+        .correlationMaskCount = 1,
+        .pCorrelationMasks    = &viewMask};
+
+    const VkRenderPassCreateInfo rpiInfo = {
+        .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .pNext           = viewCount > 1 ? &multiviewInfo : NULL,
+        .attachmentCount = 1,
+        .pAttachments    = &attachment,
+        .subpassCount    = 1,
+        .pSubpasses      = &subpass,
+        .dependencyCount = LEN(deps),
+        .pDependencies   = deps};
+
+    V_ASSERT(vkCreateRenderPass(shared.device, &rpiInfo, NULL,
+                                &shared.depthRenderPass[viewCount - 1]));
+}
+
+// the deferred pass shades into a lit image per frame slot rather than the
+// swapchain image, loading what is there so only the dirty area is redrawn.
+// with multiview every view goes to a layer of it.
+static void
+initDeferredRenderPass(WoadRenderer* r, VkImageLayout litLayout,
+                       VkFormat format)
+{
+    const VkAttachmentDescription attachment = {
+        .format         = format,
+        .samples        = VK_SAMPLE_COUNT_1_BIT,
+        .loadOp         = VK_ATTACHMENT_LOAD_OP_LOAD,
+        .storeOp        = VK_ATTACHMENT_STORE_OP_STORE,
+        .stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .initialLayout  = litLayout,
+        .finalLayout    = litLayout};
+
+    const VkAttachmentReference ref = {
+        .attachment = 0, .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+    const VkSubpassDescription subpass = {
+        .pipelineBindPoint    = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .colorAttachmentCount = 1,
+        .pColorAttachments    = &ref};
+
+    const VkSubpassDependency deps[] = {
+        {// the last composite of this image has finished reading it
+         .srcSubpass      = VK_SUBPASS_EXTERNAL,
+         .dstSubpass      = 0,
+         .srcStageMask    = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+         .dstStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+         .srcAccessMask   = 0,
+         .dstAccessMask   = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+         .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT},
+        {// the composite, or the caller, reads it afterwards
+         .srcSubpass    = 0,
+         .dstSubpass    = VK_SUBPASS_EXTERNAL,
+         .srcStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+         .dstStageMask  = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                          VK_PIPELINE_STAGE_TRANSFER_BIT,
+         .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+         .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT,
+         .dependencyFlags = 0}};
+
+    const uint32_t viewMask = (1u << r->viewCount) - 1;
+
+    const VkRenderPassMultiviewCreateInfo multiviewInfo = {
+        .sType                = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO,
+        .subpassCount         = 1,
+        .pViewMasks           = &viewMask,
+        .correlationMaskCount = 1,
+        .pCorrelationMasks    = &viewMask};
+
+    const VkRenderPassCreateInfo rpiInfo = {
+        .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .pNext           = r->viewCount > 1 ? &multiviewInfo : NULL,
+        .attachmentCount = 1,
+        .pAttachments    = &attachment,
+        .subpassCount    = 1,
+        .pSubpasses      = &subpass,
+        .dependencyCount = LEN(deps),
+        .pDependencies   = deps};
+
+    V_ASSERT(vkCreateRenderPass(r->device, &rpiInfo, NULL,
+                                &r->deferredRenderPass));
+}
+
+// the forward pass shades into the lit image like the deferred pass, but
+// clears the render area first since it only draws where there is
+// geometry. it tests against the prepass's depth without writing it, so
+// each pixel is shaded once.
+static void
+initForwardRenderPass(WoadRenderer* r, VkImageLayout litLayout,
+                      VkFormat format)
+{
+    const VkAttachmentDescription attachments[] = {
+        {.format         = format,
+         .samples        = VK_SAMPLE_COUNT_1_BIT,
+         .loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR,
+         .storeOp        = VK_ATTACHMENT_STORE_OP_STORE,
+         .stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+         .initialLayout  = litLayout,
+         .finalLayout    = litLayout},
+        {.format         = depthFormat,
+         .samples        = VK_SAMPLE_COUNT_1_BIT,
+         .loadOp         = VK_ATTACHMENT_LOAD_OP_LOAD,
+         .storeOp        = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+         .stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+         .initialLayout  = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+         .finalLayout    = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL}};
+
+    const VkAttachmentReference refLit = {
+        .attachment = 0, .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    const VkAttachmentReference refDepth = {
+        .attachment = 1,
+        .layout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+
+    const VkSubpassDescription subpass = {
+        .pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .colorAttachmentCount    = 1,
+        .pColorAttachments       = &refLit,
+        .pDepthStencilAttachment = &refDepth};
+
+    const VkSubpassDependency deps[] = {
+        {// the last composite of this image has finished reading it, and
+         // the prepass has written the depth
+         .srcSubpass      = VK_SUBPASS_EXTERNAL,
+         .dstSubpass      = 0,
+         .srcStageMask    = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+         .dstStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+         .srcAccessMask   = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+         .dstAccessMask   = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+         .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT},
+        {// the composite, or the caller, reads it afterwards
+         .srcSubpass    = 0,
+         .dstSubpass    = VK_SUBPASS_EXTERNAL,
+         .srcStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+         .dstStageMask  = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                          VK_PIPELINE_STAGE_TRANSFER_BIT,
+         .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+         .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT,
+         .dependencyFlags = 0}};
+
+    const uint32_t viewMask = (1u << r->viewCount) - 1;
+
+    const VkRenderPassMultiviewCreateInfo multiviewInfo = {
+        .sType                = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO,
+        .subpassCount         = 1,
+        .pViewMasks           = &viewMask,
+        .correlationMaskCount = 1,
+        .pCorrelationMasks    = &viewMask};
+
+    const VkRenderPassCreateInfo rpiInfo = {
+        .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .pNext           = r->viewCount > 1 ? &multiviewInfo : NULL,
+        .attachmentCount = LEN(attachments),
+        .pAttachments    = attachments,
+        .subpassCount    = 1,
+        .pSubpasses      = &subpass,
+        .dependencyCount = LEN(deps),
+        .pDependencies   = deps};
+
+    V_ASSERT(vkCreateRenderPass(r->device, &rpiInfo, NULL,
+                                &r->forwardRenderPass));
 }
 
 static void
-initGbufferFramebuffer(u32 w, u32 h)
+initGbufferFramebuffer(WoadRenderer* r, GBuffer* gbuf, u32 w, u32 h)
 {
-    const VkImageView attachments[] = {imageWorldP.view, imageNormal.view,
-                                       imageAlbedo.view, imageRoughness.view,
-                                       renderTargetDepth.view};
+    if (!r->visibilityBuffer)
+    {
+        const VkImageView depthView = graph_ImageView(&gbuf->graph,
+                                                      GRAPH_DEPTH);
+        const VkFramebufferCreateInfo depthInfo = {
+            .sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+            .renderPass      = shared.depthRenderPass[r->viewCount - 1],
+            .attachmentCount = 1,
+            .pAttachments    = &depthView,
+            .width           = w,
+            .height          = h,
+            .layers          = 1};
+
+        V_ASSERT(vkCreateFramebuffer(r->device, &depthInfo, NULL,
+                                     &gbuf->depthFramebuffer));
+    }
+    if (r->forward)
+        return;
+
+    const VkImageView attachments[] = {gbuf->worldP.view, gbuf->normal.view,
+                                       gbuf->albedo.view, gbuf->roughness.view,
+                                       graph_ImageView(&gbuf->graph,
+                                                       GRAPH_DEPTH)};
 
     const VkFramebufferCreateInfo fbi = {
         .sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
         .pNext           = NULL,
         .flags           = 0,
-        .renderPass      = gbufferRenderPass,
+        .renderPass      = shared.gbufferRenderPass[r->viewCount - 1],
         .attachmentCount = 5,
         .pAttachments    = attachments,
         .width           = w,
         .height          = h,
         .layers          = 1};
 
-    V_ASSERT(vkCreateFramebuffer(device, &fbi, NULL, &gframebuffer));
+    V_ASSERT(vkCreateFramebuffer(r->device, &fbi, NULL, &gbuf->framebuffer));
+    if (!r->visibilityBuffer)
+        return;
+
+    const VkImageView visibilityAttachments[] = {
+        graph_ImageView(&gbuf->graph, GRAPH_VISIBILITY),
+        graph_ImageView(&gbuf->graph, GRAPH_DEPTH)};
+
+    const VkFramebufferCreateInfo visibilityInfo = {
+        .sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .renderPass      = shared.visibilityRenderPass[r->viewCount - 1],
+        .attachmentCount = LEN(visibilityAttachments),
+        .pAttachments    = visibilityAttachments,
+        .width           = w,
+        .height          = h,
+        .layers          = 1};
+
+    V_ASSERT(vkCreateFramebuffer(r->device, &visibilityInfo, NULL,
+                                 &gbuf->visibilityFramebuffer));
 }
 
 static void
-initSwapFramebuffer(const WoadFrame* frame)
+initSwapFramebuffer(WoadRenderer* r, const WoadFrame* frame)
 {
     uint32_t                      windowWidth  = frame->width;
     uint32_t                      windowHeight = frame->height;
@@ -388,7 +1444,7 @@ initSwapFramebuffer(const WoadFrame* frame)
                  .sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
                  .pNext           = NULL,
                  .flags           = 0,
-                 .renderPass      = deferredRenderPass,
+                 .renderPass      = r->compositeRenderPass,
                  .attachmentCount = 1,
                  .pAttachments    = &frame->view,
                  .width           = windowWidth,
@@ -396,147 +1452,590 @@ initSwapFramebuffer(const WoadFrame* frame)
                  .layers          = 1,
     };
 
-    V_ASSERT(vkCreateFramebuffer(device, &fbi, NULL,
-                                 &swapImageBuffer[frame->index]));
+    V_ASSERT(vkCreateFramebuffer(r->device, &fbi, NULL,
+                                 &r->swapImageBuffer[frame->index]));
+}
+
+// the swapchain format if compute shading can store to it, otherwise one
+// every device can
+static VkFormat
+storableFormat(const WoadRenderer* r, VkFormat format)
+{
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(r->instance->physical_device, format,
+                                        &props);
+    if (props.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT)
+        return format;
+    return VK_FORMAT_R16G16B16A16_SFLOAT;
+}
+
+// the lit image of one frame slot. it is only ever partly redrawn, so it
+// starts out cleared to the background and in the layout the deferred pass
+// expects. records the setup into cmdbuf.
+static void
+initLitImage(WoadRenderer* r, VkCommandBuffer cmdbuf, uint32_t frameIndex,
+             uint32_t w, uint32_t h)
+{
+    LayeredImage* lit = &r->litImages[frameIndex];
+    const VkImageUsageFlags shadeUsage =
+        r->computeShading ? VK_IMAGE_USAGE_STORAGE_BIT
+                          : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    *lit = acquireImage(
+        r, w, h, r->litFormat,
+        shadeUsage | VK_IMAGE_USAGE_SAMPLED_BIT |
+            VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT);
+
+    const VkImageSubresourceRange allLayers = {
+        VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, VK_REMAINING_ARRAY_LAYERS};
+    cmdTransitionLayers(cmdbuf, lit->handle, VK_IMAGE_LAYOUT_UNDEFINED,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    vkCmdClearColorImage(cmdbuf, lit->handle,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &litBackground,
+                         1, &allLayers);
+    cmdTransitionLayers(cmdbuf, lit->handle,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, r->litLayout);
+}
+
+// the framebuffer the deferred or forward pass draws a slot's lit image
+// through. the forward pass also tests against the slot's depth, so this
+// is remade whenever the slot's gbuffer is.
+static void
+initLitFramebuffer(WoadRenderer* r, uint32_t frameIndex)
+{
+    const LayeredImage* lit = &r->litImages[frameIndex];
+    const VkImageView   attachments[] = {
+        lit->view,
+        r->forward
+            ? graph_ImageView(&frameGbuffer(r, frameIndex)->graph, GRAPH_DEPTH)
+            : VK_NULL_HANDLE};
+
+    const VkFramebufferCreateInfo fbi = {
+        .sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .renderPass      = r->forward ? r->forwardRenderPass
+                                      : r->deferredRenderPass,
+        .attachmentCount = r->forward ? 2 : 1,
+        .pAttachments    = attachments,
+        .width           = lit->width,
+        .height          = lit->height,
+        .layers          = 1};
+
+    V_ASSERT(vkCreateFramebuffer(r->device, &fbi, NULL,
+                                 &r->litBuffers[frameIndex]));
+}
+
+// same as onyx_create_descriptor_set_layout, but sets up the layout so the
+// texture array and material table can be written while the set is in use.
+static void
+createUpdateAfterBindSetLayout(uint32_t count, const OnyxDescriptor* descriptors,
+                               VkDescriptorSetLayout* layout)
+{
+    VkDescriptorSetLayoutBinding bindings[8];
+    VkDescriptorBindingFlags     flags[8];
+    assert(count <= LEN(bindings));
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        bindings[i] = (VkDescriptorSetLayoutBinding){
+            .binding         = i,
+            .descriptorType  = descriptors[i].type,
+            .descriptorCount = descriptors[i].count,
+            .stageFlags      = descriptors[i].stages};
+        flags[i] = descriptors[i].binding_flags;
+    }
+
+    const VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo = {
+        .sType =
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .bindingCount  = count,
+        .pBindingFlags = flags};
+
+    const VkDescriptorSetLayoutCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = &flagsInfo,
+        .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+        .bindingCount = count,
+        .pBindings    = bindings};
+
+    V_ASSERT(vkCreateDescriptorSetLayout(shared.device, &info, NULL, layout));
 }
 
 static void
-initDescriptorSetsAndPipelineLayouts(void)
+initSharedLayouts(void)
 {
+    // the visibility resolve evaluates materials in place of the gbuffer
+    // fragment shaders, from vertices the vertex shaders would pull
+    const VkShaderStageFlags vertex =
+        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+    const VkShaderStageFlags material =
+        VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
     OnyxDescriptor bindings0[] = {
         {// camera
          .count = 1,
          .type            = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-         .stages =
-             VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT},
-        {// xforms
-         .count = 1,
-         .type            = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-         .stages      = VK_SHADER_STAGE_VERTEX_BIT},
+         .stages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT |
+                   VK_SHADER_STAGE_COMPUTE_BIT},
+        {// draw instances
+         .count = 1, // runtime sized array in a storage buffer
+         .type            = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .stages      = vertex,
+         .binding_flags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT},
         {// lights
          .count = 1,
          .type            = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-         .stages =
-             VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR},
+         .stages = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT |
+                   VK_SHADER_STAGE_RAYGEN_BIT_KHR},
         {                       // textures
-         .count = 10, // because this is an array of samplers. others
-                                // are structs of arrays.
+         .count = MAX_TEXTURE_COUNT, // because this is an array of samplers.
+                                     // others are structs of arrays.
          .type            = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-         .stages      = VK_SHADER_STAGE_FRAGMENT_BIT,
-         .binding_flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT},
+         .stages      = material,
+         .binding_flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                          VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT},
         {
             // materials
-            .count = 1, // because this is an array of samplers.
-                                  // others are structs of arrays.
-            .type            = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            .stages      = VK_SHADER_STAGE_FRAGMENT_BIT,
-        }};
+            .count = 1, // runtime sized array in a storage buffer
+            .type            = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .stages      = material,
+            .binding_flags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,
+        },
+        {// geometry blocks, read by the packed vertex shaders and the resolve
+         .count = MAX_GEOMETRY_BLOCKS,
+         .type            = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .stages      = vertex,
+         .binding_flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                          VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT},
+        {// texture streaming feedback, written by the gbuffer pass or the
+         // resolve
+         .count = 1,
+         .type            = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .stages      = material,
+         .binding_flags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT},
+        {// the readback ring buffer an nv12 conversion writes, pointed at
+         // the frame's entry as it is recorded
+         .count = 1,
+         .type            = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .stages      = VK_SHADER_STAGE_COMPUTE_BIT,
+         .binding_flags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT}};
+
+    // the gbuffer is read by whichever of the fragment and compute shading
+    // paths the renderer uses
+    const VkShaderStageFlags shading =
+        VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
 
     OnyxDescriptor bindings1[] = {
         {
             // worldp storage image
             .count = 1,
             .type            = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-            .stages =
-                VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR,
+            .stages = shading | VK_SHADER_STAGE_RAYGEN_BIT_KHR,
         },
         {
             // normal storage image
             .count = 1,
             .type            = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-            .stages =
-                VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR,
+            .stages = shading | VK_SHADER_STAGE_RAYGEN_BIT_KHR,
         },
         {// albedo storage image
          .count = 1,
          .type            = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-         .stages      = VK_SHADER_STAGE_FRAGMENT_BIT},
+         .stages      = shading},
         {
             // shadow storage image
             .count = 1,
             .type            = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-            .stages =
-                VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR,
+            .stages = shading | VK_SHADER_STAGE_RAYGEN_BIT_KHR,
         },
         {// roughness storage image
          .count = 1,
          .type            = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-         .stages      = VK_SHADER_STAGE_FRAGMENT_BIT},
+         .stages      = shading},
         {
-            // top level AS
+            // top level AS, also traced by the forward shaders' ray queries
             .count = 1,
             .type            = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR,
-            .stages      = VK_SHADER_STAGE_RAYGEN_BIT_KHR,
-        }};
-
-    onyx_create_descriptor_set_layout(device, LEN(bindings0),
-                                      bindings0, &descriptorSetLayouts[0]);
-
-    onyx_create_descriptor_set_layout(device, LEN(bindings1),
-                                      bindings1, &descriptorSetLayouts[1]);
-
-    OnyxDescriptorPoolParms pool_parms = {
-        .accelerationStructureCount = 20,
-        .combinedImageSamplerCount = 24,
-        .storageImageCount = 20,
-        .dynamicUniformBufferCount = 10,
-        .storageImageCount = 20,
-        .uniformBufferCount = 20,
-        .inputAttachmentCount = 0,
-    };
-
-    onyx_create_descriptor_pool(device, pool_parms, &descriptorPool);
+            .stages      = VK_SHADER_STAGE_RAYGEN_BIT_KHR |
+                           VK_SHADER_STAGE_FRAGMENT_BIT,
+        },
+        {// lit image, read by the composite pass and the readback conversion
+         .count = 1,
+         .type            = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+         .stages      = VK_SHADER_STAGE_FRAGMENT_BIT |
+                        VK_SHADER_STAGE_COMPUTE_BIT},
+        {// lit image, written by the compute shading pass
+         .count = 1,
+         .type            = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+         .stages      = VK_SHADER_STAGE_COMPUTE_BIT},
+        {// visibility buffer, read by the resolve
+         .count = 1,
+         .type            = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+         .stages      = VK_SHADER_STAGE_COMPUTE_BIT},
+        {// the forward mode's lights per tile, written by the light culling
+         .count = 1,
+         .type            = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+         .stages      = VK_SHADER_STAGE_COMPUTE_BIT |
+                        VK_SHADER_STAGE_FRAGMENT_BIT},
+        {// depth, read by the light culling
+         .count = 1,
+         .type            = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+         .stages      = VK_SHADER_STAGE_COMPUTE_BIT}};
 
-    onyx_allocate_descriptor_sets(device, descriptorPool, DESC_SET_COUNT, descriptorSetLayouts, descriptorSets[0]);
-    onyx_allocate_descriptor_sets(device, descriptorPool, DESC_SET_COUNT, descriptorSetLayouts, descriptorSets[1]);
+    createUpdateAfterBindSetLayout(LEN(bindings0), bindings0,
+                                   &shared.descriptorSetLayouts[0]);
 
-    const VkPushConstantRange pcPrimId = {
-        .offset = 0,
-        .size   = sizeof(Mat4) + sizeof(uint32_t) * 2, // prim id, material id
-        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT};
+    onyx_create_descriptor_set_layout(shared.device, LEN(bindings1), bindings1,
+                                      &shared.descriptorSetLayouts[1]);
 
-    // light count
+    // light count, then the origin and, for compute shading and the
+    // visibility resolve, the size of the region being shaded, then for the
+    // resolve the viewport. the vertex stage reads everything it needs from
+    // the instance table.
     const VkPushConstantRange pcFrag = {
-        .offset = sizeof(Mat4) + sizeof(uint32_t) * 2, // prim id, material id
-        .size   = sizeof(uint32_t),
-        .stageFlags =
-            VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR};
+        .offset     = 0,
+        .size       = sizeof(uint32_t) * 10,
+        .stageFlags = pushStages};
 
-    const VkPushConstantRange ranges[] = {pcPrimId, pcFrag};
+    const VkPushConstantRange ranges[] = {pcFrag};
 
     const OnyxPipelineLayoutInfo pipeLayoutInfos[] = {
         {.descriptor_set_count = DESC_SET_COUNT,
-         .descriptor_set_layouts = descriptorSetLayouts,
+         .descriptor_set_layouts = shared.descriptorSetLayouts,
          .push_constant_count = LEN(ranges),
          .push_constant_ranges = ranges}};
 
-    onyx_create_pipeline_layouts(device, 1, pipeLayoutInfos, &pipelineLayout);
+    onyx_create_pipeline_layouts(shared.device, 1, pipeLayoutInfos,
+                                 &shared.pipelineLayout);
 }
 
 static void
-initPipelines(bool openglStyle)
+initDescriptorSets(WoadRenderer* r)
 {
-    const OnyxGeoAttributeSize posAttrSizes[]          = {12};
-    const OnyxGeoAttributeSize posNormalUvAttrSizes[3] = {12, 12, 8};
-    const OnyxGeoAttributeSize tanAttrSizes[5] = {12, 12, 12, 4, 8};
+    // onyx pools can't allocate update-after-bind sets, so we make our own
+    const VkDescriptorPoolSize poolSizes[] = {
+        {VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 20},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+         (MAX_TEXTURE_COUNT + 1) * MAX_FRAMES_IN_FLIGHT},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 8 * MAX_FRAMES_IN_FLIGHT},
+        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, MAX_FRAMES_IN_FLIGHT},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         (4 + MAX_GEOMETRY_BLOCKS) * MAX_FRAMES_IN_FLIGHT},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 20},
+    };
 
-    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT,
-                                      VK_DYNAMIC_STATE_SCISSOR};
+    const VkDescriptorPoolCreateInfo poolInfo = {
+        .sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags         = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+        .maxSets       = DESC_SET_COUNT * MAX_FRAMES_IN_FLIGHT,
+        .poolSizeCount = LEN(poolSizes),
+        .pPoolSizes    = poolSizes};
 
-    VkSpecializationMapEntry mapEntry = {
-        .constantID = 0, .offset = 0, .size = 4};
+    V_ASSERT(vkCreateDescriptorPool(r->device, &poolInfo, NULL, &r->descriptorPool));
 
-    int sign = openglStyle ? -1 : 1;
+    for (int i = 0; i < r->framesInFlight; i++)
+        onyx_allocate_descriptor_sets(r->device, r->descriptorPool, DESC_SET_COUNT,
+                                      shared.descriptorSetLayouts, r->descriptorSets[i]);
+}
 
-    VkSpecializationInfo fragSpecInfo = {.dataSize      = 4,
-                                         .mapEntryCount = 1,
-                                         .pData         = &sign,
-                                         .pMapEntries   = &mapEntry};
+// the composite pipeline used with dynamic rendering. OnyxGraphicsPipelineInfo
+// has no pNext to carry the attachment format, so it is built here directly.
+static void
+initRenderingPipeline(WoadRenderer* r, const OnyxShaderInfo* shaders,
+                      uint32_t shaderCount, VkFormat format,
+                      VkPipeline* pipeline)
+{
+    VkShaderModule                  modules[2];
+    VkPipelineShaderStageCreateInfo stages[2];
+    assert(shaderCount <= LEN(stages));
+    for (uint32_t i = 0; i < shaderCount; i++)
+    {
+        const VkShaderModuleCreateInfo moduleInfo = {
+            .sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+            .codeSize = shaders[i].byte_count,
+            .pCode    = shaders[i].code};
+        V_ASSERT(vkCreateShaderModule(r->device, &moduleInfo, NULL,
+                                      &modules[i]));
+        stages[i] = (VkPipelineShaderStageCreateInfo){
+            .sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage  = shaders[i].stage,
+            .module = modules[i],
+            .pName  = shaders[i].entry_point,
+            .pSpecializationInfo = shaders[i].spec_info};
+    }
 
-    VkFrontFace frontface = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    const VkPipelineVertexInputStateCreateInfo vertexInput = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+    const VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
+        .sType    = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST};
+    const VkPipelineViewportStateCreateInfo viewport = {
+        .sType         = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .scissorCount  = 1};
+    const VkPipelineRasterizationStateCreateInfo raster = {
+        .sType       = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .cullMode    = VK_CULL_MODE_NONE,
+        .frontFace   = VK_FRONT_FACE_CLOCKWISE,
+        .lineWidth   = 1.0};
+    const VkPipelineMultisampleStateCreateInfo multisample = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT};
+    const VkPipelineColorBlendAttachmentState noBlend = {
+        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                          VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT};
+    const VkPipelineColorBlendStateCreateInfo blend = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .attachmentCount = 1,
+        .pAttachments    = &noBlend};
+    const VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT,
+                                            VK_DYNAMIC_STATE_SCISSOR};
+    const VkPipelineDynamicStateCreateInfo dynamic = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = LEN(dynamicStates),
+        .pDynamicStates    = dynamicStates};
+    const VkPipelineRenderingCreateInfo rendering = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+        .colorAttachmentCount    = 1,
+        .pColorAttachmentFormats = &format};
+
+    const VkGraphicsPipelineCreateInfo info = {
+        .sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .pNext               = &rendering,
+        .stageCount          = shaderCount,
+        .pStages             = stages,
+        .pVertexInputState   = &vertexInput,
+        .pInputAssemblyState = &inputAssembly,
+        .pViewportState      = &viewport,
+        .pRasterizationState = &raster,
+        .pMultisampleState   = &multisample,
+        .pColorBlendState    = &blend,
+        .pDynamicState       = &dynamic,
+        .layout              = shared.pipelineLayout,
+        .basePipelineIndex   = -1};
+    V_ASSERT(vkCreateGraphicsPipelines(r->device, VK_NULL_HANDLE, 1, &info,
+                                       NULL, pipeline));
+
+    for (uint32_t i = 0; i < shaderCount; i++)
+        vkDestroyShaderModule(r->device, modules[i], NULL);
+}
 
-    OnyxVertexDescription tangent_vert_description = {
-        .attribute_count = 5,
+static bool
+pipelinePacked(int pipeId)
+{
+    return pipeId == PIPELINE_GBUFFER_PACKED_NOR_UV ||
+           pipeId == PIPELINE_GBUFFER_PACKED_NOR_UV_TAN;
+}
+
+// the vertex streams the float buckets read. the packed buckets pull their
+// vertices from the geometry blocks.
+static const VkVertexInputBindingDescription regularBindings[] = {
+    {.binding = 0, .stride = 12, .inputRate = VK_VERTEX_INPUT_RATE_VERTEX},
+    {.binding = 1, .stride = 12, .inputRate = VK_VERTEX_INPUT_RATE_VERTEX},
+    {.binding = 2, .stride = 8, .inputRate = VK_VERTEX_INPUT_RATE_VERTEX}};
+static const VkVertexInputAttributeDescription regularAttributes[] = {
+    {.binding = 0, .format = VK_FORMAT_R32G32B32_SFLOAT, .location = 0},
+    {.binding = 1, .format = VK_FORMAT_R32G32B32_SFLOAT, .location = 1},
+    {.binding = 2, .format = VK_FORMAT_R32G32_SFLOAT, .location = 2}};
+static const VkVertexInputBindingDescription tangentBindings[] = {
+    {.binding = 0, .stride = 12, .inputRate = VK_VERTEX_INPUT_RATE_VERTEX},
+    {.binding = 1, .stride = 12, .inputRate = VK_VERTEX_INPUT_RATE_VERTEX},
+    {.binding = 2, .stride = 12, .inputRate = VK_VERTEX_INPUT_RATE_VERTEX},
+    {.binding = 3, .stride = 4, .inputRate = VK_VERTEX_INPUT_RATE_VERTEX},
+    {.binding = 4, .stride = 8, .inputRate = VK_VERTEX_INPUT_RATE_VERTEX}};
+static const VkVertexInputAttributeDescription tangentAttributes[] = {
+    {.binding = 0, .format = VK_FORMAT_R32G32B32_SFLOAT, .location = 0},
+    {.binding = 1, .format = VK_FORMAT_R32G32B32_SFLOAT, .location = 1},
+    {.binding = 2, .format = VK_FORMAT_R32G32B32_SFLOAT, .location = 2},
+    {.binding = 3, .format = VK_FORMAT_R32_SFLOAT, .location = 3},
+    {.binding = 4, .format = VK_FORMAT_R32G32_SFLOAT, .location = 4}};
+
+static const OnyxPipelineColorBlendAttachment noBlends[4] = {
+    {.blend_enable = false, .blend_mode = ONYX_BLEND_MODE_OVER},
+    {.blend_enable = false, .blend_mode = ONYX_BLEND_MODE_OVER},
+    {.blend_enable = false, .blend_mode = ONYX_BLEND_MODE_OVER},
+    {.blend_enable = false, .blend_mode = ONYX_BLEND_MODE_OVER}};
+
+static const VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT,
+                                               VK_DYNAMIC_STATE_SCISSOR};
+// draws after a depth prepass test for EQUAL, which onyx's pipeline info
+// can't give, so only those pipelines need extendedDynamicState
+static const VkDynamicState prepassedDynamicStates[] = {
+    VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR,
+    VK_DYNAMIC_STATE_DEPTH_COMPARE_OP};
+
+// must hold the shared lock
+static void
+loadPermutedShaders(void)
+{
+    static const char* const paths[PERMUTED_SHADER_COUNT] = {
+        [SHADER_REGULAR_VERT]     = WOAD_SPV_PREFIX "/regular.vert.spv",
+        [SHADER_TANGENT_VERT]     = WOAD_SPV_PREFIX "/tangent.vert.spv",
+        [SHADER_POS_VERT]         = WOAD_SPV_PREFIX "/pos.vert.spv",
+        [SHADER_PACKED_VERT]      = WOAD_SPV_PREFIX "/packed.vert.spv",
+        [SHADER_PACKED_TAN_VERT]  = WOAD_SPV_PREFIX "/packedtan.vert.spv",
+        [SHADER_GBUFFER_FRAG]     = WOAD_SPV_PREFIX "/gbuffer.frag.spv",
+        [SHADER_GBUFFER_TAN_FRAG] = WOAD_SPV_PREFIX "/gbuffertan.frag.spv",
+        [SHADER_GBUFFER_POS_FRAG] = WOAD_SPV_PREFIX "/gbufferpos.frag.spv",
+        [SHADER_FULL_SCREEN_VERT] = ONYX_SPV_PREFIX "/full-screen.vert.spv",
+        [SHADER_DEFERRED_FRAG]    = WOAD_SPV_PREFIX "/deferred.frag.spv",
+        [SHADER_DEFERRED_COMP]    = WOAD_SPV_PREFIX "/deferred.comp.spv"};
+    if (shared.permutedShaders[0].count > 0)
+        return;
+    int err = 0;
+    for (int i = 0; i < PERMUTED_SHADER_COUNT; i++)
+        err |= hell_read_file(paths[i], &shared.permutedShaders[i]);
+    if (err)
+        fatal_error("Error reading spv files.");
+}
+
+static OnyxShaderInfo
+permutedStage(int shader, VkShaderStageFlags stage,
+              const VkSpecializationInfo* spec)
+{
+    return (OnyxShaderInfo){
+        .byte_count  = shared.permutedShaders[shader].count,
+        .code        = (void*)shared.permutedShaders[shader].elems,
+        .stage       = stage,
+        .entry_point = "main",
+        .spec_info   = spec};
+}
+
+// a bucket's gbuffer pipeline for viewCount views, with its fragment
+// shader specialized by spec unless it is NULL. prepassed ones keep the
+// depth a prepass wrote. stages is filled in and must outlive the info.
+static OnyxGraphicsPipelineInfo
+gbufferPipelineInfo(int pipeId, uint8_t viewCount, bool prepassed,
+                    const VkSpecializationInfo* spec, OnyxShaderInfo stages[2])
+{
+    static const int vertShaders[GBUFFER_PIPELINE_COUNT] = {
+        SHADER_REGULAR_VERT, SHADER_TANGENT_VERT, SHADER_POS_VERT,
+        SHADER_PACKED_VERT, SHADER_PACKED_TAN_VERT};
+    static const int fragShaders[GBUFFER_PIPELINE_COUNT] = {
+        SHADER_GBUFFER_FRAG, SHADER_GBUFFER_TAN_FRAG, SHADER_GBUFFER_POS_FRAG,
+        SHADER_GBUFFER_FRAG, SHADER_GBUFFER_TAN_FRAG};
+    stages[0] = permutedStage(vertShaders[pipeId], VK_SHADER_STAGE_VERTEX_BIT,
+                              NULL);
+    stages[1] = permutedStage(fragShaders[pipeId],
+                              VK_SHADER_STAGE_FRAGMENT_BIT, spec);
+
+    OnyxGraphicsPipelineInfo info = {
+        .render_pass           = shared.gbufferRenderPass[viewCount - 1],
+        .topology              = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .layout                = shared.pipelineLayout,
+        .rasterization_samples = VK_SAMPLE_COUNT_1_BIT,
+        .front_face            = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+        .attachment_count      = 4,
+        .attachment_blends     = noBlends,
+        .line_width            = 1.0,
+        .depth_test_enable     = true,
+        .depth_write_enable    = !prepassed,
+        .dynamic_state_count   = prepassed ? LEN(prepassedDynamicStates)
+                                           : LEN(dynamicStates),
+        .dynamic_states = prepassed ? prepassedDynamicStates : dynamicStates,
+        .shader_stage_count    = 2,
+        .shader_stages         = stages};
+    if (pipelinePacked(pipeId))
+        return info;
+    if (pipeId == PIPELINE_GBUFFER_POS_NOR_UV_TAN)
+    {
+        info.vertex_binding_description_count   = LEN(tangentBindings);
+        info.vertex_binding_descriptions        = tangentBindings;
+        info.vertex_attribute_description_count = LEN(tangentAttributes);
+        info.vertex_attribute_descriptions      = tangentAttributes;
+    }
+    else
+    {
+        info.vertex_binding_description_count   = LEN(regularBindings);
+        info.vertex_binding_descriptions        = regularBindings;
+        info.vertex_attribute_description_count = LEN(regularAttributes);
+        info.vertex_attribute_descriptions      = regularAttributes;
+    }
+    return info;
+}
+
+// the full screen deferred pipeline, specialized like the one above
+static OnyxGraphicsPipelineInfo
+deferredPipelineInfo(const WoadRenderer* r, const VkSpecializationInfo* spec,
+                     OnyxShaderInfo stages[2])
+{
+    stages[0] = permutedStage(SHADER_FULL_SCREEN_VERT,
+                              VK_SHADER_STAGE_VERTEX_BIT, NULL);
+    stages[1] = permutedStage(SHADER_DEFERRED_FRAG,
+                              VK_SHADER_STAGE_FRAGMENT_BIT, spec);
+    return (OnyxGraphicsPipelineInfo){
+        .render_pass           = r->deferredRenderPass,
+        .topology              = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .layout                = shared.pipelineLayout,
+        .rasterization_samples = VK_SAMPLE_COUNT_1_BIT,
+        .front_face            = VK_FRONT_FACE_CLOCKWISE,
+        .attachment_count      = 1,
+        .attachment_blends     = noBlends,
+        .dynamic_state_count   = LEN(dynamicStates),
+        .dynamic_states        = dynamicStates,
+        .shader_stage_count    = 2,
+        .shader_stages         = stages,
+        .line_width            = 1.0};
+}
+
+// the compute shading and resolve pipelines. onyx only makes graphics and
+// ray trace ones.
+static void
+initComputePipeline(WoadRenderer* r, const OnyxShaderInfo* shader,
+                    VkPipeline* pipeline)
+{
+    const VkShaderModuleCreateInfo moduleInfo = {
+        .sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize = shader->byte_count,
+        .pCode    = shader->code};
+    VkShaderModule module;
+    V_ASSERT(vkCreateShaderModule(r->device, &moduleInfo, NULL, &module));
+
+    const VkComputePipelineCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = {.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                  .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+                  .module = module,
+                  .pName  = shader->entry_point,
+                  .pSpecializationInfo = shader->spec_info},
+        .layout            = shared.pipelineLayout,
+        .basePipelineIndex = -1};
+    V_ASSERT(vkCreateComputePipelines(r->device, VK_NULL_HANDLE, 1, &info,
+                                      NULL, pipeline));
+
+    vkDestroyShaderModule(r->device, module, NULL);
+}
+
+// the maps a gbuffer shader may sample. must match material.glsl.
+enum {
+    ALBEDO_MAP    = 1 << 0,
+    ROUGHNESS_MAP = 1 << 1,
+    NORMAL_MAP    = 1 << 2,
+};
+
+// the gbuffer and ray trace pipelines are shared, so they are only made by
+// the first renderer that needs them. must hold the shared lock.
+static void
+initPipelines(WoadRenderer* r, VkFormat swapFormat, bool openglStyle)
+{
+    const OnyxGeoAttributeSize posAttrSizes[] = {12};
+
+    VkSpecializationMapEntry mapEntry = {
+        .constantID = 0, .offset = 0, .size = 4};
+
+    int sign = openglStyle ? -1 : 1;
+
+    VkSpecializationInfo fragSpecInfo = {.dataSize      = 4,
+                                         .mapEntryCount = 1,
+                                         .pData         = &sign,
+                                         .pMapEntries   = &mapEntry};
+
+    VkFrontFace frontface = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    VkPipeline* gbufferPipelines = shared.gbufferPipelines[r->viewCount - 1];
+
+    OnyxVertexDescription tangent_vert_description = {
+        .attribute_count = 5,
         .attribute_descriptions = {
             // pos
             { .location = 0, .binding = 0, .format = ONYX_VERT_POS_FORMAT, .offset = 0 },
@@ -559,194 +2058,111 @@ initPipelines(bool openglStyle)
         }
     };
 
-    VkVertexInputBindingDescription b[] = {
-        { .binding = 0, .stride = posNormalUvAttrSizes[0], .inputRate = VK_VERTEX_INPUT_RATE_VERTEX },
-        { .binding = 1, .stride = posNormalUvAttrSizes[1], .inputRate = VK_VERTEX_INPUT_RATE_VERTEX },
-        { .binding = 2, .stride = posNormalUvAttrSizes[2], .inputRate = VK_VERTEX_INPUT_RATE_VERTEX },
-    };
-
-    VkVertexInputAttributeDescription a[] = {
-        { .binding = 0, .format = VK_FORMAT_R32G32B32_SFLOAT, .location = 0, .offset = 0 },
-        { .binding = 1, .format = VK_FORMAT_R32G32B32_SFLOAT, .location = 1, .offset = 0 },
-        { .binding = 2, .format = VK_FORMAT_R32G32_SFLOAT, .location = 2, .offset = 0 },
-    };
-
-    VkVertexInputBindingDescription tan_b[] = {
-        { .binding = 0, .stride = tanAttrSizes[0], .inputRate = VK_VERTEX_INPUT_RATE_VERTEX },
-        { .binding = 1, .stride = tanAttrSizes[1], .inputRate = VK_VERTEX_INPUT_RATE_VERTEX },
-        { .binding = 2, .stride = tanAttrSizes[2], .inputRate = VK_VERTEX_INPUT_RATE_VERTEX },
-        { .binding = 3, .stride = tanAttrSizes[3], .inputRate = VK_VERTEX_INPUT_RATE_VERTEX },
-        { .binding = 4, .stride = tanAttrSizes[4], .inputRate = VK_VERTEX_INPUT_RATE_VERTEX },
-    };
-
-    VkVertexInputAttributeDescription tan_a[] = {
-        { .binding = 0, .format = VK_FORMAT_R32G32B32_SFLOAT, .location = 0, .offset = 0 },
-        { .binding = 1, .format = VK_FORMAT_R32G32B32_SFLOAT, .location = 1, .offset = 0 },
-        { .binding = 2, .format = VK_FORMAT_R32G32B32_SFLOAT, .location = 2, .offset = 0 },
-        { .binding = 3, .format = VK_FORMAT_R32_SFLOAT, .location = 3, .offset = 0 },
-        { .binding = 4, .format = VK_FORMAT_R32G32_SFLOAT, .location = 4, .offset = 0 },
-    };
-
-
     int       err = 0;
-    ByteArray reg_vert_code, gbuffer_frag_code, tan_vert_code,
-        tan_gbuffer_frag_code, pos_vert_code, gbuffer_pos_code, full_screen_vert_code, deferred_code;
-
-    err |= hell_read_file(WOAD_SPV_PREFIX "/regular.vert.spv", &reg_vert_code);
-    err |= hell_read_file(WOAD_SPV_PREFIX "/gbuffer.frag.spv", &gbuffer_frag_code);
-    err |= hell_read_file(WOAD_SPV_PREFIX "/tangent.vert.spv", &tan_vert_code);
-    err |= hell_read_file(WOAD_SPV_PREFIX "/gbuffertan.frag.spv", &tan_gbuffer_frag_code);
-    err |= hell_read_file(WOAD_SPV_PREFIX "/pos.vert.spv", &pos_vert_code);
-    err |= hell_read_file(WOAD_SPV_PREFIX "/gbufferpos.frag.spv", &gbuffer_pos_code);
-    err |= hell_read_file(ONYX_SPV_PREFIX "/full-screen.vert.spv", &full_screen_vert_code);
-    err |= hell_read_file(WOAD_SPV_PREFIX "/deferred.frag.spv", &deferred_code);
+    ByteArray composite_code, visibility_vert_code, visibility_frag_code,
+        resolve_code, packed_pos_vert_code, forward_code, forward_tan_code,
+        forward_pos_code, light_cull_code;
+
+    loadPermutedShaders();
+    err |= hell_read_file(WOAD_SPV_PREFIX "/composite.frag.spv", &composite_code);
+    err |= hell_read_file(WOAD_SPV_PREFIX "/visibility.vert.spv", &visibility_vert_code);
+    err |= hell_read_file(WOAD_SPV_PREFIX "/visibility.frag.spv", &visibility_frag_code);
+    err |= hell_read_file(WOAD_SPV_PREFIX "/resolve.comp.spv", &resolve_code);
+    err |= hell_read_file(WOAD_SPV_PREFIX "/packedpos.vert.spv", &packed_pos_vert_code);
+    // the forward shaders trace their shadows when ray tracing is on
+    const bool rq = !r->raytracing_disabled;
+    err |= hell_read_file(rq ? WOAD_SPV_PREFIX "/forward-rq.frag.spv" : WOAD_SPV_PREFIX "/forward.frag.spv", &forward_code);
+    err |= hell_read_file(rq ? WOAD_SPV_PREFIX "/forwardtan-rq.frag.spv" : WOAD_SPV_PREFIX "/forwardtan.frag.spv", &forward_tan_code);
+    err |= hell_read_file(rq ? WOAD_SPV_PREFIX "/forwardpos-rq.frag.spv" : WOAD_SPV_PREFIX "/forwardpos.frag.spv", &forward_pos_code);
+    err |= hell_read_file(WOAD_SPV_PREFIX "/lightcull.comp.spv", &light_cull_code);
 
     if (err)
         fatal_error("Error reading spv files.");
 
-    OnyxShaderInfo shader_stages_reg[] = {
+    OnyxShaderInfo shader_stages_visibility[] = {
          {
-            .byte_count = reg_vert_code.count,
-            .code = (void*)reg_vert_code.elems,
+            .byte_count = visibility_vert_code.count,
+            .code =(void*) visibility_vert_code.elems,
             .stage = VK_SHADER_STAGE_VERTEX_BIT,
             .entry_point = "main",
         },{
-            .byte_count = gbuffer_frag_code.count,
-            .code =(void*) gbuffer_frag_code.elems,
+            .byte_count = visibility_frag_code.count,
+            .code =(void*) visibility_frag_code.elems,
             .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
             .entry_point = "main",
     }};
 
-    OnyxShaderInfo shader_stages_tan[] = {
-         {
-            .byte_count = tan_vert_code.count,
-            .code =(void*) tan_vert_code.elems,
-            .stage = VK_SHADER_STAGE_VERTEX_BIT,
-            .entry_point = "main",
-        },{
-            .byte_count = tan_gbuffer_frag_code.count,
-            .code =(void*) tan_gbuffer_frag_code.elems,
-            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-            .entry_point = "main",
-    }};
+    const OnyxShaderInfo shader_stage_resolve = {
+        .byte_count  = resolve_code.count,
+        .code        = (void*)resolve_code.elems,
+        .stage       = VK_SHADER_STAGE_COMPUTE_BIT,
+        .entry_point = "main"};
 
-    OnyxShaderInfo shader_stages_pos[] = {
-         {
-            .byte_count = pos_vert_code.count,
-            .code =(void*) pos_vert_code.elems,
-            .stage = VK_SHADER_STAGE_VERTEX_BIT,
-            .entry_point = "main",
-        },{
-            .byte_count = gbuffer_pos_code.count,
-            .code =(void*) gbuffer_pos_code.elems,
-            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-            .entry_point = "main",
-    }};
+    const OnyxShaderInfo shader_stage_light_cull = {
+        .byte_count  = light_cull_code.count,
+        .code        = (void*)light_cull_code.elems,
+        .stage       = VK_SHADER_STAGE_COMPUTE_BIT,
+        .entry_point = "main"};
 
-    OnyxShaderInfo shader_stages_deferred[] = {
-         {
-            .byte_count = full_screen_vert_code.count,
-            .code =(void*) full_screen_vert_code.elems,
-            .stage = VK_SHADER_STAGE_VERTEX_BIT,
-            .entry_point = "main",
-        },{
-            .byte_count = deferred_code.count,
-            .code =(void*) deferred_code.elems,
+    const OnyxShaderInfo shader_stage_shade = permutedStage(
+        SHADER_DEFERRED_COMP, VK_SHADER_STAGE_COMPUTE_BIT, NULL);
+
+    OnyxShaderInfo shader_stages_composite[] = {
+        permutedStage(SHADER_FULL_SCREEN_VERT, VK_SHADER_STAGE_VERTEX_BIT,
+                      NULL),
+        {
+            .byte_count = composite_code.count,
+            .code =(void*) composite_code.elems,
             .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
             .entry_point = "main",
     }};
 
-    OnyxPipelineColorBlendAttachment no_blend = {
-        .blend_enable = false,
-        .blend_mode = ONYX_BLEND_MODE_OVER,
+    OnyxGraphicsPipelineInfo gPipelineInfos[GBUFFER_PIPELINE_COUNT];
+    OnyxShaderInfo           gbufferStages[GBUFFER_PIPELINE_COUNT][2];
+    for (int i = 0; i < GBUFFER_PIPELINE_COUNT; i++)
+        gPipelineInfos[i] =
+            gbufferPipelineInfo(i, r->viewCount, false, NULL,
+                                gbufferStages[i]);
+
+    const OnyxGraphicsPipelineInfo visibilityPipeInfo = {
+        .render_pass           = shared.visibilityRenderPass[r->viewCount - 1],
+        .topology              = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .layout                = shared.pipelineLayout,
+        .rasterization_samples = VK_SAMPLE_COUNT_1_BIT,
+        .line_width            = 1.0,
+        .depth_test_enable     = true,
+        .depth_write_enable    = true,
+        .front_face            = frontface,
+        .attachment_count      = 1,
+        .attachment_blends     = noBlends,
+        .dynamic_state_count   = LEN(dynamicStates),
+        .dynamic_states        = dynamicStates,
+        // positions are pulled from the geometry blocks
+        .shader_stage_count    = LEN(shader_stages_visibility),
+        .shader_stages         = shader_stages_visibility,
     };
 
-    OnyxPipelineColorBlendAttachment attachment_blends[4] = {
-        no_blend,
-        no_blend,
-        no_blend,
-        no_blend,
-    };
+    OnyxShaderInfo                 deferredStages[2];
+    const OnyxGraphicsPipelineInfo defferedPipeInfo =
+        deferredPipelineInfo(r, NULL, deferredStages);
 
-    const OnyxGraphicsPipelineInfo gPipelineInfos[] = {
-        (OnyxGraphicsPipelineInfo){
-            .render_pass                      = gbufferRenderPass,
-            .topology                         = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-            .layout                           = pipelineLayout,
-            .rasterization_samples            = VK_SAMPLE_COUNT_1_BIT,
-            .front_face                       = frontface,
-            .attachment_count                 = 4,
-            .attachment_blends                = attachment_blends,
-            .line_width                       = 1.0,
-            .depth_test_enable                = true,
-            .depth_write_enable               = true,
-            .vertex_binding_description_count = LEN(b),
-            .vertex_binding_descriptions      = b,
-            .vertex_attribute_description_count = LEN(a),
-            .vertex_attribute_descriptions      = a,
-            .dynamic_state_count                = LEN(dynamicStates),
-            .dynamic_states                     = dynamicStates,
-            .shader_stage_count                 = LEN(shader_stages_reg),
-            .shader_stages                      = shader_stages_reg,
-        },
-        (OnyxGraphicsPipelineInfo){
-            .render_pass           = gbufferRenderPass,
-            .topology              = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-            .layout                = pipelineLayout,
-            .rasterization_samples = VK_SAMPLE_COUNT_1_BIT,
-            .front_face            = frontface,
-            .line_width                       = 1.0,
-            .depth_test_enable                = true,
-            .depth_write_enable               = true,
-            .attachment_count      = 4,
-            .attachment_blends                = attachment_blends,
-            .dynamic_state_count   = LEN(dynamicStates),
-            .dynamic_states        = dynamicStates,
-            .vertex_binding_description_count = LEN(tan_b),
-            .vertex_binding_descriptions      = tan_b,
-            .vertex_attribute_description_count = LEN(tan_a),
-            .vertex_attribute_descriptions      = tan_a,
-            .shader_stage_count    = LEN(shader_stages_tan),
-            .shader_stages         = shader_stages_tan,
-        },
-        (OnyxGraphicsPipelineInfo){
-            .render_pass                      = gbufferRenderPass,
-            .topology                         = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-            .layout                           = pipelineLayout,
-            .rasterization_samples            = VK_SAMPLE_COUNT_1_BIT,
-            .line_width                       = 1.0,
-            .depth_test_enable                = true,
-            .depth_write_enable               = true,
-            .front_face                       = frontface,
-            .attachment_count                 = 4,
-            .attachment_blends                = attachment_blends,
-            .dynamic_state_count              = LEN(dynamicStates),
-            .dynamic_states                   = dynamicStates,
-            .vertex_binding_description_count = LEN(b),
-            .vertex_binding_descriptions      = b,
-            .vertex_attribute_description_count = LEN(a),
-            .vertex_attribute_descriptions      = a,
-            .shader_stage_count                 = LEN(shader_stages_pos),
-            .shader_stages                      = shader_stages_pos,
-        }};
-
-    const OnyxGraphicsPipelineInfo defferedPipeInfo = {
-        .render_pass = deferredRenderPass,
-        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-        .layout            = pipelineLayout,
+    const OnyxGraphicsPipelineInfo compositePipeInfo = {
+        .render_pass           = r->compositeRenderPass,
+        .topology              = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .layout                = shared.pipelineLayout,
         .rasterization_samples = VK_SAMPLE_COUNT_1_BIT,
-        .front_face = VK_FRONT_FACE_CLOCKWISE,
-        .attachment_count = 1,
-        .attachment_blends = attachment_blends,
-        .dynamic_state_count = LEN(dynamicStates),
-        .dynamic_states = dynamicStates,
-        .shader_stage_count = LEN(shader_stages_deferred),
-        .shader_stages = shader_stages_deferred,
-            .line_width                       = 1.0,
+        .front_face            = VK_FRONT_FACE_CLOCKWISE,
+        .attachment_count      = 1,
+        .attachment_blends     = noBlends,
+        .dynamic_state_count   = LEN(dynamicStates),
+        .dynamic_states        = dynamicStates,
+        .shader_stage_count    = LEN(shader_stages_composite),
+        .shader_stages         = shader_stages_composite,
+        .line_width            = 1.0,
     };
 
     const OnyxRayTracePipelineInfo rtPipelineInfo = {
-        .layout        = pipelineLayout,
+        .layout        = shared.pipelineLayout,
         .raygen_count    = 1,
         .raygen_shaders = (char*[]){WOAD_SPV_PREFIX "/shadow.rgen.spv"},
         .miss_count      = 1,
@@ -754,314 +2170,1282 @@ initPipelines(bool openglStyle)
         .chit_count = 1,
         .chit_shaders = (char*[]){WOAD_SPV_PREFIX "/shadow.rchit.spv"}};
 
-    assert(LEN(gPipelineInfos) == GBUFFER_PIPELINE_COUNT);
+    // the depth prepass draws each bucket with a position only vertex
+    // shader and no fragment stage. float geometry reads just the position
+    // stream, packed geometry pulls just the position.
+    const OnyxShaderInfo depthStages[] = {
+        permutedStage(SHADER_POS_VERT, VK_SHADER_STAGE_VERTEX_BIT, NULL),
+        {.byte_count  = packed_pos_vert_code.count,
+         .code        = (void*)packed_pos_vert_code.elems,
+         .stage       = VK_SHADER_STAGE_VERTEX_BIT,
+         .entry_point = "main"}};
+    const VkVertexInputBindingDescription posBinding = {
+        .binding   = 0,
+        .stride    = posAttrSizes[0],
+        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX};
+    const VkVertexInputAttributeDescription posAttribute = {
+        .binding = 0, .format = VK_FORMAT_R32G32B32_SFLOAT, .location = 0};
+
+    // the forward mode's shaded draws swap each bucket's gbuffer shader for
+    // the forward one reading the same inputs
+    const ByteArray* forwardCode[GBUFFER_PIPELINE_COUNT] = {
+        &forward_code, &forward_tan_code, &forward_pos_code, &forward_code,
+        &forward_tan_code};
+    OnyxGraphicsPipelineInfo depthPipeInfos[GBUFFER_PIPELINE_COUNT];
+    OnyxGraphicsPipelineInfo forwardPipeInfos[GBUFFER_PIPELINE_COUNT];
+    OnyxShaderInfo           forwardStages[GBUFFER_PIPELINE_COUNT][2];
+    for (int i = 0; i < GBUFFER_PIPELINE_COUNT; i++)
+    {
+        const bool packed = pipelinePacked(i);
+        depthPipeInfos[i]                  = gPipelineInfos[i];
+        depthPipeInfos[i].render_pass      =
+            shared.depthRenderPass[r->viewCount - 1];
+        depthPipeInfos[i].attachment_count   = 0;
+        depthPipeInfos[i].shader_stage_count = 1;
+        depthPipeInfos[i].shader_stages      = &depthStages[packed ? 1 : 0];
+        depthPipeInfos[i].vertex_binding_description_count   = packed ? 0 : 1;
+        depthPipeInfos[i].vertex_binding_descriptions        = &posBinding;
+        depthPipeInfos[i].vertex_attribute_description_count = packed ? 0 : 1;
+        depthPipeInfos[i].vertex_attribute_descriptions      = &posAttribute;
+
+        forwardStages[i][0] = gPipelineInfos[i].shader_stages[0];
+        forwardStages[i][1] = (OnyxShaderInfo){
+            .byte_count  = forwardCode[i]->count,
+            .code        = (void*)forwardCode[i]->elems,
+            .stage       = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .entry_point = "main"};
+        // the forward pass always follows its prepass
+        forwardPipeInfos[i]                     = gPipelineInfos[i];
+        forwardPipeInfos[i].render_pass         = r->forwardRenderPass;
+        forwardPipeInfos[i].attachment_count    = 1;
+        forwardPipeInfos[i].depth_write_enable  = false;
+        forwardPipeInfos[i].dynamic_state_count = LEN(prepassedDynamicStates);
+        forwardPipeInfos[i].dynamic_states      = prepassedDynamicStates;
+        forwardPipeInfos[i].shader_stages       = forwardStages[i];
+    }
 
-    onyx_create_graphics_pipelines(device, LEN(gPipelineInfos), gPipelineInfos,
-                                 gbufferPipelines);
-    onyx_create_graphics_pipelines(device, 1, &defferedPipeInfo,
-                                 &defferedPipeline);
-    if (!raytracing_disabled)
-        onyx_create_ray_trace_pipelines(device, memory, 1, &rtPipelineInfo,
-                                     &raytracePipeline, &shaderBindingTable);
+    if (gbufferPipelines[0] == VK_NULL_HANDLE)
+        onyx_create_graphics_pipelines(shared.device, LEN(gPipelineInfos),
+                                       gPipelineInfos, gbufferPipelines);
+    if (!r->visibilityBuffer &&
+        shared.depthPipelines[r->viewCount - 1][0] == VK_NULL_HANDLE)
+        onyx_create_graphics_pipelines(
+            shared.device, LEN(depthPipeInfos), depthPipeInfos,
+            shared.depthPipelines[r->viewCount - 1]);
+    if (r->forward)
+        onyx_create_graphics_pipelines(r->device, LEN(forwardPipeInfos),
+                                       forwardPipeInfos, r->forwardPipelines);
+    if (r->forward && shared.lightCullPipeline == VK_NULL_HANDLE)
+        initComputePipeline(r, &shader_stage_light_cull,
+                            &shared.lightCullPipeline);
+    if (r->visibilityBuffer &&
+        shared.visibilityPipelines[r->viewCount - 1] == VK_NULL_HANDLE)
+        onyx_create_graphics_pipelines(
+            shared.device, 1, &visibilityPipeInfo,
+            &shared.visibilityPipelines[r->viewCount - 1]);
+    if (r->visibilityBuffer && shared.resolvePipeline == VK_NULL_HANDLE)
+        initComputePipeline(r, &shader_stage_resolve, &shared.resolvePipeline);
+    if (r->computeShading)
+        initComputePipeline(r, &shader_stage_shade, &r->defferedPipeline);
+    else if (!r->forward)
+        onyx_create_graphics_pipelines(r->device, 1, &defferedPipeInfo,
+                                       &r->defferedPipeline);
+    // with multiview the caller composites the layers itself
+    if (r->dynamicRendering)
+        initRenderingPipeline(r, shader_stages_composite,
+                              LEN(shader_stages_composite), swapFormat,
+                              &r->compositePipeline);
+    else if (r->viewCount == 1)
+        onyx_create_graphics_pipelines(r->device, 1, &compositePipeInfo,
+                                       &r->compositePipeline);
+    // the forward mode traces its shadows with ray queries instead
+    if (!r->raytracing_disabled && !r->forward &&
+        shared.raytracePipeline == VK_NULL_HANDLE)
+        onyx_create_ray_trace_pipelines(shared.device, r->memory, 1,
+                                        &rtPipelineInfo, &shared.raytracePipeline,
+                                        &shared.shaderBindingTable);
 }
 
-static void
-updateGbufferDescriptors(void)
+static VkPipeline
+findPermutation(const PermutationArray* perms, uint32_t key)
+{
+    for (int i = 0; i < perms->count; i++)
+        if (perms->elems[i].key == key)
+            return perms->elems[i].pipeline;
+    return VK_NULL_HANDLE;
+}
+
+// the maps a bucket's gbuffer shader samples when its material has them
+static uint32_t
+sampledMaps(int pipeId)
 {
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    switch (pipeId)
     {
-        VkDescriptorImageInfo worldPInfo = {.sampler   = imageWorldP.sampler,
-                                            .imageView = imageWorldP.view,
-                                            .imageLayout =
-                                                VK_IMAGE_LAYOUT_GENERAL};
+    case PIPELINE_GBUFFER_POS:
+        return 0;
+    case PIPELINE_GBUFFER_POS_NOR_UV_TAN:
+    case PIPELINE_GBUFFER_PACKED_NOR_UV_TAN:
+        return ALBEDO_MAP | ROUGHNESS_MAP | NORMAL_MAP;
+    default:
+        return ALBEDO_MAP | ROUGHNESS_MAP;
+    }
+}
 
-        VkDescriptorImageInfo normalInfo = {.sampler   = imageNormal.sampler,
-                                            .imageView = imageNormal.view,
-                                            .imageLayout =
-                                                VK_IMAGE_LAYOUT_GENERAL};
+// the maps any of a bucket's draws sample
+static uint32_t
+bucketMaps(int pipeId, const DrawArray* draws, const OnyxScene* scene)
+{
+    obint               count;
+    const OnyxMaterial* materials = onyx_scene_get_materials(scene, &count);
+    const uint32_t      sampled   = sampledMaps(pipeId);
+    uint32_t            maps      = 0;
+    for (int i = 0; i < draws->count && maps != sampled; i++)
+    {
+        const OnyxPrimitive* prim =
+            onyx_scene_get_primitive_const(scene, draws->elems[i].prim);
+        const OnyxMaterial* mat = &materials[prim->material.id];
+        if (mat->texture_albedo > 0)
+            maps |= ALBEDO_MAP;
+        if (mat->texture_roughness > 0)
+            maps |= ROUGHNESS_MAP;
+        if (mat->texture_normal > 0)
+            maps |= NORMAL_MAP;
+    }
+    return maps & sampled;
+}
 
-        VkDescriptorImageInfo albedoInfo = {.sampler   = imageAlbedo.sampler,
-                                            .imageView = imageAlbedo.view,
-                                            .imageLayout =
-                                                VK_IMAGE_LAYOUT_GENERAL};
+// a bucket's gbuffer pipeline specialized to sample only maps, made the
+// first time any renderer with the same view count draws the bucket with
+// them. the pipeline checking every map serves when they all are sampled.
+static VkPipeline
+gbufferPermutation(const WoadRenderer* r, int pipeId, uint32_t maps)
+{
+    const VkPipeline generic =
+        shared.gbufferPipelines[r->viewCount - 1][pipeId];
+    const bool prepassed = r->depthPrepass;
+    if (maps == sampledMaps(pipeId) && !prepassed)
+        return generic;
+
+    PermutationArray* perms = &shared.gbufferPermutations[r->viewCount - 1];
+    uint32_t key = (uint32_t)prepassed << 16 | (uint32_t)pipeId << 8 | maps;
+    pthread_mutex_lock(&shared.lock);
+    VkPipeline pipeline = findPermutation(perms, key);
+    // past the cap a bucket keeps to its generic pipeline. after a prepass
+    // that is the unspecialized prepassed one, made regardless of the cap,
+    // as the generic one tests and writes depth as if there were none.
+    if (pipeline == VK_NULL_HANDLE && prepassed &&
+        perms->count >= MAX_PERMUTATIONS)
+    {
+        maps     = sampledMaps(pipeId);
+        key      = 1u << 16 | (uint32_t)pipeId << 8 | maps;
+        pipeline = findPermutation(perms, key);
+    }
+    if (pipeline == VK_NULL_HANDLE &&
+        (perms->count < MAX_PERMUTATIONS || prepassed))
+    {
+        const VkSpecializationMapEntry entry = {.constantID = 0,
+                                                .size = sizeof(maps)};
+        const VkSpecializationInfo     spec  = {.mapEntryCount = 1,
+                                                .pMapEntries   = &entry,
+                                                .dataSize = sizeof(maps),
+                                                .pData    = &maps};
+        OnyxShaderInfo                 stages[2];
+        const OnyxGraphicsPipelineInfo info =
+            gbufferPipelineInfo(pipeId, r->viewCount, prepassed, &spec,
+                                stages);
+        onyx_create_graphics_pipelines(shared.device, 1, &info, &pipeline);
+        permutation_arr_push(perms, (Permutation){key, pipeline});
+    }
+    pthread_mutex_unlock(&shared.lock);
+    return pipeline != VK_NULL_HANDLE ? pipeline : generic;
+}
 
-        VkDescriptorImageInfo shadowInfo = {.sampler   = imageShadow.sampler,
-                                            .imageView = imageShadow.view,
-                                            .imageLayout =
-                                                VK_IMAGE_LAYOUT_GENERAL};
+// the deferred pipeline specialized to the scene's lights and to whether
+// they cast shadows, made the first time they are shaded. more lights than
+// the shaders are specialized to keep to the pipeline that reads them.
+static VkPipeline
+deferredPermutation(WoadRenderer* r, const OnyxScene* scene)
+{
+    obint            count;
+    const OnyxLight* lights = onyx_scene_get_lights(scene, &count);
+    if (count > MAX_SPECIALIZED_LIGHTS)
+        return r->defferedPipeline;
+
+    uint32_t dirs = 0;
+    for (int i = 0; i < count; i++)
+        if (lights[i].type == DIR_LIGHT_TYPE)
+            dirs |= 1u << i;
+    const uint32_t constants[] = {count, dirs, !r->raytracing_disabled};
+    const uint32_t key = constants[0] | constants[1] << 4 | constants[2] << 12;
+    VkPipeline     pipeline = findPermutation(&r->deferredPermutations, key);
+    if (pipeline != VK_NULL_HANDLE)
+        return pipeline;
+    if (r->deferredPermutations.count == MAX_PERMUTATIONS)
+        return r->defferedPipeline;
+
+    const VkSpecializationMapEntry entries[] = {
+        {.constantID = 1, .offset = 0, .size = sizeof(uint32_t)},
+        {.constantID = 2, .offset = 4, .size = sizeof(uint32_t)},
+        {.constantID = 3, .offset = 8, .size = sizeof(VkBool32)}};
+    const VkSpecializationInfo spec = {.mapEntryCount = LEN(entries),
+                                       .pMapEntries   = entries,
+                                       .dataSize      = sizeof(constants),
+                                       .pData         = constants};
+    if (r->computeShading)
+    {
+        const OnyxShaderInfo stage = permutedStage(
+            SHADER_DEFERRED_COMP, VK_SHADER_STAGE_COMPUTE_BIT, &spec);
+        initComputePipeline(r, &stage, &pipeline);
+    }
+    else
+    {
+        OnyxShaderInfo                 stages[2];
+        const OnyxGraphicsPipelineInfo info =
+            deferredPipelineInfo(r, &spec, stages);
+        onyx_create_graphics_pipelines(r->device, 1, &info, &pipeline);
+    }
+    permutation_arr_push(&r->deferredPermutations,
+                         (Permutation){key, pipeline});
+    return pipeline;
+}
 
-        VkDescriptorImageInfo roughnessInfo = {
-            .sampler     = imageRoughness.sampler,
-            .imageView   = imageRoughness.view,
+// points a frame slot's deferred set at its current gbuffer and lit image.
+// the slot's previous frame must have completed.
+static void
+updateSlotDescriptors(WoadRenderer* r, uint32_t i)
+{
+    const GBuffer* gbuf = frameGbuffer(r, i);
+
+    VkDescriptorImageInfo worldPInfo = {.imageView = gbuf->worldP.view,
+                                        .imageLayout =
+                                            VK_IMAGE_LAYOUT_GENERAL};
+
+    VkDescriptorImageInfo normalInfo = {.imageView = gbuf->normal.view,
+                                        .imageLayout =
+                                            VK_IMAGE_LAYOUT_GENERAL};
+
+    VkDescriptorImageInfo albedoInfo = {.imageView = gbuf->albedo.view,
+                                        .imageLayout =
+                                            VK_IMAGE_LAYOUT_GENERAL};
+
+    const VkImageView     shadowView =
+        r->raytracing_disabled ? gbuf->shadow.view
+                               : graph_ImageView(&gbuf->graph, GRAPH_SHADOW);
+    VkDescriptorImageInfo shadowInfo = {.imageView = shadowView,
+                                        .imageLayout =
+                                            VK_IMAGE_LAYOUT_GENERAL};
+
+    VkDescriptorImageInfo roughnessInfo = {
+        .imageView   = gbuf->roughness.view,
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+
+    VkDescriptorImageInfo litInfo = {.sampler   = shared.litSampler,
+                                     .imageView = r->litImages[i].view,
+                                     .imageLayout = r->litLayout};
+
+    VkWriteDescriptorSet writes[] = {
+        {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstArrayElement = 0,
+         .dstSet     = r->descriptorSets[i][DESC_SET_DEFERRED],
+         .dstBinding = 0,
+         .descriptorCount = 1,
+         .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+         .pImageInfo      = &worldPInfo},
+        {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstArrayElement = 0,
+         .dstSet     = r->descriptorSets[i][DESC_SET_DEFERRED],
+         .dstBinding = 1,
+         .descriptorCount = 1,
+         .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+         .pImageInfo      = &normalInfo},
+        {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstArrayElement = 0,
+         .dstSet     = r->descriptorSets[i][DESC_SET_DEFERRED],
+         .dstBinding = 2,
+         .descriptorCount = 1,
+         .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+         .pImageInfo      = &albedoInfo},
+        {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstArrayElement = 0,
+         .dstSet     = r->descriptorSets[i][DESC_SET_DEFERRED],
+         .dstBinding = 3,
+         .descriptorCount = 1,
+         .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+         .pImageInfo      = &shadowInfo},
+        {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstArrayElement = 0,
+         .dstSet     = r->descriptorSets[i][DESC_SET_DEFERRED],
+         .dstBinding = 4,
+         .descriptorCount = 1,
+         .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+         .pImageInfo      = &roughnessInfo},
+        {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstArrayElement = 0,
+         .dstSet     = r->descriptorSets[i][DESC_SET_DEFERRED],
+         .dstBinding = 6,
+         .descriptorCount = 1,
+         .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+         .pImageInfo      = &litInfo}};
+
+    // only the composite pass samples the lit image, and multiview has
+    // none. the forward mode has no gbuffer images to point at.
+    const uint32_t firstWrite = r->forward ? LEN(writes) - 1 : 0;
+    const uint32_t writeCount =
+        LEN(writes) - firstWrite - (r->viewCount > 1 ? 1 : 0);
+    vkUpdateDescriptorSets(r->device, writeCount, writes + firstWrite, 0,
+                           NULL);
+
+    if (r->forward)
+    {
+        const VkDescriptorImageInfo tileLightsInfo = {
+            .imageView   = gbuf->tileLights.view,
             .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
-
-        VkWriteDescriptorSet writes[] = {
-            {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-             .dstArrayElement = 0,
-             .dstSet     = descriptorSets[i][DESC_SET_DEFERRED],
-             .dstBinding = 0,
-             .descriptorCount = 1,
-             .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-             .pImageInfo      = &worldPInfo},
-            {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-             .dstArrayElement = 0,
-             .dstSet     = descriptorSets[i][DESC_SET_DEFERRED],
-             .dstBinding = 1,
-             .descriptorCount = 1,
-             .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-             .pImageInfo      = &normalInfo},
-            {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-             .dstArrayElement = 0,
-             .dstSet     = descriptorSets[i][DESC_SET_DEFERRED],
-             .dstBinding = 2,
-             .descriptorCount = 1,
-             .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-             .pImageInfo      = &albedoInfo},
+        const VkDescriptorImageInfo depthInfo = {
+            .imageView   = graph_ImageView(&gbuf->graph, GRAPH_DEPTH),
+            .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+        const VkWriteDescriptorSet forwardWrites[] = {
             {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-             .dstArrayElement = 0,
-             .dstSet     = descriptorSets[i][DESC_SET_DEFERRED],
-             .dstBinding = 3,
+             .dstSet          = r->descriptorSets[i][DESC_SET_DEFERRED],
+             .dstBinding      = 9,
              .descriptorCount = 1,
              .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-             .pImageInfo      = &shadowInfo},
+             .pImageInfo      = &tileLightsInfo},
             {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-             .dstArrayElement = 0,
-             .dstSet     = descriptorSets[i][DESC_SET_DEFERRED],
-             .dstBinding = 4,
+             .dstSet          = r->descriptorSets[i][DESC_SET_DEFERRED],
+             .dstBinding      = 10,
              .descriptorCount = 1,
-             .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-             .pImageInfo      = &roughnessInfo}};
+             .descriptorType  = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+             .pImageInfo      = &depthInfo}};
+        vkUpdateDescriptorSets(r->device, LEN(forwardWrites), forwardWrites,
+                               0, NULL);
+        // the forward draws bind this set, which isn't update-after-bind
+        r->gbufferCache[i].valid = false;
+        return;
+    }
 
-        vkUpdateDescriptorSets(device, LEN(writes), writes, 0, NULL);
+    if (r->visibilityBuffer)
+    {
+        const VkDescriptorImageInfo visibilityInfo = {
+            .imageView   = graph_ImageView(&gbuf->graph, GRAPH_VISIBILITY),
+            .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+        const VkWriteDescriptorSet visibilityWrite = {
+            .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet          = r->descriptorSets[i][DESC_SET_DEFERRED],
+            .dstBinding      = 8,
+            .descriptorCount = 1,
+            .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .pImageInfo      = &visibilityInfo};
+        vkUpdateDescriptorSets(r->device, 1, &visibilityWrite, 0, NULL);
     }
+    if (!r->computeShading)
+        return;
+    const VkDescriptorImageInfo litStorageInfo = {
+        .imageView   = r->litImages[i].view,
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+    const VkWriteDescriptorSet litWrite = {
+        .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet          = r->descriptorSets[i][DESC_SET_DEFERRED],
+        .dstBinding      = 7,
+        .descriptorCount = 1,
+        .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        .pImageInfo      = &litStorageInfo};
+    vkUpdateDescriptorSets(r->device, 1, &litWrite, 0, NULL);
 }
 
 static void
-updateASDescriptors(int frame_index)
+updateASDescriptors(WoadRenderer* r, int frame_index)
 {
     VkWriteDescriptorSetAccelerationStructureKHR asInfo = {
         .sType =
             VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR,
         .accelerationStructureCount = 1,
-        .pAccelerationStructures    = &tlas[frame_index].handle};
+        .pAccelerationStructures    = &r->tlas[frame_index].handle};
 
     VkWriteDescriptorSet writeDS = {
         .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
         .dstArrayElement = 0,
-        .dstSet     = descriptorSets[frame_index][DESC_SET_DEFERRED],
+        .dstSet     = r->descriptorSets[frame_index][DESC_SET_DEFERRED],
         .dstBinding = 5,
         .descriptorCount = 1,
         .descriptorType  = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR,
         .pNext           = &asInfo};
 
-    vkUpdateDescriptorSets(device, 1, &writeDS, 0, NULL);
+    vkUpdateDescriptorSets(r->device, 1, &writeDS, 0, NULL);
+    if (r->forward)
+        r->gbufferCache[frame_index].valid = false;
 }
 
 static void
-updateDescriptors(void)
+updateDescriptors(WoadRenderer* r)
 {
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    for (int i = 0; i < r->framesInFlight; i++)
     {
         // camera creation
-        cameraBuffers[i] = onyx_request_buffer_region(
-            memory, sizeof(Camera), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            ONYX_MEMORY_HOST_GRAPHICS_TYPE);
-
-        // xforms creation
-        xformsBuffers[i] = onyx_request_buffer_region(
-            memory, sizeof(Xforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            ONYX_MEMORY_HOST_GRAPHICS_TYPE);
+        r->cameraBuffers[i] = onyx_request_buffer_region(
+            r->memory, sizeof(Camera) * MAX_VIEWS,
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            ONYX_MEMORY_DEVICE_TYPE);
+
+        r->instancesBuffers[i] = onyx_request_buffer_region(
+            r->memory, sizeof(DrawInstance) * MIN_INSTANCE_CAPACITY,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            ONYX_MEMORY_DEVICE_TYPE);
+        r->instancesCapacity[i] = MIN_INSTANCE_CAPACITY;
 
         // lights creation
-        lightsBuffers[i] = onyx_request_buffer_region(
-            memory, sizeof(Lights), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        r->lightsBuffers[i] = onyx_request_buffer_region(
+            r->memory, sizeof(Lights),
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            ONYX_MEMORY_DEVICE_TYPE);
+
+        r->materialsBuffers[i] = onyx_request_buffer_region(
+            r->memory, sizeof(Material) * MIN_MATERIAL_CAPACITY,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            ONYX_MEMORY_DEVICE_TYPE);
+        r->materialsCapacity[i] = MIN_MATERIAL_CAPACITY;
+
+        r->stagingRing[i].buffer = onyx_request_buffer_region(
+            r->memory, MIN_STAGING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
             ONYX_MEMORY_HOST_GRAPHICS_TYPE);
+        r->stagingRing[i].head = 0;
 
-        materialsBuffers[i] = onyx_request_buffer_region(
-            memory, sizeof(Material) * ONYX_S_MAX_MATERIALS,
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, ONYX_MEMORY_HOST_GRAPHICS_TYPE);
+        // read on the host, so it lives there
+        r->feedbackBuffers[i] = onyx_request_buffer_region(
+            r->memory, sizeof(uint32_t) * MAX_TEXTURE_COUNT,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            ONYX_MEMORY_HOST_GRAPHICS_TYPE);
+        memset(r->feedbackBuffers[i].host_data, 0,
+               r->feedbackBuffers[i].size);
 
-        VkDescriptorBufferInfo camInfo = {.buffer = cameraBuffers[i].buffer,
-                                          .offset = cameraBuffers[i].offset,
-                                          .range  = cameraBuffers[i].size};
+        VkDescriptorBufferInfo camInfo = {.buffer = r->cameraBuffers[i].buffer,
+                                          .offset = r->cameraBuffers[i].offset,
+                                          .range  = r->cameraBuffers[i].size};
 
-        VkDescriptorBufferInfo xformInfo = {.buffer = xformsBuffers[i].buffer,
-                                            .offset = xformsBuffers[i].offset,
-                                            .range  = xformsBuffers[i].size};
+        VkDescriptorBufferInfo instanceInfo = {
+            .buffer = r->instancesBuffers[i].buffer,
+            .offset = r->instancesBuffers[i].offset,
+            .range  = r->instancesBuffers[i].size};
 
-        VkDescriptorBufferInfo lightInfo = {.buffer = lightsBuffers[i].buffer,
-                                            .offset = lightsBuffers[i].offset,
-                                            .range  = lightsBuffers[i].size};
+        VkDescriptorBufferInfo lightInfo = {.buffer = r->lightsBuffers[i].buffer,
+                                            .offset = r->lightsBuffers[i].offset,
+                                            .range  = r->lightsBuffers[i].size};
 
         VkDescriptorBufferInfo materialInfo = {
-            .buffer = materialsBuffers[i].buffer,
-            .offset = materialsBuffers[i].offset,
-            .range  = materialsBuffers[i].size};
+            .buffer = r->materialsBuffers[i].buffer,
+            .offset = r->materialsBuffers[i].offset,
+            .range  = r->materialsBuffers[i].size};
+
+        VkDescriptorBufferInfo feedbackInfo = {
+            .buffer = r->feedbackBuffers[i].buffer,
+            .offset = r->feedbackBuffers[i].offset,
+            .range  = r->feedbackBuffers[i].size};
 
         VkWriteDescriptorSet writes[] = {
             {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
              .dstArrayElement = 0,
-             .dstSet          = descriptorSets[i][DESC_SET_MAIN],
+             .dstSet          = r->descriptorSets[i][DESC_SET_MAIN],
              .dstBinding      = 0,
              .descriptorCount = 1,
              .descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
              .pBufferInfo     = &camInfo},
             {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
              .dstArrayElement = 0,
-             .dstSet          = descriptorSets[i][DESC_SET_MAIN],
+             .dstSet          = r->descriptorSets[i][DESC_SET_MAIN],
              .dstBinding      = 1,
              .descriptorCount = 1,
-             .descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-             .pBufferInfo     = &xformInfo},
+             .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+             .pBufferInfo     = &instanceInfo},
             {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
              .dstArrayElement = 0,
-             .dstSet          = descriptorSets[i][DESC_SET_MAIN],
+             .dstSet          = r->descriptorSets[i][DESC_SET_MAIN],
              .dstBinding      = 2,
              .descriptorCount = 1,
              .descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
              .pBufferInfo     = &lightInfo},
             {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
              .dstArrayElement = 0,
-             .dstSet          = descriptorSets[i][DESC_SET_MAIN],
+             .dstSet          = r->descriptorSets[i][DESC_SET_MAIN],
              .dstBinding      = 4,
              .descriptorCount = 1,
-             .descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-             .pBufferInfo     = &materialInfo}};
+             .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+             .pBufferInfo     = &materialInfo},
+            {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+             .dstArrayElement = 0,
+             .dstSet          = r->descriptorSets[i][DESC_SET_MAIN],
+             .dstBinding      = 6,
+             .descriptorCount = 1,
+             .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+             .pBufferInfo     = &feedbackInfo}};
 
-        vkUpdateDescriptorSets(device, LEN(writes), writes, 0, NULL);
+        vkUpdateDescriptorSets(r->device, LEN(writes), writes, 0, NULL);
     }
+}
 
-    updateGbufferDescriptors();
+// folds what this slot's last gbuffer pass sampled into the demand
+// woad_StreamTextures reads, and clears it for the next pass. the slot's
+// commands have completed.
+static void
+readFeedback(WoadRenderer* r, uint32_t frameIndex)
+{
+    uint32_t* sizes = (uint32_t*)r->feedbackBuffers[frameIndex].host_data;
+    for (int i = 0; i < MAX_TEXTURE_COUNT; i++)
+    {
+        if (sizes[i] > r->textureDemand[i])
+            r->textureDemand[i] = sizes[i];
+        sizes[i] = 0;
+    }
+    r->demandComplete |= r->feedbackComplete[frameIndex];
+    r->feedbackComplete[frameIndex] = false;
 }
 
+// writes every texture slot whose image differs from what this frame's set
+// already points at, in a single descriptor update.
 static void
-updateTexture(const uint32_t frameIndex, const OnyxImage* img,
-              const uint32_t texId)
+updateTextures(WoadRenderer* r, const OnyxScene* scene, const uint32_t frameIndex)
 {
-    VkDescriptorImageInfo textureInfo = {
-        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-        .imageView   = img->view,
-        .sampler     = img->sampler};
+    obint              tex_count = 0;
+    const OnyxTexture* tex       = onyx_scene_get_textures(scene, &tex_count);
+    if (tex_count > MAX_TEXTURE_COUNT)
+    {
+        hell_print("Woad: scene has %d textures, only %d are bound\n",
+                   (int)tex_count, MAX_TEXTURE_COUNT);
+        tex_count = MAX_TEXTURE_COUNT;
+    }
 
-    VkWriteDescriptorSet write = {
-        .sType      = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-        .pNext      = NULL,
-        .dstSet     = descriptorSets[frameIndex][DESC_SET_MAIN],
-        .dstBinding = 3,
-        .dstArrayElement = texId,
-        .descriptorCount = 1,
-        .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        .pImageInfo      = &textureInfo};
+    VkDescriptorImageInfo* infos =
+        malloc(sizeof(VkDescriptorImageInfo) * tex_count);
+    VkWriteDescriptorSet* writes =
+        malloc(sizeof(VkWriteDescriptorSet) * tex_count);
+    uint32_t write_count = 0;
 
-    vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+    // remember, 1 is the first valid texture index
+    for (int i = 0; i < tex_count; i++)
+    {
+        const OnyxImage* img  = tex[i].dev_image;
+        TextureSlot*     slot = &r->boundTextures[frameIndex][i];
+        if (!img || (slot->view == img->view && slot->sampler == img->sampler))
+            continue;
+        slot->view    = img->view;
+        slot->sampler = img->sampler;
+
+        infos[write_count] = (VkDescriptorImageInfo){
+            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .imageView   = img->view,
+            .sampler     = img->sampler};
+
+        writes[write_count] = (VkWriteDescriptorSet){
+            .sType      = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext      = NULL,
+            .dstSet     = r->descriptorSets[frameIndex][DESC_SET_MAIN],
+            .dstBinding = 3,
+            .dstArrayElement = i,
+            .descriptorCount = 1,
+            .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo      = &infos[write_count]};
+        write_count++;
+    }
+
+    if (write_count)
+        vkUpdateDescriptorSets(r->device, write_count, writes, 0, NULL);
 
-    printf("Updated Texture %d frame %d\n", texId, frameIndex);
+    free(infos);
+    free(writes);
 }
 
+// geometry from woad_PackGeometry: float positions, then every other
+// attribute in 4 bytes, interleaved
+static bool
+geoPacked(const OnyxGeometry* geo)
+{
+    return geo->templ.attribute_count > 1 &&
+           geo->templ.attribute_types[1] == ONYX_ATTRIBUTE_TYPE_NORMAL &&
+           geo->templ.attribute_sizes[1] == 4;
+}
+
+// points this slot's main set at the geometry blocks, when they changed
+// since it last did
 static void
-generateGBuffer(VkCommandBuffer cmdBuf, const OnyxScene* scene,
-                const uint32_t frameIndex, uint32_t frame_width,
-                uint32_t frame_height)
+updateGeometryBlocks(WoadRenderer* r, const uint32_t frameIndex)
 {
-    VkClearValue clearValueColor = {0.1f, 0.1f, 0.1f, 1.0f};
-    VkClearValue clearValueMatid = {0};
-    VkClearValue clearValueDepth = {1.0, 0};
+    const uint32_t generation = geometry_Generation();
+    if (r->slotGeometryGeneration[frameIndex] == generation)
+        return;
+    r->slotGeometryGeneration[frameIndex] = generation;
+
+    VkDescriptorBufferInfo infos[MAX_GEOMETRY_BLOCKS];
+    VkWriteDescriptorSet   writes[MAX_GEOMETRY_BLOCKS];
+    uint32_t               writeCount = 0;
+    geometry_Blocks(infos);
+    // freed blocks keep their stale descriptor. the binding is partially
+    // bound and nothing draws from them.
+    for (int i = 0; i < MAX_GEOMETRY_BLOCKS; i++)
+    {
+        if (infos[i].buffer == VK_NULL_HANDLE)
+            continue;
+        writes[writeCount++] = (VkWriteDescriptorSet){
+            .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet          = r->descriptorSets[frameIndex][DESC_SET_MAIN],
+            .dstBinding      = 5,
+            .dstArrayElement = i,
+            .descriptorCount = 1,
+            .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo     = &infos[i]};
+    }
+    if (writeCount)
+        vkUpdateDescriptorSets(r->device, writeCount, writes, 0, NULL);
+}
 
-    VkClearValue clears[] = {clearValueColor, clearValueColor, clearValueColor,
-                             clearValueMatid, clearValueDepth};
+// onyx_draw_geo binds and draws in one go. we split the two so that runs of
+// draws sharing geometry only bind once.
+static void
+bindGeo(VkCommandBuffer cmdBuf, const OnyxGeometry* geo)
+{
+    const uint32_t attrCount = geo->templ.attribute_count;
+    VkBuffer       vertBuffers[MAX_GEO_ATTRIBUTES];
+    assert(attrCount <= MAX_GEO_ATTRIBUTES);
+    for (int i = 0; i < attrCount; i++)
+        vertBuffers[i] = geo->vertex_region.buffer;
+    vkCmdBindVertexBuffers(cmdBuf, 0, attrCount, vertBuffers,
+                           geo->attribute_offsets);
+    vkCmdBindIndexBuffer(cmdBuf, geo->index_region.buffer,
+                         geo->index_region.offset, VK_INDEX_TYPE_UINT32);
+}
 
-    VkRenderPassBeginInfo rpassInfo = {
-        .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-        .clearValueCount = LEN(clears),
-        .pClearValues    = clears,
-        .renderArea      = {{0, 0}, {frame_width, frame_height}},
-        .renderPass      = gbufferRenderPass,
-        .framebuffer     = gframebuffer};
+// packed geometry pulls its vertices, and its indices are found by the
+// first index, so only a change of block rebinds
+static void
+drawPacked(WoadRenderer* r, VkCommandBuffer cmdBuf, const OnyxPrimitive* prim,
+           uint32_t instance, VkBuffer* boundIndex)
+{
+    const OnyxBuffer* indices = &prim->geo->index_region;
+    if (indices->buffer != *boundIndex)
+    {
+        vkCmdBindIndexBuffer(cmdBuf, indices->buffer, 0, VK_INDEX_TYPE_UINT32);
+        *boundIndex = indices->buffer;
+    }
+    const InstanceLod* lod   = &r->instanceLods[instance];
+    const GeometryLod* level = &lod->table.lods[lod->level];
+    vkCmdDrawIndexed(cmdBuf, level->indexCount, 1,
+                     indices->offset / sizeof(uint32_t) + level->firstIndex, 0,
+                     instance);
+}
 
-    vkCmdBeginRenderPass(cmdBuf, &rpassInfo, VK_SUBPASS_CONTENTS_INLINE);
+// whether the gbuffer pass has anything to draw. in the visibility buffer
+// mode packed geometry is drawn elsewhere.
+static bool
+gbufferHasDraws(const WoadRenderer* r)
+{
+    for (int pipeId = 0; pipeId < GBUFFER_PIPELINE_COUNT; pipeId++)
+    {
+        if (r->visibilityBuffer && pipelinePacked(pipeId))
+            continue;
+        if (r->pipelineDraws[pipeId].count)
+            return true;
+    }
+    return false;
+}
+
+// what a slot's secondary command buffer draws
+typedef enum {
+    DRAWS_GBUFFER,
+    DRAWS_VISIBILITY,
+    // the forward mode's depth prepass, then its shaded draws
+    DRAWS_DEPTH,
+    DRAWS_FORWARD,
+} DrawsKind;
+
+static void
+recordGbufferDraws(WoadRenderer* r, VkCommandBuffer cmdBuf, const OnyxScene* scene,
+                   const uint32_t frameIndex, DrawsKind kind)
+{
+    // secondaries start with nothing bound. the gbuffer shaders only use
+    // the main set, whose buffer bindings are update-after-bind, so growing
+    // a table doesn't invalidate the recording. the forward shaders also
+    // read the slot's set, whose writes invalidate it instead.
+    vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            shared.pipelineLayout, DESC_SET_MAIN,
+                            kind == DRAWS_FORWARD ? DESC_SET_COUNT : 1,
+                            r->descriptorSets[frameIndex], 0, NULL);
+
+    const VkPipeline* pipelines =
+        kind == DRAWS_FORWARD ? r->forwardPipelines
+        : kind == DRAWS_DEPTH ? shared.depthPipelines[r->viewCount - 1]
+                              : shared.gbufferPipelines[r->viewCount - 1];
+
+    // after a depth prepass only the fragments it left in front pass
+    if (kind == DRAWS_FORWARD || (kind == DRAWS_GBUFFER && r->depthPrepass))
+        vkCmdSetDepthCompareOp(cmdBuf, VK_COMPARE_OP_EQUAL);
 
     for (int pipeId = 0; pipeId < GBUFFER_PIPELINE_COUNT; pipeId++)
     {
-        vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                          gbufferPipelines[pipeId]);
-        uint32_t                    primCount;
-        const OnyxPrimitiveHandle* prim_handles =
-            onyx_get_primlist_prims(&pipelinePrimLists[pipeId], &primCount);
-        for (int i = 0; i < primCount; i++)
+        const DrawArray* draws = &r->pipelineDraws[pipeId];
+        if (draws->count == 0 ||
+            (r->visibilityBuffer && pipelinePacked(pipeId)))
+            continue;
+        // the gbuffer shaders skip the checks for maps no draw here has
+        const VkPipeline pipeline =
+            kind == DRAWS_GBUFFER
+                ? gbufferPermutation(r, pipeId,
+                                     bucketMaps(pipeId, draws, scene))
+                : pipelines[pipeId];
+        vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        const OnyxGeometry* boundGeo   = NULL;
+        VkBuffer            boundIndex = VK_NULL_HANDLE;
+        for (int i = 0; i < draws->count; i++)
         {
-            OnyxPrimitiveHandle  prim_handle = prim_handles[i];
             const OnyxPrimitive* prim =
-                onyx_scene_get_primitive_const(scene, prim_handle);
-            OnyxMaterialHandle matId = prim->material;
-            OnyxXform          xform = prim->xform;
-            vkCmdPushConstants(cmdBuf, pipelineLayout,
-                               VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Mat4),
-                               xform.e);
-            vkCmdPushConstants(cmdBuf, pipelineLayout,
-                               VK_SHADER_STAGE_VERTEX_BIT, sizeof(Mat4),
-                               sizeof(uint32_t), &prim_handle.id);
-            vkCmdPushConstants(
-                cmdBuf, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT,
-                sizeof(Mat4) + sizeof(uint32_t), sizeof(uint32_t), &matId);
-            onyx_draw_geo(cmdBuf, prim->geo, 1);
+                onyx_scene_get_primitive_const(scene, draws->elems[i].prim);
+            if (geoPacked(prim->geo))
+            {
+                drawPacked(r, cmdBuf, prim, draws->elems[i].instance,
+                           &boundIndex);
+                continue;
+            }
+            // draws are sorted by geometry, so this only rebinds at the
+            // start of each run
+            if (prim->geo != boundGeo)
+            {
+                bindGeo(cmdBuf, prim->geo);
+                boundGeo = prim->geo;
+            }
+            vkCmdDrawIndexed(cmdBuf, prim->geo->index_count, 1, 0, 0,
+                             draws->elems[i].instance);
         }
     }
+}
 
-    vkCmdEndRenderPass(cmdBuf);
+// every packed draw with the one visibility pipeline, which only needs
+// their positions
+static void
+recordVisibilityDraws(WoadRenderer* r, VkCommandBuffer cmdBuf,
+                      const OnyxScene* scene, const uint32_t frameIndex)
+{
+    vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            shared.pipelineLayout, DESC_SET_MAIN, 1,
+                            &r->descriptorSets[frameIndex][DESC_SET_MAIN], 0,
+                            NULL);
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      shared.visibilityPipelines[r->viewCount - 1]);
+
+    VkBuffer boundIndex = VK_NULL_HANDLE;
+    for (int pipeId = 0; pipeId < GBUFFER_PIPELINE_COUNT; pipeId++)
+    {
+        if (!pipelinePacked(pipeId))
+            continue;
+        const DrawArray* draws = &r->pipelineDraws[pipeId];
+        for (int i = 0; i < draws->count; i++)
+            drawPacked(r, cmdBuf,
+                       onyx_scene_get_primitive_const(scene,
+                                                      draws->elems[i].prim),
+                       draws->elems[i].instance, &boundIndex);
+    }
+}
+
+// records this slot's draws of the given kind into its secondary command
+// buffer, unless the last recording still holds
+static VkCommandBuffer
+cachedGbufferDraws(WoadRenderer* r, const OnyxScene* scene,
+                   const uint32_t frameIndex, VkRect2D viewport, VkRect2D area,
+                   DrawsKind kind)
+{
+    const bool    prepass = kind == DRAWS_VISIBILITY || kind == DRAWS_DEPTH;
+    GbufferCache* cache   = prepass ? &r->prepassCache[frameIndex]
+                                    : &r->gbufferCache[frameIndex];
+    if (cache->valid &&
+        memcmp(&cache->viewport, &viewport, sizeof(viewport)) == 0 &&
+        memcmp(&cache->scissor, &area, sizeof(area)) == 0)
+        return cache->cmdbuf;
+
+    if (r->drawDepthsStale)
+    {
+        updateDrawDepths(r, scene);
+        r->drawDepthsStale = false;
+    }
+
+    // the framebuffer is left out so resizes don't invalidate the recording
+    const VkRenderPass renderPasses[] = {
+        [DRAWS_GBUFFER]    = shared.gbufferRenderPass[r->viewCount - 1],
+        [DRAWS_VISIBILITY] = shared.visibilityRenderPass[r->viewCount - 1],
+        [DRAWS_DEPTH]      = shared.depthRenderPass[r->viewCount - 1],
+        [DRAWS_FORWARD]    = r->forwardRenderPass};
+    const VkCommandBufferInheritanceInfo inheritance = {
+        .sType      = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .renderPass = renderPasses[kind],
+        .subpass    = 0};
+
+    const VkCommandBufferBeginInfo beginInfo = {
+        .sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags            = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = &inheritance};
+
+    V_ASSERT(vkBeginCommandBuffer(cache->cmdbuf, &beginInfo));
+    onyx_cmd_set_viewport_scissor(cache->cmdbuf, viewport.offset.x,
+                                  viewport.offset.y, viewport.extent.width,
+                                  viewport.extent.height);
+    vkCmdSetScissor(cache->cmdbuf, 0, 1, &area);
+    if (kind == DRAWS_VISIBILITY)
+        recordVisibilityDraws(r, cache->cmdbuf, scene, frameIndex);
+    else
+        recordGbufferDraws(r, cache->cmdbuf, scene, frameIndex, kind);
+    V_ASSERT(vkEndCommandBuffer(cache->cmdbuf));
+
+    cache->viewport = viewport;
+    cache->scissor  = area;
+    cache->valid    = true;
+    return cache->cmdbuf;
 }
 
 static void
-shadowPass(VkCommandBuffer cmdBuf, const uint32_t frameIndex,
-           uint32_t windowWidth, uint32_t windowHeight)
+initGbufferCache(WoadRenderer* r)
 {
-    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
-                      raytracePipeline);
+    const VkCommandPoolCreateInfo poolInfo = {
+        .sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = r->graphic_queue_family_index};
+
+    V_ASSERT(vkCreateCommandPool(r->device, &poolInfo, NULL,
+                                 &r->gbufferCachePool));
+
+    // a second set for the visibility or depth prepass draws
+    VkCommandBuffer cmdbufs[MAX_FRAMES_IN_FLIGHT * 2];
+    const VkCommandBufferAllocateInfo allocInfo = {
+        .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool        = r->gbufferCachePool,
+        .level              = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+        .commandBufferCount = r->framesInFlight * 2};
+
+    V_ASSERT(vkAllocateCommandBuffers(r->device, &allocInfo, cmdbufs));
+    for (int i = 0; i < r->framesInFlight; i++)
+    {
+        r->gbufferCache[i] = (GbufferCache){.cmdbuf = cmdbufs[i]};
+        r->prepassCache[i] =
+            (GbufferCache){.cmdbuf = cmdbufs[r->framesInFlight + i]};
+    }
+}
 
-    vkCmdTraceRaysKHR(
-        cmdBuf, &shaderBindingTable.raygen_table, &shaderBindingTable.miss_table,
-        &shaderBindingTable.hit_table, &shaderBindingTable.callable_table,
-        windowWidth, windowHeight, 1);
+// the draw list changed, so every slot must record again
+static void
+invalidateGbufferCache(WoadRenderer* r)
+{
+    for (int i = 0; i < r->framesInFlight; i++)
+    {
+        r->gbufferCache[i].valid = false;
+        r->prepassCache[i].valid = false;
+    }
 }
 
+// clears and redraws the gbuffer inside area only. the rest keeps what
+// earlier frames drew there. in the visibility buffer mode the resolve has
+// already filled area, which is drawn over rather than cleared. after the
+// depth prepass only the nearest surface of each pixel is written.
 static void
-deferredRender(VkCommandBuffer cmdBuf, const uint32_t frameIndex,
-               uint32_t windowWidth, uint32_t windowHeight)
+generateGBuffer(WoadRenderer* r, VkCommandBuffer cmdBuf, const OnyxScene* scene,
+                const uint32_t frameIndex, VkRect2D viewport, VkRect2D area)
 {
+    // resolve.comp writes the same where the visibility buffer is empty
     VkClearValue clearValueColor = {0.1f, 0.1f, 0.1f, 1.0f};
+    // the gbuffer shaders write a w of 1, so 0 marks background for shading
+    VkClearValue clearValueWorld = {0.1f, 0.1f, 0.1f, 0.0f};
+    VkClearValue clearValueMatid = {0};
+    VkClearValue clearValueDepth = {1.0, 0};
+
+    VkClearValue clears[] = {clearValueWorld, clearValueColor, clearValueColor,
+                             clearValueMatid, clearValueDepth};
+
+    const VkCommandBuffer draws =
+        cachedGbufferDraws(r, scene, frameIndex, viewport, area,
+                           DRAWS_GBUFFER);
+
+    const uint8_t v = r->viewCount - 1;
+    VkRenderPass  renderPass = shared.gbufferRenderPass[v];
+    if (r->visibilityBuffer)
+        renderPass = shared.gbufferLoadRenderPass[v];
+    else if (r->depthPrepass)
+        renderPass = shared.gbufferPrepassedRenderPass[v];
 
     VkRenderPassBeginInfo rpassInfo = {
         .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-        .clearValueCount = 1,
-        .pClearValues    = &clearValueColor,
-        .renderArea      = {{0, 0}, {windowWidth, windowHeight}},
-        .renderPass      = deferredRenderPass,
-        .framebuffer     = swapImageBuffer[frameIndex]};
+        .clearValueCount = LEN(clears),
+        .pClearValues    = clears,
+        .renderArea      = area,
+        .renderPass      = renderPass,
+        .framebuffer     = frameGbuffer(r, frameIndex)->framebuffer};
 
-    vkCmdBeginRenderPass(cmdBuf, &rpassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(cmdBuf, &rpassInfo,
+                         VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    vkCmdExecuteCommands(cmdBuf, 1, &draws);
+    vkCmdEndRenderPass(cmdBuf);
+}
 
-    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                      defferedPipeline);
+// clears the visibility buffer and depth inside area and draws the packed
+// geometry there
+static void
+generateVisibility(WoadRenderer* r, VkCommandBuffer cmdBuf,
+                   const OnyxScene* scene, const uint32_t frameIndex,
+                   VkRect2D viewport, VkRect2D area)
+{
+    const VkClearValue clears[] = {{.color = {.uint32 = {0, 0, 0, 0}}},
+                                   {.depthStencil = {1.0, 0}}};
 
-    vkCmdDraw(cmdBuf, 3, 1, 0, 0);
+    const VkCommandBuffer draws =
+        cachedGbufferDraws(r, scene, frameIndex, viewport, area,
+                           DRAWS_VISIBILITY);
+
+    const VkRenderPassBeginInfo rpassInfo = {
+        .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .clearValueCount = LEN(clears),
+        .pClearValues    = clears,
+        .renderArea      = area,
+        .renderPass      = shared.visibilityRenderPass[r->viewCount - 1],
+        .framebuffer = frameGbuffer(r, frameIndex)->visibilityFramebuffer};
 
+    vkCmdBeginRenderPass(cmdBuf, &rpassInfo,
+                         VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    vkCmdExecuteCommands(cmdBuf, 1, &draws);
     vkCmdEndRenderPass(cmdBuf);
 }
 
+// clears depth inside area and fills it with everything drawn there, for
+// the gbuffer pass, or the light culling and the forward pass, to test
+// against
 static void
-sortPipelinePrims(const OnyxScene* scene)
+depthPrepass(WoadRenderer* r, VkCommandBuffer cmdBuf, const OnyxScene* scene,
+             const uint32_t frameIndex, VkRect2D viewport, VkRect2D area)
 {
-    for (int i = 0; i < GBUFFER_PIPELINE_COUNT; i++)
-    {
-        onyx_clear_prim_list(&pipelinePrimLists[i]);
-    }
-    obint                       prim_count = 0;
-    const OnyxPrimitiveHandle* prims =
-        onyx_scene_get_dirty_primitives(scene, &prim_count);
-    for (obint primId = 0; primId < prim_count; primId++)
-    {
-        AttrMask                   attrMask = 0;
-        const OnyxPrimitiveHandle handle   = prims[primId];
-        const OnyxPrimitive* prim = onyx_scene_get_primitive_const(scene, handle);
+    const VkClearValue clear = {.depthStencil = {1.0, 0}};
+
+    const VkCommandBuffer draws =
+        cachedGbufferDraws(r, scene, frameIndex, viewport, area, DRAWS_DEPTH);
+
+    const VkRenderPassBeginInfo rpassInfo = {
+        .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .clearValueCount = 1,
+        .pClearValues    = &clear,
+        .renderArea      = area,
+        .renderPass      = shared.depthRenderPass[r->viewCount - 1],
+        .framebuffer     = frameGbuffer(r, frameIndex)->depthFramebuffer};
+
+    vkCmdBeginRenderPass(cmdBuf, &rpassInfo,
+                         VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    vkCmdExecuteCommands(cmdBuf, 1, &draws);
+    vkCmdEndRenderPass(cmdBuf);
+}
+
+// clears area of the lit image to the background and shades everything
+// drawn there, each pixel only by the surface the prepass left in front
+static void
+forwardRender(WoadRenderer* r, VkCommandBuffer cmdBuf, const OnyxScene* scene,
+              const uint32_t frameIndex, VkRect2D viewport, VkRect2D area)
+{
+    const VkClearValue clears[] = {{.color = litBackground},
+                                   {.depthStencil = {1.0, 0}}};
+
+    const VkCommandBuffer draws = cachedGbufferDraws(
+        r, scene, frameIndex, viewport, area, DRAWS_FORWARD);
+
+    const VkRenderPassBeginInfo rpassInfo = {
+        .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .clearValueCount = LEN(clears),
+        .pClearValues    = clears,
+        .renderArea      = area,
+        .renderPass      = r->forwardRenderPass,
+        .framebuffer     = r->litBuffers[frameIndex]};
+
+    vkCmdBeginRenderPass(cmdBuf, &rpassInfo,
+                         VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    vkCmdExecuteCommands(cmdBuf, 1, &draws);
+    vkCmdEndRenderPass(cmdBuf);
+}
+
+// fills area of the gbuffer from the visibility buffer, a workgroup per
+// block of pixels. the viewport the visibility pass drew with turns pixels
+// back into rays through the triangles.
+static void
+resolveVisibility(WoadRenderer* r, VkCommandBuffer cmdBuf,
+                  uint32_t frameIndex, VkRect2D viewport, VkRect2D area)
+{
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      shared.resolvePipeline);
+    vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            shared.pipelineLayout, 0, 2,
+                            r->descriptorSets[frameIndex], 0, NULL);
+
+    const uint32_t region[8] = {
+        area.offset.x,         area.offset.y,
+        area.extent.width,     area.extent.height,
+        viewport.offset.x,     viewport.offset.y,
+        viewport.extent.width, viewport.extent.height};
+    vkCmdPushConstants(cmdBuf, shared.pipelineLayout, pushStages,
+                       sizeof(uint32_t) * 2, sizeof(region), region);
+
+    vkCmdDispatch(
+        cmdBuf,
+        (area.extent.width + RESOLVE_GROUP_SIZE - 1) / RESOLVE_GROUP_SIZE,
+        (area.extent.height + RESOLVE_GROUP_SIZE - 1) / RESOLVE_GROUP_SIZE,
+        r->viewCount);
+}
+
+// one launch covers every view, with the view in the launch depth. only
+// area is traced; the shader offsets the launch id by its origin.
+static void
+shadowPass(VkCommandBuffer cmdBuf, VkRect2D area, uint32_t viewCount)
+{
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
+                      shared.raytracePipeline);
+
+    const uint32_t regionOffset[2] = {area.offset.x, area.offset.y};
+    vkCmdPushConstants(cmdBuf, shared.pipelineLayout, pushStages,
+                       sizeof(uint32_t) * 2, sizeof(regionOffset),
+                       regionOffset);
+
+    vkCmdTraceRaysKHR(
+        cmdBuf, &shared.shaderBindingTable.raygen_table, &shared.shaderBindingTable.miss_table,
+        &shared.shaderBindingTable.hit_table, &shared.shaderBindingTable.callable_table,
+        area.extent.width, area.extent.height, viewCount);
+}
+
+// shades area of the lit image. the full screen triangle is cut down to it
+// by the scissor.
+static void
+deferredRender(WoadRenderer* r, VkCommandBuffer cmdBuf, VkFramebuffer framebuffer,
+               VkPipeline pipeline, VkRect2D area)
+{
+    VkRenderPassBeginInfo rpassInfo = {
+        .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderArea      = area,
+        .renderPass      = r->deferredRenderPass,
+        .framebuffer     = framebuffer};
+
+    vkCmdBeginRenderPass(cmdBuf, &rpassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdSetScissor(cmdBuf, 0, 1, &area);
+
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+    vkCmdDraw(cmdBuf, 3, 1, 0, 0);
+
+    vkCmdEndRenderPass(cmdBuf);
+}
+
+// shades area of the lit image a tile per workgroup, storing to it directly
+static void
+computeShade(WoadRenderer* r, VkCommandBuffer cmdBuf, uint32_t frameIndex,
+             VkPipeline pipeline, VkRect2D area)
+{
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            shared.pipelineLayout, 0, 2,
+                            r->descriptorSets[frameIndex], 0, NULL);
+
+    const uint32_t region[4] = {area.offset.x, area.offset.y,
+                                area.extent.width, area.extent.height};
+    vkCmdPushConstants(cmdBuf, shared.pipelineLayout, pushStages,
+                       sizeof(uint32_t) * 2, sizeof(region), region);
+
+    vkCmdDispatch(cmdBuf, (area.extent.width + TILE_SIZE - 1) / TILE_SIZE,
+                  (area.extent.height + TILE_SIZE - 1) / TILE_SIZE,
+                  r->viewCount);
+}
+
+// finds the lights reaching each tile over area, a workgroup per tile.
+// tiles are aligned to the framebuffer rather than to area, so one more
+// column or row is dispatched when area starts partway into a tile.
+static void
+cullLights(WoadRenderer* r, VkCommandBuffer cmdBuf, uint32_t frameIndex,
+           VkRect2D viewport, VkRect2D area)
+{
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      shared.lightCullPipeline);
+    vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            shared.pipelineLayout, 0, 2,
+                            r->descriptorSets[frameIndex], 0, NULL);
+
+    const uint32_t region[8] = {
+        area.offset.x,         area.offset.y,
+        area.extent.width,     area.extent.height,
+        viewport.offset.x,     viewport.offset.y,
+        viewport.extent.width, viewport.extent.height};
+    vkCmdPushConstants(cmdBuf, shared.pipelineLayout, pushStages,
+                       sizeof(uint32_t) * 2, sizeof(region), region);
+
+    const uint32_t x = area.offset.x, y = area.offset.y;
+    vkCmdDispatch(cmdBuf,
+                  (x + area.extent.width + TILE_SIZE - 1) / TILE_SIZE -
+                      x / TILE_SIZE,
+                  (y + area.extent.height + TILE_SIZE - 1) / TILE_SIZE -
+                      y / TILE_SIZE,
+                  r->viewCount);
+}
+
+// the composite with dynamic rendering, so there is no render pass or
+// framebuffer per swapchain image. the frame graph moves the image in and out
+// of the attachment layout.
+static void
+compositeRenderDynamic(WoadRenderer* r, VkCommandBuffer cmdBuf,
+                       const WoadFrame* frame)
+{
+    const VkRenderingAttachmentInfo color = {
+        .sType       = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .imageView   = frame->view,
+        .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .loadOp      = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .storeOp     = VK_ATTACHMENT_STORE_OP_STORE};
+    const VkRenderingInfo renderingInfo = {
+        .sType                = VK_STRUCTURE_TYPE_RENDERING_INFO,
+        .renderArea           = {{0, 0}, {frame->width, frame->height}},
+        .layerCount           = 1,
+        .colorAttachmentCount = 1,
+        .pColorAttachments    = &color};
+
+    vkCmdBeginRendering(cmdBuf, &renderingInfo);
+    onyx_cmd_set_viewport_scissor(cmdBuf, 0, 0, frame->width, frame->height);
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      r->compositePipeline);
+    vkCmdDraw(cmdBuf, 3, 1, 0, 0);
+    vkCmdEndRendering(cmdBuf);
+}
+
+// copies the whole lit image into the swapchain image
+static void
+compositeRender(WoadRenderer* r, VkCommandBuffer cmdBuf,
+                VkFramebuffer framebuffer, uint32_t width, uint32_t height)
+{
+    VkRenderPassBeginInfo rpassInfo = {
+        .sType      = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderArea = {{0, 0}, {width, height}},
+        .renderPass = r->compositeRenderPass,
+        .framebuffer = framebuffer};
+
+    vkCmdBeginRenderPass(cmdBuf, &rpassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    onyx_cmd_set_viewport_scissor(cmdBuf, 0, 0, width, height);
+
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      r->compositePipeline);
+
+    vkCmdDraw(cmdBuf, 3, 1, 0, 0);
+
+    vkCmdEndRenderPass(cmdBuf);
+}
+
+static uint64_t
+drawKeyGeo(const OnyxGeometry* geo)
+{
+    // geometry has no stable id of its own. hashing the pointer is enough to
+    // group identical geometry; a collision only costs an extra bind.
+    // packed geometry only binds per block, so it is grouped by that.
+    uint64_t h = geoPacked(geo) ? (uint64_t)(uintptr_t)geo->index_region.buffer
+                                : (uint64_t)(uintptr_t)geo;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h & DRAW_KEY_FIELD_MASK;
+}
+
+static uint64_t
+drawKeyDepth(const Mat4* view, const OnyxPrimitive* prim)
+{
+    // view space depth of the prim origin. camera looks down -z.
+    const float* v = view->e;
+    const float* p = &prim->xform.e[12];
+    float depth = -(v[2] * p[0] + v[6] * p[1] + v[10] * p[2] + v[14]);
+    if (!(depth > 0.0f))
+        depth = 0.0f;
+    // positive floats order the same as their bit patterns, so the top bits
+    // make a logarithmic depth bucket without needing near/far.
+    uint32_t bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    return (bits >> 7) & DRAW_KEY_DEPTH_MASK;
+}
+
+static void
+radixSortDraws(Draw* draws, Draw* scratch, uint32_t count)
+{
+    Draw* src = draws;
+    Draw* dst = scratch;
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        uint32_t offsets[256] = {0};
+        for (uint32_t i = 0; i < count; i++)
+            offsets[(src[i].key >> shift) & 0xff]++;
+        // all keys share this byte, nothing to do
+        if (offsets[(src[0].key >> shift) & 0xff] == count)
+            continue;
+        uint32_t sum = 0;
+        for (int b = 0; b < 256; b++)
+        {
+            uint32_t c = offsets[b];
+            offsets[b] = sum;
+            sum += c;
+        }
+        for (uint32_t i = 0; i < count; i++)
+            dst[offsets[(src[i].key >> shift) & 0xff]++] = src[i];
+        Draw* tmp = src;
+        src       = dst;
+        dst       = tmp;
+    }
+    if (src != draws)
+        memcpy(draws, src, sizeof(Draw) * count);
+}
+
+static void
+sortDraws(WoadRenderer* r)
+{
+    for (int i = 0; i < GBUFFER_PIPELINE_COUNT; i++)
+    {
+        DrawArray* draws = &r->pipelineDraws[i];
+        if (draws->count < 2)
+            continue;
+        if (draws->count > r->drawSortScratchCapacity)
+        {
+            r->drawSortScratchCapacity = draws->count;
+            r->drawSortScratch =
+                realloc(r->drawSortScratch, sizeof(Draw) * r->drawSortScratchCapacity);
+            assert(r->drawSortScratch);
+        }
+        radixSortDraws(draws->elems, r->drawSortScratch, draws->count);
+    }
+}
+
+// camera or transforms moved; only the depth part of the keys is stale.
+static void
+updateDrawDepths(WoadRenderer* r, const OnyxScene* scene)
+{
+    const Mat4 view = onyx_scene_get_camera_view(scene);
+    for (int i = 0; i < GBUFFER_PIPELINE_COUNT; i++)
+    {
+        DrawArray* draws = &r->pipelineDraws[i];
+        for (int d = 0; d < draws->count; d++)
+        {
+            Draw*                draw = &draws->elems[d];
+            const OnyxPrimitive* prim =
+                onyx_scene_get_primitive_const(scene, draw->prim);
+            draw->key = (draw->key & ~(uint64_t)DRAW_KEY_DEPTH_MASK) |
+                        drawKeyDepth(&view, prim);
+        }
+    }
+    sortDraws(r);
+}
+
+static void
+sortPipelinePrims(WoadRenderer* r, const OnyxScene* scene)
+{
+    for (int i = 0; i < GBUFFER_PIPELINE_COUNT; i++)
+    {
+        draw_arr_set_count(&r->pipelineDraws[i], 0);
+    }
+    prim_handle_arr_set_count(&r->instancePrims, 0);
+    const Mat4                 view = onyx_scene_get_camera_view(scene);
+    obint                       prim_count = 0;
+    const OnyxPrimitiveHandle* prims =
+        onyx_scene_get_dirty_primitives(scene, &prim_count);
+    for (obint primId = 0; primId < prim_count; primId++)
+    {
+        AttrMask                   attrMask = 0;
+        const OnyxPrimitiveHandle handle   = prims[primId];
+        const OnyxPrimitive* prim = onyx_scene_get_primitive_const(scene, handle);
         if (prim->flags & ONYX_PRIM_INVISIBLE_BIT)
             continue;
         const OnyxGeometry* geo = prim->geo;
@@ -1079,15 +3463,28 @@ sortPipelinePrims(const OnyxScene* scene)
             if (name == ONYX_ATTRIBUTE_TYPE_SIGN)
                 attrMask |= SIGN_BIT;
         }
-        if (attrMask == POS_NOR_UV_TAN_MASK)
-            onyx_add_prim_to_list(
-                handle, &pipelinePrimLists[PIPELINE_GBUFFER_POS_NOR_UV_TAN]);
+        Draw draw = {
+            .key  = drawKeyGeo(geo) << DRAW_KEY_GEO_SHIFT |
+                    (uint64_t)(prim->material.id & DRAW_KEY_FIELD_MASK)
+                        << DRAW_KEY_MAT_SHIFT |
+                    drawKeyDepth(&view, prim),
+            .prim     = handle,
+            .instance = r->instancePrims.count,
+        };
+        prim_handle_arr_push(&r->instancePrims, handle);
+        if (attrMask == POS_NOR_UV_TAN_MASK && geoPacked(geo))
+            draw_arr_push(
+                &r->pipelineDraws[PIPELINE_GBUFFER_PACKED_NOR_UV_TAN], draw);
+        else if (attrMask == POS_NOR_UV_MASK && geoPacked(geo))
+            draw_arr_push(&r->pipelineDraws[PIPELINE_GBUFFER_PACKED_NOR_UV],
+                          draw);
+        else if (attrMask == POS_NOR_UV_TAN_MASK)
+            draw_arr_push(&r->pipelineDraws[PIPELINE_GBUFFER_POS_NOR_UV_TAN],
+                          draw);
         else if (attrMask == POS_NOR_UV_MASK)
-            onyx_add_prim_to_list(handle,
-                               &pipelinePrimLists[PIPELINE_GBUFFER_POS_NOR_UV]);
+            draw_arr_push(&r->pipelineDraws[PIPELINE_GBUFFER_POS_NOR_UV], draw);
         else if (attrMask == POS_MASK)
-            onyx_add_prim_to_list(handle,
-                               &pipelinePrimLists[PIPELINE_GBUFFER_POS]);
+            draw_arr_push(&r->pipelineDraws[PIPELINE_GBUFFER_POS], draw);
         else
         {
             printf("Attributes not supported!\n");
@@ -1108,140 +3505,1185 @@ sortPipelinePrims(const OnyxScene* scene)
         //     assert(0 && "currently prims must have albedo and roughness
         //     textures");
     }
+    sortDraws(r);
+    r->drawDepthsStale = false;
+    resetLods(r, scene);
+    invalidateGbufferCache(r);
+}
+
+static bool
+rectEmpty(Rect a)
+{
+    return a.x1 <= a.x0 || a.y1 <= a.y0;
 }
 
+static Rect
+rectUnion(Rect a, Rect b)
+{
+    if (rectEmpty(a))
+        return b;
+    if (rectEmpty(b))
+        return a;
+    return (Rect){a.x0 < b.x0 ? a.x0 : b.x0, a.y0 < b.y0 ? a.y0 : b.y0,
+                  a.x1 > b.x1 ? a.x1 : b.x1, a.y1 > b.y1 ? a.y1 : b.y1};
+}
+
+// the part of a inside the region, or a zero sized rect
+static VkRect2D
+rectClip(Rect a, VkRect2D region)
+{
+    const int32_t x0 = a.x0 > region.offset.x ? a.x0 : region.offset.x;
+    const int32_t y0 = a.y0 > region.offset.y ? a.y0 : region.offset.y;
+    int32_t x1 = region.offset.x + (int32_t)region.extent.width;
+    int32_t y1 = region.offset.y + (int32_t)region.extent.height;
+    if (a.x1 < x1)
+        x1 = a.x1;
+    if (a.y1 < y1)
+        y1 = a.y1;
+    if (x1 <= x0 || y1 <= y0)
+        return (VkRect2D){{x0, y0}, {0, 0}};
+    return (VkRect2D){{x0, y0}, {x1 - x0, y1 - y0}};
+}
+
+// adds rect to what every frame slot has yet to redraw
 static void
-updateRenderCommands(VkCommandBuffer cmdBuf, const OnyxScene* scene,
-                     const WoadFrame* frame, uint32_t region_x,
-                     uint32_t region_y, uint32_t region_width,
-                     uint32_t region_height)
+markDirty(WoadRenderer* r, Rect rect)
 {
-    uint32_t frameIndex = frame->index;
-    onyx_cmd_set_viewport_scissor(cmdBuf, region_x, region_y, region_width,
-                               region_height);
+    for (int i = 0; i < r->framesInFlight; i++)
+        r->pendingRects[i] = rectUnion(r->pendingRects[i], rect);
+}
 
-    vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            pipelineLayout, 0, 2,
-                            descriptorSets[frameIndex], 0, NULL);
+// object space bounds from the host copy of the positions. geometry that
+// only lives on the device has none.
+static void
+primLocalBounds(const OnyxGeometry* geo, PrimBounds* b)
+{
+    b->boundsState = -1;
+    if (!geo->vertex_region.host_data || geo->vertex_count == 0)
+        return;
+    for (int i = 0; i < geo->templ.attribute_count; i++)
+    {
+        if (geo->templ.attribute_types[i] != ONYX_ATTRIBUTE_TYPE_POS)
+            continue;
+        const float* pos =
+            (const float*)(geo->vertex_region.host_data +
+                           (geo->attribute_offsets[i] -
+                            geo->vertex_region.offset));
+        b->min = b->max = (Vec3){{pos[0], pos[1], pos[2]}};
+        for (uint32_t v = 1; v < geo->vertex_count; v++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                const float p = pos[v * 3 + c];
+                if (p < b->min.e[c])
+                    b->min.e[c] = p;
+                if (p > b->max.e[c])
+                    b->max.e[c] = p;
+            }
+        }
+        b->boundsState = 1;
+        return;
+    }
+}
 
-    uint32_t light_count = onyx_scene_get_light_count(scene);
-    vkCmdPushConstants(
-        cmdBuf, pipelineLayout,
-        VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR,
-        sizeof(Mat4) + sizeof(uint32_t) * 2, sizeof(uint32_t), &light_count);
+// column major a * b
+static Mat4
+mat4Mult(const Mat4* a, const Mat4* b)
+{
+    Mat4 m;
+    for (int c = 0; c < 4; c++)
+        for (int row = 0; row < 4; row++)
+        {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; k++)
+                sum += a->e[k * 4 + row] * b->e[c * 4 + k];
+            m.e[c * 4 + row] = sum;
+        }
+    return m;
+}
 
-    // ensures that previous frame has already read gbuffer, by ensuring that
-    // all previous commands have completed fragment shader reads.
-    // we could potentially be more fine-grained by using a VkEvent
-    // to wait specifically for that exact read to happen.
-    onyx_v_MemoryBarrier(cmdBuf, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-                         VK_DEPENDENCY_BY_REGION_BIT, VK_ACCESS_SHADER_READ_BIT,
-                         VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+// the pixels the prim's bounds cover with the given xform, over every view.
+// false if any corner is behind a camera, in which case we can't say.
+static bool
+primScreenRect(WoadRenderer* r, const Mat4* xform, const PrimBounds* b,
+               VkRect2D region, Rect* out)
+{
+    const Camera* cams = (const Camera*)r->cameraMirror.elems;
+    Rect          rect = {0};
+    for (int v = 0; v < r->viewCount; v++)
+    {
+        const Mat4 viewModel = mat4Mult(&cams[v].view, xform);
+        const Mat4 mvp       = mat4Mult(&cams[v].proj, &viewModel);
+        for (int corner = 0; corner < 8; corner++)
+        {
+            const float p[3] = {corner & 1 ? b->max.x : b->min.x,
+                                corner & 2 ? b->max.y : b->min.y,
+                                corner & 4 ? b->max.z : b->min.z};
+            float clip[4];
+            for (int row = 0; row < 4; row++)
+                clip[row] = mvp.e[row] * p[0] + mvp.e[4 + row] * p[1] +
+                            mvp.e[8 + row] * p[2] + mvp.e[12 + row];
+            if (clip[3] <= 1e-5f)
+                return false;
+            const float x = region.offset.x + (clip[0] / clip[3] * 0.5f + 0.5f) *
+                                                  region.extent.width;
+            const float y = region.offset.y + (clip[1] / clip[3] * 0.5f + 0.5f) *
+                                                  region.extent.height;
+            // pad for rasterization and filtering at the edges
+            const Rect px = {(int32_t)x - 2, (int32_t)y - 2, (int32_t)x + 3,
+                             (int32_t)y + 3};
+            rect = rectUnion(rect, px);
+        }
+    }
+    *out = rect;
+    return true;
+}
 
-    generateGBuffer(cmdBuf, scene, frameIndex, frame->width, frame->height);
+// starts tracking the prims from scratch. called when the prim list changes.
+static void
+resetPrimBounds(WoadRenderer* r, const OnyxScene* scene)
+{
+    obint                prim_count = 0;
+    const OnyxPrimitive* prims = onyx_scene_get_primitives(scene, &prim_count);
+    if (prim_count > r->primBoundsCapacity)
+    {
+        r->primBounds = realloc(r->primBounds, sizeof(PrimBounds) * prim_count);
+        assert(r->primBounds);
+        r->primBoundsCapacity = prim_count;
+    }
+    for (obint i = 0; i < prim_count; i++)
+        r->primBounds[i] = (PrimBounds){.xform = prims[i].xform};
+    r->primBoundsCount = prim_count;
+}
 
-    if (!raytracing_disabled)
+// marks where each moved prim was and now is. anything we can't bound
+// dirties the whole frame.
+static void
+markMovedPrims(WoadRenderer* r, const OnyxScene* scene, VkRect2D region)
+{
+    obint                prim_count = 0;
+    const OnyxPrimitive* prims = onyx_scene_get_primitives(scene, &prim_count);
+    if (prim_count != r->primBoundsCount)
+    {
+        resetPrimBounds(r, scene);
+        markDirty(r, RECT_FULL);
+        return;
+    }
+    for (obint i = 0; i < prim_count; i++)
     {
-        onyx_v_MemoryBarrier(
-            cmdBuf, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-            VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0,
-            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+        PrimBounds* b = &r->primBounds[i];
+        if (memcmp(&b->xform, &prims[i].xform, sizeof(Mat4)) == 0)
+            continue;
+        if (b->boundsState == 0)
+            primLocalBounds(prims[i].geo, b);
+        Rect before, after;
+        if (b->boundsState < 0 ||
+            !primScreenRect(r, &b->xform, b, region, &before) ||
+            !primScreenRect(r, &prims[i].xform, b, region, &after))
+            markDirty(r, RECT_FULL);
+        else if (!(prims[i].flags & ONYX_PRIM_INVISIBLE_BIT))
+            markDirty(r, rectUnion(before, after));
+        else
+            markDirty(r, before);
+        b->xform = prims[i].xform;
+        // its shadow may move on screen even if the prim itself isn't
+        if (!r->raytracing_disabled)
+            for (int f = 0; f < r->framesInFlight; f++)
+                r->shadowsMoved[f] = true;
+    }
+}
 
-        vkCmdBindDescriptorSets(
-            cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipelineLayout, 0,
-            2, descriptorSets[frameIndex], 0, NULL);
+// whether this frame slot has anything to redraw
+static bool
+slotBehind(const WoadRenderer* r, uint32_t frameIndex, VkRect2D region)
+{
+    return r->shadowsMoved[frameIndex] ||
+           rectClip(r->pendingRects[frameIndex], region).extent.width > 0;
+}
+
+// what the frame graph's passes need from woad_Render
+typedef struct {
+    WoadRenderer*    r;
+    const OnyxScene* scene;
+    const WoadFrame* frame;
+    uint32_t         frameIndex;
+    VkRect2D         region;
+    VkRect2D         dirty;
+    VkRect2D         shade;
+} FramePasses;
+
+static void
+recordVisibilityPass(VkCommandBuffer cmdbuf, void* data)
+{
+    const FramePasses* f = data;
+    generateVisibility(f->r, cmdbuf, f->scene, f->frameIndex, f->region,
+                       f->dirty);
+}
 
-        shadowPass(cmdBuf, frameIndex, region_width, region_height);
+static void
+recordResolvePass(VkCommandBuffer cmdbuf, void* data)
+{
+    const FramePasses* f = data;
+    resolveVisibility(f->r, cmdbuf, f->frameIndex, f->region, f->dirty);
+}
 
-        onyx_v_MemoryBarrier(
-            cmdBuf, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
-            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-            VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+static void
+recordGbufferPass(VkCommandBuffer cmdbuf, void* data)
+{
+    const FramePasses* f = data;
+    generateGBuffer(f->r, cmdbuf, f->scene, f->frameIndex, f->region,
+                    f->dirty);
+}
+
+static void
+recordShadowPass(VkCommandBuffer cmdbuf, void* data)
+{
+    const FramePasses* f = data;
+    vkCmdBindDescriptorSets(cmdbuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
+                            shared.pipelineLayout, 0, 2,
+                            f->r->descriptorSets[f->frameIndex], 0, NULL);
+    shadowPass(cmdbuf, f->shade, f->r->viewCount);
+}
+
+static void
+recordDeferredPass(VkCommandBuffer cmdbuf, void* data)
+{
+    const FramePasses* f        = data;
+    const VkPipeline   pipeline = deferredPermutation(f->r, f->scene);
+    if (f->r->computeShading)
+        computeShade(f->r, cmdbuf, f->frameIndex, pipeline, f->shade);
+    else
+        deferredRender(f->r, cmdbuf, f->r->litBuffers[f->frameIndex],
+                       pipeline, f->shade);
+}
+
+static void
+recordPrepass(VkCommandBuffer cmdbuf, void* data)
+{
+    const FramePasses* f = data;
+    depthPrepass(f->r, cmdbuf, f->scene, f->frameIndex, f->region,
+                 f->r->forward ? f->shade : f->dirty);
+}
+
+static void
+recordLightCullPass(VkCommandBuffer cmdbuf, void* data)
+{
+    const FramePasses* f = data;
+    cullLights(f->r, cmdbuf, f->frameIndex, f->region, f->shade);
+}
+
+static void
+recordForwardPass(VkCommandBuffer cmdbuf, void* data)
+{
+    const FramePasses* f = data;
+    forwardRender(f->r, cmdbuf, f->scene, f->frameIndex, f->region, f->shade);
+}
+
+static void
+recordCompositePass(VkCommandBuffer cmdbuf, void* data)
+{
+    const FramePasses* f = data;
+    if (f->r->dynamicRendering)
+        compositeRenderDynamic(f->r, cmdbuf, f->frame);
+    else
+        compositeRender(f->r, cmdbuf, f->r->swapImageBuffer[f->frame->index],
+                        f->frame->width, f->frame->height);
+}
+
+// the ring entry this frame reads back into, grown or shrunk to size. it
+// last held the frame ring size renders ago, which has completed.
+static Readback*
+readbackTarget(WoadRenderer* r, VkDeviceSize size)
+{
+    Readback* rb = &r->readbacks[r->renderCount % r->readbackRingSize];
+    if (rb->info.size != size)
+    {
+        if (rb->info.size > 0)
+            onyx_free_buffer(&rb->buffer);
+        // read on the host, so it lives there
+        rb->buffer = onyx_request_buffer_region(
+            r->memory, size,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            ONYX_MEMORY_HOST_GRAPHICS_TYPE);
+    }
+    rb->info = (WoadReadback){.data  = rb->buffer.host_data,
+                              .size  = size,
+                              .frame = r->renderCount};
+    return rb;
+}
+
+static void
+recordReadbackCopyPass(VkCommandBuffer cmdbuf, void* data)
+{
+    const FramePasses*  f     = data;
+    WoadRenderer*       r     = f->r;
+    const LayeredImage* lit   = &r->litImages[f->frameIndex];
+    // the lit image is bucket sized, only the frame's corner is read
+    const uint32_t      w     = f->frame->width;
+    const uint32_t      h     = f->frame->height;
+    const uint32_t      texel =
+        r->litFormat == VK_FORMAT_R16G16B16A16_SFLOAT ? 8 : 4;
+    const VkDeviceSize  layerPitch = (VkDeviceSize)w * h * texel;
+
+    Readback* rb        = readbackTarget(r, layerPitch * r->viewCount);
+    rb->info.width      = w;
+    rb->info.height     = h;
+    rb->info.format     = r->litFormat;
+    rb->info.rowPitch   = w * texel;
+    rb->info.layerCount = r->viewCount;
+    rb->info.layerPitch = layerPitch;
+
+    const VkBufferImageCopy copy = {
+        .bufferOffset     = rb->buffer.offset,
+        .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, r->viewCount},
+        .imageExtent      = {w, h, 1}};
+    vkCmdCopyImageToBuffer(cmdbuf, lit->handle,
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           rb->buffer.buffer, 1, &copy);
+    onyx_v_MemoryBarrier(cmdbuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT);
+}
+
+// converts the lit image to nv12 straight into the ring entry, a 4x2 pixel
+// block per invocation
+static void
+recordReadbackConvertPass(VkCommandBuffer cmdbuf, void* data)
+{
+    const FramePasses*  f   = data;
+    WoadRenderer*       r   = f->r;
+    const uint32_t      w   = f->frame->width;
+    const uint32_t      h   = f->frame->height;
+    // whole words per row, and luma rows padded to whole chroma rows
+    const uint32_t pitch    = (w + 3) & ~3u;
+    const uint32_t lumaRows = (h + 1) & ~1u;
+
+    Readback* rb = readbackTarget(r, (VkDeviceSize)pitch * lumaRows * 3 / 2);
+    rb->info.width      = w;
+    rb->info.height     = h;
+    rb->info.format     = VK_FORMAT_G8_B8R8_2PLANE_420_UNORM;
+    rb->info.rowPitch   = pitch;
+    rb->info.layerCount = 1;
+    rb->info.layerPitch = rb->info.size;
+
+    // the main set's buffer bindings are update-after-bind, and this slot's
+    // set isn't in flight
+    const VkDescriptorBufferInfo bufferInfo = {.buffer = rb->buffer.buffer,
+                                               .offset = rb->buffer.offset,
+                                               .range  = rb->info.size};
+    const VkWriteDescriptorSet   write      = {
+        .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet          = r->descriptorSets[f->frameIndex][DESC_SET_MAIN],
+        .dstBinding      = 7,
+        .descriptorCount = 1,
+        .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo     = &bufferInfo};
+    vkUpdateDescriptorSets(r->device, 1, &write, 0, NULL);
+
+    vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      shared.readbackPipeline);
+    vkCmdBindDescriptorSets(cmdbuf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            shared.pipelineLayout, 0, 2,
+                            r->descriptorSets[f->frameIndex], 0, NULL);
+    const uint32_t push[4] = {w, h, pitch, r->litLinear};
+    vkCmdPushConstants(cmdbuf, shared.pipelineLayout, pushStages, 0,
+                       sizeof(push), push);
+    vkCmdDispatch(cmdbuf, (pitch / 4 + 7) / 8, (lumaRows / 2 + 7) / 8, 1);
+    onyx_v_MemoryBarrier(cmdbuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT);
+}
+
+// hands the caller the readback of a frame that has completed, if it was
+// read back
+static void
+deliverReadback(WoadRenderer* r, uint64_t frame)
+{
+    const Readback* rb = &r->readbacks[frame % r->readbackRingSize];
+    if (rb->info.frame == frame)
+        r->readbackFn(r->readbackUser, &rb->info);
+}
+
+// declares the passes that render with this gbuffer. the depth buffer is
+// only used by the visibility and gbuffer passes, or the forward mode's
+// passes, the visibility buffer only up to its resolve, and with ray
+// tracing the shadow pass refills the whole shadow image every frame that
+// reads it, so all are transient and can share memory.
+static void
+initFrameGraph(WoadRenderer* r, GBuffer* gbuf)
+{
+    VkPhysicalDeviceMemoryProperties memProps;
+    vkGetPhysicalDeviceMemoryProperties(r->instance->physical_device,
+                                        &memProps);
+    RenderGraph* g = &gbuf->graph;
+    // only dynamic rendering requires the feature
+    graph_Init(g, r->device, &memProps, r->dynamicRendering);
+
+    const VkImageAspectFlags color   = VK_IMAGE_ASPECT_COLOR_BIT;
+    const VkImageLayout      general = VK_IMAGE_LAYOUT_GENERAL;
+    const GraphImage gbufferImages[] = {GRAPH_WORLD_P, GRAPH_NORMAL,
+                                        GRAPH_ALBEDO, GRAPH_ROUGHNESS};
+    for (int i = 0; i < LEN(gbufferImages); i++)
+        graph_ImportImage(g, color);
+    // the forward mode's light culling samples it
+    graph_CreateImage(g, depthFormat,
+                      VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                          (r->forward ? VK_IMAGE_USAGE_SAMPLED_BIT : 0),
+                      VK_IMAGE_ASPECT_DEPTH_BIT, r->viewCount);
+    // never bound without the visibility buffer mode, whose passes don't run
+    if (r->visibilityBuffer)
+        graph_CreateImage(g, formatImageVisibility,
+                          VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                              VK_IMAGE_USAGE_STORAGE_BIT,
+                          color, r->viewCount);
+    else
+        graph_ImportImage(g, color);
+    // the forward mode traces its shadows in the forward pass instead
+    if (r->raytracing_disabled || r->forward)
+        graph_ImportImage(g, color);
+    else
+        graph_CreateImage(g, formatImageShadow, VK_IMAGE_USAGE_STORAGE_BIT,
+                          color, r->viewCount);
+    graph_ImportImage(g, color);
+    graph_ImportImage(g, color);
+    const GraphImage last = graph_ImportImage(g, color);
+    assert(last == GRAPH_TILE_LIGHTS);
+
+    // multiview callers read the lit image themselves, and a readback
+    // copy may leave it elsewhere
+    graph_ExportImage(g, GRAPH_LIT, r->litLayout);
+    if (r->dynamicRendering)
+        graph_ExportImage(g, GRAPH_SWAPCHAIN, r->finalColorLayout);
+
+    // declared without the visibility buffer mode too, they just never run
+    GraphPass pass = graph_AddPass(g, recordVisibilityPass, false);
+    graph_Write(g, pass, GRAPH_VISIBILITY,
+                VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    graph_Write(g, pass, GRAPH_DEPTH,
+                VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+                    VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+    assert(pass == GRAPH_PASS_VISIBILITY);
+
+    pass = graph_AddPass(g, recordResolvePass, false);
+    graph_Read(g, pass, GRAPH_VISIBILITY,
+               VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+               VK_ACCESS_2_SHADER_STORAGE_READ_BIT, general);
+    for (int i = 0; i < LEN(gbufferImages); i++)
+        graph_Write(g, pass, gbufferImages[i],
+                    VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, general);
+    assert(pass == GRAPH_PASS_RESOLVE);
+
+    // run before the gbuffer pass when its prepass is on, and in the
+    // forward mode
+    pass = graph_AddPass(g, recordPrepass, false);
+    graph_Write(g, pass, GRAPH_DEPTH,
+                VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+                    VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+    assert(pass == GRAPH_PASS_PREPASS);
+
+    pass = graph_AddPass(g, recordGbufferPass, false);
+    for (int i = 0; i < LEN(gbufferImages); i++)
+        graph_Write(g, pass, gbufferImages[i],
+                    VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT |
+                        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                    general);
+    graph_Write(g, pass, GRAPH_DEPTH,
+                VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+                    VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+    assert(pass == GRAPH_PASS_GBUFFER);
+
+    // every mode declares every pass so the indices hold, but only the
+    // mode's own passes get accesses. the others are culled, which keeps
+    // depth's lifetime, and the memory it can share, to the passes that run.
+    // declared without ray tracing too, it just never runs
+    pass = graph_AddPass(g, recordShadowPass, false);
+    if (!r->forward)
+    {
+        graph_Read(g, pass, GRAPH_WORLD_P,
+                   VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                   VK_ACCESS_2_SHADER_STORAGE_READ_BIT, general);
+        graph_Read(g, pass, GRAPH_NORMAL,
+                   VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                   VK_ACCESS_2_SHADER_STORAGE_READ_BIT, general);
+        graph_Write(g, pass, GRAPH_SHADOW,
+                    VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                    VK_ACCESS_2_SHADER_STORAGE_READ_BIT |
+                        VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                    general);
+    }
+    assert(pass == GRAPH_PASS_SHADOW);
+
+    const VkPipelineStageFlags2 shadeStage =
+        r->computeShading ? VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
+                          : VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+    pass = graph_AddPass(g, recordDeferredPass, false);
+    if (!r->forward)
+    {
+        for (int i = 0; i < LEN(gbufferImages); i++)
+            graph_Read(g, pass, gbufferImages[i], shadeStage,
+                       VK_ACCESS_2_SHADER_STORAGE_READ_BIT, general);
+        graph_Read(g, pass, GRAPH_SHADOW, shadeStage,
+                   VK_ACCESS_2_SHADER_STORAGE_READ_BIT, general);
+        if (r->computeShading)
+            graph_Write(g, pass, GRAPH_LIT, shadeStage,
+                        VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, general);
+        else
+            graph_Write(g, pass, GRAPH_LIT,
+                        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                        VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT |
+                            VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                        r->litLayout);
+    }
+    assert(pass == GRAPH_PASS_DEFERRED);
+
+    pass = graph_AddPass(g, recordLightCullPass, false);
+    if (r->forward)
+    {
+        graph_Read(g, pass, GRAPH_DEPTH,
+                   VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                   VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+                   VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+        graph_Write(g, pass, GRAPH_TILE_LIGHTS,
+                    VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, general);
     }
+    assert(pass == GRAPH_PASS_LIGHT_CULL);
+
+    pass = graph_AddPass(g, recordForwardPass, false);
+    if (r->forward)
+    {
+        graph_Read(g, pass, GRAPH_DEPTH,
+                   VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+                       VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                   VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+                   VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+        graph_Read(g, pass, GRAPH_TILE_LIGHTS,
+                   VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+                   VK_ACCESS_2_SHADER_STORAGE_READ_BIT, general);
+        graph_Write(g, pass, GRAPH_LIT,
+                    VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, r->litLayout);
+    }
+    assert(pass == GRAPH_PASS_FORWARD);
+
+    // culled with multiview. with a render pass it writes the swapchain
+    // image outside the graph's view, so it counts as an output.
+    pass = graph_AddPass(g, recordCompositePass,
+                         r->viewCount == 1 && !r->dynamicRendering);
+    graph_Read(g, pass, GRAPH_LIT, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+               VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, r->litLayout);
+    if (r->dynamicRendering)
+        graph_Write(g, pass, GRAPH_SWAPCHAIN,
+                    VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    assert(pass == GRAPH_PASS_COMPOSITE);
+
+    // the readback passes write host buffers outside the graph's view
+    pass = graph_AddPass(g, recordReadbackCopyPass, true);
+    graph_Read(g, pass, GRAPH_LIT, VK_PIPELINE_STAGE_2_COPY_BIT,
+               VK_ACCESS_2_TRANSFER_READ_BIT,
+               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    assert(pass == GRAPH_PASS_READBACK_COPY);
+
+    pass = graph_AddPass(g, recordReadbackConvertPass, true);
+    graph_Read(g, pass, GRAPH_LIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+               VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, r->litLayout);
+    assert(pass == GRAPH_PASS_READBACK_CONVERT);
+
+    graph_Compile(g);
+}
+
+// returns false if nothing needed redrawing and only the composite was
+// recorded
+static bool
+updateRenderCommands(WoadRenderer* r, VkCommandBuffer cmdBuf, const OnyxScene* scene,
+                     const WoadFrame* frame, uint32_t frameIndex,
+                     VkRect2D region)
+{
+    // the gbuffer is redrawn where this slot is behind. shading reads ray
+    // traced shadows, which a moved prim can cast anywhere, even from off
+    // screen, so with ray tracing the whole region is reshaded.
+    const bool     redraw = slotBehind(r, frameIndex, region);
+    const VkRect2D dirty  = rectClip(r->pendingRects[frameIndex], region);
+    const VkRect2D shade  = r->raytracing_disabled ? dirty : region;
+    r->pendingRects[frameIndex] = (Rect){0};
+    r->shadowsMoved[frameIndex] = false;
 
     vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            pipelineLayout, 0, 2,
-                            descriptorSets[frameIndex], 0, NULL);
+                            shared.pipelineLayout, 0, 2,
+                            r->descriptorSets[frameIndex], 0, NULL);
 
-    // viewport.height = windowHeight;
-    // viewport.y = 0;
+    // batches render without a swapchain image
+    uint32_t passes = frame->image ? 1u << GRAPH_PASS_COMPOSITE : 0;
+    if (redraw)
+    {
+        onyx_cmd_set_viewport_scissor(cmdBuf, region.offset.x, region.offset.y,
+                                      region.extent.width, region.extent.height);
+
+        uint32_t light_count = onyx_scene_get_light_count(scene);
+        vkCmdPushConstants(cmdBuf, shared.pipelineLayout, pushStages, 0,
+                           sizeof(uint32_t), &light_count);
+
+        // the forward mode keeps no gbuffer, so it draws all it shades
+        if (r->forward && shade.extent.width > 0)
+            passes |= 1u << GRAPH_PASS_PREPASS |
+                      1u << GRAPH_PASS_LIGHT_CULL | 1u << GRAPH_PASS_FORWARD;
+        if (!r->forward)
+            passes |= 1u << GRAPH_PASS_DEFERRED;
+        if (!r->forward && dirty.extent.width > 0 && r->visibilityBuffer)
+            passes |= 1u << GRAPH_PASS_VISIBILITY |
+                      1u << GRAPH_PASS_RESOLVE;
+        if (!r->forward && dirty.extent.width > 0 &&
+            (!r->visibilityBuffer || gbufferHasDraws(r)))
+            passes |= 1u << GRAPH_PASS_GBUFFER;
+        if (r->depthPrepass && dirty.extent.width > 0)
+            passes |= 1u << GRAPH_PASS_PREPASS;
+        if (!r->forward && !r->raytracing_disabled)
+            passes |= 1u << GRAPH_PASS_SHADOW;
+    }
+    if (r->readbackFn)
+        passes |= r->readbackFormat == WOAD_READBACK_NV12
+                      ? 1u << GRAPH_PASS_READBACK_CONVERT
+                      : 1u << GRAPH_PASS_READBACK_COPY;
+
+    // the graph remembers where the last frame with this gbuffer left the
+    // images, so a shared gbuffer waits for the previous frame's reads. new
+    // images were already made ready by prepareSlot.
+    GBuffer*     gbuf = frameGbuffer(r, frameIndex);
+    RenderGraph* g    = &gbuf->graph;
+    const LayeredImage* gbufferImages[] = {&gbuf->worldP, &gbuf->normal,
+                                           &gbuf->albedo, &gbuf->roughness};
+    for (int i = 0; !r->forward && i < LEN(gbufferImages); i++)
+        graph_BindImage(g, GRAPH_WORLD_P + i, gbufferImages[i]->handle,
+                        VK_IMAGE_LAYOUT_GENERAL, 0);
+    if (r->raytracing_disabled && !r->forward)
+        graph_BindImage(g, GRAPH_SHADOW, gbuf->shadow.handle,
+                        VK_IMAGE_LAYOUT_GENERAL, 0);
+    if (r->forward)
+        graph_BindImage(g, GRAPH_TILE_LIGHTS, gbuf->tileLights.handle,
+                        VK_IMAGE_LAYOUT_GENERAL, 0);
+    // last sampled by this slot's previous composite, or by the caller
+    graph_BindImage(g, GRAPH_LIT, r->litImages[frameIndex].handle,
+                    r->litLayout,
+                    r->viewCount == 1 ? VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT
+                                      : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+    // waiting on the acquire semaphore's stage
+    if (r->dynamicRendering)
+        graph_BindImage(g, GRAPH_SWAPCHAIN, frame->image,
+                        VK_IMAGE_LAYOUT_UNDEFINED,
+                        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+
+    // the passes that write feedback draw the dirty area, or in the forward
+    // mode the shaded one
+    const VkRect2D drawn = r->forward ? shade : dirty;
+    r->feedbackComplete[frameIndex] =
+        redraw && memcmp(&drawn, &region, sizeof(region)) == 0;
+
+    FramePasses f = {.r          = r,
+                     .scene      = scene,
+                     .frame      = frame,
+                     .frameIndex = frameIndex,
+                     .region     = region,
+                     .dirty      = dirty,
+                     .shade      = shade};
+    graph_Execute(g, cmdBuf, passes, &f);
+    return redraw;
+}
 
-    // vkCmdSetViewport(cmdBuf, 0, 1, &viewport);
+static void
+freeImages(WoadRenderer* r, GBuffer* gbuf)
+{
+    if (r->forward)
+    {
+        freeLayeredImage(r, &gbuf->tileLights);
+        return;
+    }
+    freeLayeredImage(r, &gbuf->worldP);
+    freeLayeredImage(r, &gbuf->normal);
+    if (r->raytracing_disabled)
+        freeLayeredImage(r, &gbuf->shadow);
+    freeLayeredImage(r, &gbuf->roughness);
+    freeLayeredImage(r, &gbuf->albedo);
+}
 
-    deferredRender(cmdBuf, frameIndex, frame->width, frame->height);
+// a swapchain image we haven't seen, or one that was recreated
+static void
+onDirtyFrame(WoadRenderer* r, const WoadFrame* fb)
+{
+    // multiview renders into our own layered outputs, never the swapchain,
+    // and dynamic rendering needs no framebuffer for it
+    if (r->viewCount == 1 && !r->dynamicRendering)
+    {
+        if (r->swapImageBuffer[fb->index] != VK_NULL_HANDLE)
+            retireFramebuffer(r, r->swapImageBuffer[fb->index]);
+        initSwapFramebuffer(r, fb);
+    }
+    r->swapImageVersion[fb->index] = 0;
 }
 
+// brings a frame slot's attachments to the size class of the frame before
+// anything is recorded for it. only what this slot alone uses is replaced
+// here, everything else is retired until frames in flight are done with it.
 static void
-freeImages(void)
+prepareSlot(WoadRenderer* r, VkCommandBuffer cmdbuf, uint32_t frameIndex,
+            uint32_t width, uint32_t height)
 {
-    onyx_free_image(&renderTargetDepth);
-    onyx_free_image(&imageWorldP);
-    onyx_free_image(&imageNormal);
-    onyx_free_image(&imageShadow);
-    onyx_free_image(&imageRoughness);
-    onyx_free_image(&imageAlbedo);
+    const uint32_t w = bucketSize(width);
+    const uint32_t h = bucketSize(height);
+    bool recorded = false;
+
+    GBuffer* gbuf = frameGbuffer(r, frameIndex);
+    if (gbuf->width != w || gbuf->height != h)
+    {
+        retireAttachments(r, gbuf);
+        initAttachments(r, cmdbuf, gbuf, w, h);
+        initGbufferFramebuffer(r, gbuf, w, h);
+        recorded = true;
+    }
+
+    LayeredImage* lit = &r->litImages[frameIndex];
+    bool rebind = r->slotGbufferGeneration[frameIndex] != gbuf->generation;
+    if (lit->width != w || lit->height != h)
+    {
+        if (lit->width != 0)
+        {
+            retireImage(r, lit);
+            if (!r->computeShading)
+                retireFramebuffer(r, r->litBuffers[frameIndex]);
+        }
+        initLitImage(r, cmdbuf, frameIndex, w, h);
+        if (!r->computeShading)
+            initLitFramebuffer(r, frameIndex);
+        recorded = rebind = true;
+    }
+    else if (rebind && r->forward)
+    {
+        retireFramebuffer(r, r->litBuffers[frameIndex]);
+        initLitFramebuffer(r, frameIndex);
+    }
+
+    // fresh images hold nothing from earlier frames
+    if (rebind)
+    {
+        updateSlotDescriptors(r, frameIndex);
+        r->slotGbufferGeneration[frameIndex] = gbuf->generation;
+        r->pendingRects[frameIndex]          = RECT_FULL;
+    }
+
+    // the clears and transitions above must land before any pass touches
+    // the images
+    if (recorded)
+        onyx_v_MemoryBarrier(cmdbuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+                             VK_ACCESS_TRANSFER_WRITE_BIT,
+                             VK_ACCESS_MEMORY_READ_BIT |
+                                 VK_ACCESS_MEMORY_WRITE_BIT);
 }
 
 static void
-onDirtyFrame(const WoadFrame *fb)
+mirrorReserve(UploadMirror* m, uint32_t capacity)
 {
-    static uint32_t last_width = 0, last_height = 0;
+    if (capacity <= m->capacity)
+        return;
+    uint32_t c = m->capacity ? m->capacity : 8;
+    while (c < capacity)
+        c *= 2;
+    m->elems = realloc(m->elems, (size_t)m->elem_size * c);
+    m->dirty = realloc(m->dirty, c);
+    assert(m->elems && m->dirty);
+    m->capacity = c;
+}
 
-    onyx_destroy_framebuffer(device, swapImageBuffer[fb->index]);
-    initSwapFramebuffer(fb);
+// marks every element that differs from what we last saw
+static void
+mirrorSync(UploadMirror* m, const void* src, uint32_t count, uint8_t frames)
+{
+    mirrorReserve(m, count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const uint8_t* s = (const uint8_t*)src + (size_t)i * m->elem_size;
+        uint8_t*       d = m->elems + (size_t)i * m->elem_size;
+        if (i < m->count && memcmp(d, s, m->elem_size) == 0)
+            continue;
+        memcpy(d, s, m->elem_size);
+        m->dirty[i] = frames;
+    }
+    m->count = count;
+}
 
-    if (fb->width != last_width || fb->height != last_height)
+static VkDeviceSize
+mirrorPendingBytes(const UploadMirror* m, bool all)
+{
+    VkDeviceSize n = 0;
+    for (uint32_t i = 0; i < m->count; i++)
+        if (all || m->dirty[i])
+            n += m->elem_size;
+    return n;
+}
+
+static void
+stagingReserve(WoadRenderer* r, uint32_t frameIndex, VkDeviceSize size)
+{
+    StagingBuffer* ring = &r->stagingRing[frameIndex];
+    ring->head          = 0;
+    if (size <= ring->buffer.size)
+        return;
+    VkDeviceSize s = ring->buffer.size;
+    while (s < size)
+        s *= 2;
+    onyx_free_buffer(&ring->buffer);
+    ring->buffer = onyx_request_buffer_region(
+        r->memory, s, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        ONYX_MEMORY_HOST_GRAPHICS_TYPE);
+}
+
+// copies each run of elements this frame still needs into the staging
+// buffer and records the copies into dst. all uploads everything.
+static void
+mirrorUpload(UploadMirror* m, bool all, StagingBuffer* ring,
+             const BufferRegion* dst, VkCommandBuffer cmdbuf)
+{
+    VkBufferCopy   regions[MAX_COPY_REGIONS];
+    uint32_t       region_count = 0;
+
+    uint32_t i = 0;
+    while (i < m->count)
     {
-        vkDeviceWaitIdle(device);
-        freeImages();
-        initAttachments(fb->width, fb->height);
-        onyx_destroy_framebuffer(device, gframebuffer);
-        initGbufferFramebuffer(fb->width, fb->height);
-        updateGbufferDescriptors();
+        if (!all && !m->dirty[i])
+        {
+            i++;
+            continue;
+        }
+        const uint32_t first = i;
+        while (i < m->count && (all || m->dirty[i]))
+        {
+            if (m->dirty[i])
+                m->dirty[i]--;
+            i++;
+        }
+        const VkDeviceSize offset = (VkDeviceSize)first * m->elem_size;
+        const VkDeviceSize size   = (VkDeviceSize)(i - first) * m->elem_size;
+        assert(ring->head + size <= ring->buffer.size);
+        memcpy(ring->buffer.host_data + ring->head, m->elems + offset, size);
+        regions[region_count++] = (VkBufferCopy){
+            .srcOffset = ring->buffer.offset + ring->head,
+            .dstOffset = dst->offset + offset,
+            .size      = size};
+        ring->head += size;
+        if (region_count == MAX_COPY_REGIONS)
+        {
+            vkCmdCopyBuffer(cmdbuf, ring->buffer.buffer, dst->buffer,
+                            region_count, regions);
+            region_count = 0;
+        }
     }
+    if (region_count)
+        vkCmdCopyBuffer(cmdbuf, ring->buffer.buffer, dst->buffer,
+                        region_count, regions);
+}
+
+static Camera
+viewCamera(const WoadRenderer* r, const OnyxScene* scene, int i)
+{
+    // views default to the scene camera until woad_SetViews is called
+    if (r->viewsSet)
+        return (Camera){
+            .view   = r->views[i].view,
+            .proj   = r->views[i].proj,
+            .camera = coal_invert4x4(r->views[i].view),
+        };
+    return (Camera){
+        .view   = onyx_scene_get_camera_view(scene),
+        .proj   = onyx_scene_get_camera_projection(scene),
+        .camera = onyx_scene_get_camera_xform(scene),
+    };
 }
 
 static void
-updateCamera(const OnyxScene* scene, uint32_t index)
+updateCamera(WoadRenderer* r, const OnyxScene* scene)
 {
-    Camera* uboCam = (Camera*)cameraBuffers[index].host_data;
-    uboCam->view   = onyx_scene_get_camera_view(scene);
-    uboCam->proj   = onyx_scene_get_camera_projection(scene);
+    Camera cams[MAX_VIEWS];
+    for (int i = 0; i < r->viewCount; i++)
+        cams[i] = viewCamera(r, scene, i);
     // printf("Proj:\n");
     // coal_PrintMat4(&proj);
     // printf("View:\n");
     // coal_PrintMat4(&view);
-    uboCam->camera = onyx_scene_get_camera_xform(scene);
+    mirrorSync(&r->cameraMirror, cams, r->viewCount, r->framesInFlight);
 }
 
+// picks each instance's level from how many pixels its error covers in the
+// view that sees it largest. returns whether any instance changed level.
+static bool
+selectLods(WoadRenderer* r, const OnyxScene* scene)
+{
+    const float height = r->lastRegion.extent.height;
+    if (height == 0.0f)
+        return false;
+    Vec3  eyes[MAX_VIEWS];
+    float pixelScale[MAX_VIEWS];
+    for (int v = 0; v < r->viewCount; v++)
+    {
+        const Camera cam = viewCamera(r, scene, v);
+        eyes[v]          = (Vec3){cam.camera.e[12], cam.camera.e[13],
+                                  cam.camera.e[14]};
+        // pixels per unit at a distance of 1
+        pixelScale[v] = fabsf(cam.proj.e[5]) * height * 0.5f;
+    }
+
+    bool changed = false;
+    for (uint32_t i = 0; i < r->instancePrims.count; i++)
+    {
+        InstanceLod*            lod   = &r->instanceLods[i];
+        const GeometryLodTable* table = &lod->table;
+        if (table->lodCount < 2)
+            continue;
+        const OnyxPrimitive* prim =
+            onyx_scene_get_primitive_const(scene, r->instancePrims.elems[i]);
+        const float* m = prim->xform.e;
+        float        scale = 0.0f;
+        for (int c = 0; c < 3; c++)
+        {
+            const float l = sqrtf(m[c * 4] * m[c * 4] +
+                                  m[c * 4 + 1] * m[c * 4 + 1] +
+                                  m[c * 4 + 2] * m[c * 4 + 2]);
+            scale = l > scale ? l : scale;
+        }
+        const float* o = table->center;
+        const float  center[3] = {
+            m[0] * o[0] + m[4] * o[1] + m[8] * o[2] + m[12],
+            m[1] * o[0] + m[5] * o[1] + m[9] * o[2] + m[13],
+            m[2] * o[0] + m[6] * o[1] + m[10] * o[2] + m[14]};
+
+        // world units to pixels, at the nearest point of the bounds
+        float unitPixels = 0.0f;
+        for (int v = 0; v < r->viewCount; v++)
+        {
+            const float d[3] = {center[0] - eyes[v].x, center[1] - eyes[v].y,
+                                center[2] - eyes[v].z};
+            const float dist = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]) -
+                               table->radius * scale;
+            const float p = dist > 1e-4f ? pixelScale[v] / dist : INFINITY;
+            unitPixels = p > unitPixels ? p : unitPixels;
+        }
+        const float errorScale = scale * unitPixels;
+
+        uint8_t level = lod->level;
+        while (level > 0 &&
+               table->lods[level].error * errorScale > LOD_PIXEL_ERROR)
+            level--;
+        while (level + 1 < table->lodCount &&
+               table->lods[level + 1].error * errorScale <=
+                   LOD_PIXEL_ERROR * LOD_HYSTERESIS)
+            level++;
+        if (level != lod->level)
+        {
+            lod->level = level;
+            changed    = true;
+        }
+    }
+    return changed;
+}
+
+// takes each instance slot's levels from its geometry, starting at the
+// coarsest so the first selection has nothing to hold on to
+static void
+resetLods(WoadRenderer* r, const OnyxScene* scene)
+{
+    const uint32_t count = r->instancePrims.count;
+    if (count > r->instanceLodsCapacity)
+    {
+        r->instanceLods = realloc(r->instanceLods, sizeof(InstanceLod) * count);
+        assert(r->instanceLods);
+        r->instanceLodsCapacity = count;
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const OnyxPrimitive* prim =
+            onyx_scene_get_primitive_const(scene, r->instancePrims.elems[i]);
+        InstanceLod* lod = &r->instanceLods[i];
+        *lod             = (InstanceLod){0};
+        if (!geoPacked(prim->geo))
+            continue;
+        lod->table = *geometry_Lods(prim->geo);
+        lod->level = lod->table.lodCount - 1;
+    }
+    selectLods(r, scene);
+}
+
+// refreshes the instance table from the prims behind each slot and the
+// levels they draw. only the slots that changed are uploaded.
+static void
+updateInstances(WoadRenderer* r, const OnyxScene* scene)
+{
+    const uint32_t count = r->instancePrims.count;
+    if (count > r->instanceScratchCapacity)
+    {
+        r->instanceScratch =
+            realloc(r->instanceScratch, sizeof(DrawInstance) * count);
+        assert(r->instanceScratch);
+        r->instanceScratchCapacity = count;
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const OnyxPrimitiveHandle handle = r->instancePrims.elems[i];
+        const OnyxPrimitive* prim = onyx_scene_get_primitive_const(scene, handle);
+        r->instanceScratch[i] = (DrawInstance){.xform      = prim->xform,
+                                               .materialId = prim->material.id,
+                                               .primId     = handle.id};
+        VkDeviceSize base;
+        const int    block = geometry_FindBlock(prim->geo, &base);
+        if (block >= 0)
+        {
+            DrawInstance* inst   = &r->instanceScratch[i];
+            inst->vertexBlock    = block;
+            inst->positionOffset =
+                (prim->geo->vertex_region.offset - base) / sizeof(uint32_t);
+            inst->attributeOffset =
+                (prim->geo->attribute_offsets[1] - base) / sizeof(uint32_t);
+            // every attribute after the position is packed into one word
+            inst->attributeStride = prim->geo->templ.attribute_count - 1;
+            const InstanceLod* lod = &r->instanceLods[i];
+            inst->indexOffset =
+                (prim->geo->index_region.offset - base) / sizeof(uint32_t) +
+                lod->table.lods[lod->level].firstIndex;
+        }
+    }
+    mirrorSync(&r->instancesMirror, r->instanceScratch, count,
+               r->framesInFlight);
+}
+
+// the draws use other indices, which the visibility resolve finds through
+// the instance table
 static void
-updateFastXforms(uint32_t frameIndex, uint32_t primIndex)
+onLodsChanged(WoadRenderer* r, const OnyxScene* scene)
 {
-    assert(primIndex < 16);
-    Xforms* xforms = (Xforms*)xformsBuffers[frameIndex].host_data;
-    // coal_Copy_Mat4(scene->xforms[primIndex], xforms->xform[primIndex].x);
+    invalidateGbufferCache(r);
+    updateInstances(r, scene);
 }
 
 static void
-updateLight(const OnyxScene* scene, uint32_t frameIndex, uint32_t lightIndex)
+updateLights(WoadRenderer* r, const OnyxScene* scene)
 {
+    obint       light_count;
+    OnyxLight* scene_lights = onyx_scene_get_lights(scene, &light_count);
+    assert(light_count <= MAX_LIGHT_COUNT);
+    mirrorSync(&r->lightsMirror, scene_lights, light_count, r->framesInFlight);
 }
 
 static void
-updateMaterials(const OnyxScene* scene, uint32_t frameIndex)
+updateMaterials(WoadRenderer* r, const OnyxScene* scene)
 {
     _Static_assert(sizeof(OnyxMaterial) == 4 * 8,
                    "Check shader material against OnyxMaterial\n");
     obint                matcount  = 0;
     const OnyxMaterial* materials = onyx_scene_get_materials(scene, &matcount);
-    memcpy(materialsBuffers[frameIndex].host_data, materials,
-           sizeof(Material) * matcount);
+    mirrorSync(&r->materialsMirror, materials, matcount, r->framesInFlight);
+    // the gbuffer draws were specialized to the maps materials had
+    invalidateGbufferCache(r);
+}
+
+// grows a frame's storage table to hold count elements. this frame's set
+// isn't in flight, so the table can be swapped out from under it; the
+// binding is update-after-bind. returns true if it was replaced.
+static bool
+reserveTable(WoadRenderer* r, uint32_t frameIndex, uint32_t binding,
+             uint32_t elemSize, uint32_t count, BufferRegion* buffer,
+             uint32_t* capacity)
+{
+    if (count <= *capacity)
+        return false;
+    uint32_t c = *capacity;
+    while (c < count)
+        c *= 2;
+    onyx_free_buffer(buffer);
+    *buffer = onyx_request_buffer_region(
+        r->memory, (VkDeviceSize)elemSize * c,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        ONYX_MEMORY_DEVICE_TYPE);
+    *capacity = c;
+
+    VkDescriptorBufferInfo info = {
+        .buffer = buffer->buffer, .offset = buffer->offset, .range = buffer->size};
+
+    VkWriteDescriptorSet write = {
+        .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstArrayElement = 0,
+        .dstSet          = r->descriptorSets[frameIndex][DESC_SET_MAIN],
+        .dstBinding      = binding,
+        .descriptorCount = 1,
+        .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo     = &info};
+
+    vkUpdateDescriptorSets(r->device, 1, &write, 0, NULL);
+    return true;
+}
+
+// records every pending camera, instance, light and material copy for this
+// frame, followed by a single barrier. must be outside a render pass.
+static void
+uploadDirty(WoadRenderer* r, VkCommandBuffer cmdbuf, uint32_t frameIndex)
+{
+    if (reserveTable(r, frameIndex, 4, sizeof(Material),
+                     r->materialsMirror.count, &r->materialsBuffers[frameIndex],
+                     &r->materialsCapacity[frameIndex]))
+        r->materialsReplaced[frameIndex] = true;
+    if (reserveTable(r, frameIndex, 1, sizeof(DrawInstance),
+                     r->instancesMirror.count, &r->instancesBuffers[frameIndex],
+                     &r->instancesCapacity[frameIndex]))
+        r->instancesReplaced[frameIndex] = true;
+    const bool allMaterials = r->materialsReplaced[frameIndex];
+    const bool allInstances = r->instancesReplaced[frameIndex];
+
+    VkDeviceSize size = mirrorPendingBytes(&r->cameraMirror, false) +
+                        mirrorPendingBytes(&r->instancesMirror, allInstances) +
+                        mirrorPendingBytes(&r->lightsMirror, false) +
+                        mirrorPendingBytes(&r->materialsMirror, allMaterials);
+    if (size == 0)
+        return;
+    stagingReserve(r, frameIndex, size);
+
+    StagingBuffer* ring = &r->stagingRing[frameIndex];
+    mirrorUpload(&r->cameraMirror, false, ring, &r->cameraBuffers[frameIndex],
+                 cmdbuf);
+    mirrorUpload(&r->instancesMirror, allInstances, ring,
+                 &r->instancesBuffers[frameIndex], cmdbuf);
+    r->instancesReplaced[frameIndex] = false;
+    mirrorUpload(&r->lightsMirror, false, ring, &r->lightsBuffers[frameIndex],
+                 cmdbuf);
+    mirrorUpload(&r->materialsMirror, allMaterials, ring,
+                 &r->materialsBuffers[frameIndex], cmdbuf);
+    r->materialsReplaced[frameIndex] = false;
+
+    VkPipelineStageFlags dst_stages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    if (!r->raytracing_disabled)
+        dst_stages |= VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
+    if (r->computeShading || r->visibilityBuffer || r->forward)
+        dst_stages |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    onyx_v_MemoryBarrier(cmdbuf, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stages, 0,
+                         VK_ACCESS_TRANSFER_WRITE_BIT,
+                         VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
 }
 
 // possibly because transforms changed, we only need to rebuild the tlas
 static void
-buildTlas(const OnyxScene* scene, int frame_index)
+buildTlas(WoadRenderer* r, const OnyxScene* scene, int frame_index)
 {
     HellArray xforms;
 
@@ -1250,8 +4692,8 @@ buildTlas(const OnyxScene* scene, int frame_index)
     obint                  prim_count = 0;
     const OnyxPrimitive*  prims = onyx_scene_get_primitives(scene, &prim_count);
 
-    if (tlas[frame_index].buffer_region.size != 0)
-        onyx_destroy_acceleration_struct(device, &tlas[frame_index]);
+    if (r->tlas[frame_index].buffer_region.size != 0)
+        onyx_destroy_acceleration_struct(r->device, &r->tlas[frame_index]);
 
     if (prim_count > 0)
     {
@@ -1263,245 +4705,801 @@ buildTlas(const OnyxScene* scene, int frame_index)
                 continue;
             hell_array_push(&xforms, &prims[i].xform);
         }
-        onyx_build_tlas(memory, blas_array.count, blas_array.elems, xforms.elems,
-                       &tlas[frame_index]);
+        pthread_mutex_lock(&shared.lock);
+        onyx_build_tlas(r->memory, r->blas_array.count, r->blas_array.elems,
+                        xforms.elems, &r->tlas[frame_index]);
+        pthread_mutex_unlock(&shared.lock);
     }
 
     hell_destroy_array(&xforms, NULL);
 }
 
-static void
-buildAccelerationStructures(const OnyxScene* scene)
+static BlasKey
+blasKey(const OnyxGeometry* geo)
 {
-    obint                  prim_count = 0;
-    const OnyxPrimitive*  prims = onyx_scene_get_primitives(scene, &prim_count);
+    return (BlasKey){
+        .geo          = geo,
+        .id           = geoPacked(geo) ? geometry_Lods(geo)->id : 0,
+        .vertexBuffer = geo->vertex_region.buffer,
+        .vertexOffset = geo->vertex_region.offset,
+        .indexBuffer  = geo->index_region.buffer,
+        .indexOffset  = geo->index_region.offset};
+}
 
-    for (int i = 0; i < blas_array.count; i++)
+static bool
+blasKeyEqual(const BlasKey* a, const BlasKey* b)
+{
+    return a->geo == b->geo && a->id == b->id &&
+           a->vertexBuffer == b->vertexBuffer &&
+           a->vertexOffset == b->vertexOffset &&
+           a->indexBuffer == b->indexBuffer && a->indexOffset == b->indexOffset;
+}
+
+// returns the cached blas for geo, building it on first use. must hold the
+// shared lock.
+static AccelerationStructure
+acquireBlas(WoadRenderer* r, const OnyxGeometry* geo, const BlasKey* key)
+{
+    for (int i = 0; i < shared.blasCache.count; i++)
+    {
+        BlasEntry* entry = &shared.blasCache.elems[i];
+        if (blasKeyEqual(&entry->key, key) &&
+            entry->coarse == r->coarseShadows)
+        {
+            entry->refs++;
+            return entry->blas;
+        }
+    }
+    BlasEntry entry = {.key = *key, .refs = 1, .coarse = r->coarseShadows};
+    // the same vertices with the first coarser level's indices. geometry
+    // without one is built as is but still cached as coarse.
+    OnyxGeometry coarse = *geo;
+    if (r->coarseShadows && geoPacked(geo) && geometry_Lods(geo)->lodCount > 1)
     {
-        AccelerationStructure *blas = &blas_array.elems[i];
-        onyx_destroy_acceleration_struct(device, blas);
+        const GeometryLod* level = &geometry_Lods(geo)->lods[1];
+        const VkDeviceSize skip  = sizeof(uint32_t) * level->firstIndex;
+        coarse.index_count              = level->indexCount;
+        coarse.index_region.offset     += skip;
+        coarse.index_region.host_data  += skip;
+        coarse.index_region.size        = sizeof(uint32_t) * level->indexCount;
     }
+    uint64_t   cacheKey;
+    const bool keyed =
+        r->sceneCache && key->id != 0 &&
+        cache_GeometryKey(r->sceneCache, key->id, &cacheKey);
+    if (!keyed || !cache_LoadBlas(r->sceneCache, cacheKey, r->coarseShadows,
+                                  r->memory, &entry.blas))
+    {
+        onyx_build_blas(r->memory, &coarse, &entry.blas);
+        if (keyed)
+            cache_StoreBlas(r->sceneCache, cacheKey, r->coarseShadows,
+                            r->memory, &entry.blas);
+    }
+    blas_entry_arr_push(&shared.blasCache, entry);
+    return entry.blas;
+}
 
-    accel_struct_arr_set_count(&blas_array, 0);
-
-    if (prim_count > 0)
+// key is what the blas was acquired with, as geometry may have been freed
+// since. must hold the shared lock.
+static void
+releaseBlas(const WoadRenderer* r, const BlasKey* key)
+{
+    for (int i = 0; i < shared.blasCache.count; i++)
     {
-        for (int i = 0; i < prim_count; i++)
+        BlasEntry* entry = &shared.blasCache.elems[i];
+        if (!blasKeyEqual(&entry->key, key) ||
+            entry->coarse != r->coarseShadows)
+            continue;
+        assert(entry->refs > 0);
+        if (--entry->refs == 0)
         {
-            if (prims[i].flags & ONYX_PRIM_INVISIBLE_BIT)
-                continue;
-            AccelerationStructure blas = {};
-            onyx_build_blas(memory, prims[i].geo, &blas);
-            accel_struct_arr_push(&blas_array, blas);
+            onyx_destroy_acceleration_struct(shared.device, &entry->blas);
+            *entry = shared.blasCache.elems[shared.blasCache.count - 1];
+            blas_entry_arr_set_count(&shared.blasCache,
+                                     shared.blasCache.count - 1);
         }
+        return;
+    }
+    assert(0 && "released a blas we don't hold");
+}
+
+static void
+buildAccelerationStructures(WoadRenderer* r, const OnyxScene* scene)
+{
+    obint                  prim_count = 0;
+    const OnyxPrimitive*  prims = onyx_scene_get_primitives(scene, &prim_count);
+
+    BlasKeyArray oldGeos = r->blasGeos;
+    r->blasGeos          = blas_key_arr_create(NULL);
+    accel_struct_arr_set_count(&r->blas_array, 0);
+
+    pthread_mutex_lock(&shared.lock);
+    // take the new references before dropping the old ones so geometry that
+    // stays in the scene keeps its blas
+    for (int i = 0; i < prim_count; i++)
+    {
+        if (prims[i].flags & ONYX_PRIM_INVISIBLE_BIT)
+            continue;
+        const BlasKey         key  = blasKey(prims[i].geo);
+        AccelerationStructure blas = acquireBlas(r, prims[i].geo, &key);
+        blas_key_arr_push(&r->blasGeos, key);
+        accel_struct_arr_push(&r->blas_array, blas);
     }
+    for (int i = 0; i < oldGeos.count; i++)
+        releaseBlas(r, &oldGeos.elems[i]);
+    pthread_mutex_unlock(&shared.lock);
+    blas_key_arr_free(&oldGeos);
 
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-        buildTlas(scene, i);
+    for (int i = 0; i < r->framesInFlight; ++i) {
+        buildTlas(r, scene, i);
     }
 
     printf(">>>>> Built acceleration structures\n");
 }
 
-void
-woad_Render(const OnyxScene* scene, const WoadFrame* fb, uint32_t x,
-            uint32_t y, uint32_t width, uint32_t height, VkCommandBuffer cmdbuf)
+WoadRenderResult
+woad_Render(WoadRenderer* r, const OnyxScene* scene, const WoadFrame* fb,
+            uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+            VkCommandBuffer cmdbuf)
 {
     // assert(x + width  <= fb->width);
     // assert(y + height <= fb->height);
-    static uint8_t asNeedUpdate        = 0;
-    static uint8_t cameraNeedUpdate    = MAX_FRAMES_IN_FLIGHT;
-    // static uint8_t xformsNeedUpdate    = MAX_FRAMES_IN_FLIGHT;
-    static uint8_t lightsNeedUpdate    = MAX_FRAMES_IN_FLIGHT;
-    static uint8_t texturesNeedUpdate  = MAX_FRAMES_IN_FLIGHT;
-    static uint8_t materialsNeedUpdate = MAX_FRAMES_IN_FLIGHT;
-
-    int                  frameIndex = fb->index;
+
+    const VkRect2D region = {{x, y}, {width, height}};
+    if (memcmp(&region, &r->lastRegion, sizeof(region)) != 0)
+    {
+        markDirty(r, RECT_FULL);
+        r->lastRegion = region;
+    }
+
+    const int            frameIndex = r->frameCounter;
     OnyxSceneDirtyFlags scene_dirt = onyx_scene_get_dirt(scene);
+    if (!r->mirrorsSynced)
+    {
+        scene_dirt |= ONYX_SCENE_CAMERA_VIEW_BIT | ONYX_SCENE_LIGHTS_BIT |
+                      ONYX_SCENE_MATERIALS_BIT | ONYX_SCENE_TEXTURES_BIT;
+        r->mirrorsSynced = true;
+    }
+    if (r->viewsDirty)
+    {
+        scene_dirt |= ONYX_SCENE_CAMERA_VIEW_BIT;
+        r->viewsDirty = false;
+    }
     if (scene_dirt)
     {
-        if (scene_dirt & ONYX_SCENE_CAMERA_VIEW_BIT)
-            cameraNeedUpdate = MAX_FRAMES_IN_FLIGHT;
-        if (scene_dirt & ONYX_SCENE_CAMERA_PROJ_BIT)
-            cameraNeedUpdate = MAX_FRAMES_IN_FLIGHT;
+        if (scene_dirt &
+            (ONYX_SCENE_CAMERA_VIEW_BIT | ONYX_SCENE_CAMERA_PROJ_BIT))
+            updateCamera(r, scene);
         if (scene_dirt & ONYX_SCENE_LIGHTS_BIT)
         {
-            lightsNeedUpdate = MAX_FRAMES_IN_FLIGHT;
+            updateLights(r, scene);
         }
         if (scene_dirt & ONYX_SCENE_MATERIALS_BIT)
-            materialsNeedUpdate = MAX_FRAMES_IN_FLIGHT;
+            updateMaterials(r, scene);
         if (scene_dirt & ONYX_SCENE_TEXTURES_BIT)
         {
-            texturesNeedUpdate = MAX_FRAMES_IN_FLIGHT;
+            r->texturesNeedUpdate = r->framesInFlight;
         }
+        // anything but moved prims can change every pixel
+        if (scene_dirt & ~ONYX_SCENE_XFORMS_BIT)
+            markDirty(r, RECT_FULL);
+        if (scene_dirt & ONYX_SCENE_PRIMS_BIT)
+            resetPrimBounds(r, scene);
+        else if (scene_dirt & ONYX_SCENE_XFORMS_BIT)
+            markMovedPrims(r, scene, region);
         if (scene_dirt & ONYX_SCENE_PRIMS_BIT)
         {
             printf("WOAD: PRIMS DIRTY\n");
-            sortPipelinePrims(scene);
-            if (!raytracing_disabled)
+            sortPipelinePrims(r, scene);
+            if (!r->raytracing_disabled)
             {
-                buildAccelerationStructures(scene);
-                asNeedUpdate = MAX_FRAMES_IN_FLIGHT;
+                buildAccelerationStructures(r, scene);
+                r->asNeedUpdate = r->framesInFlight;
             }
         }
         else if (scene_dirt & ONYX_SCENE_XFORMS_BIT)
         {
-            if (!raytracing_disabled)
+            if (!r->raytracing_disabled)
             {
-                asNeedUpdate = MAX_FRAMES_IN_FLIGHT;
+                r->asNeedUpdate = r->framesInFlight;
             }
         }
+        if (scene_dirt & (ONYX_SCENE_PRIMS_BIT | ONYX_SCENE_XFORMS_BIT |
+                          ONYX_SCENE_MATERIALS_BIT))
+            updateInstances(r, scene);
+        // the area a level change redraws is already dirty: all of it for
+        // a camera change, the prim's own for a move
+        if (!(scene_dirt & ONYX_SCENE_PRIMS_BIT) &&
+            (scene_dirt & (ONYX_SCENE_CAMERA_VIEW_BIT |
+                           ONYX_SCENE_CAMERA_PROJ_BIT | ONYX_SCENE_XFORMS_BIT)) &&
+            selectLods(r, scene))
+            onLodsChanged(r, scene);
+        // resorted when the draws are next recorded, which moving the
+        // camera alone doesn't require
+        if (!(scene_dirt & ONYX_SCENE_PRIMS_BIT) &&
+            (scene_dirt & (ONYX_SCENE_CAMERA_VIEW_BIT | ONYX_SCENE_XFORMS_BIT)))
+            r->drawDepthsStale = true;
     }
     if (fb->dirty)
     {
-        onDirtyFrame(fb);
+        onDirtyFrame(r, fb);
+        markDirty(r, RECT_FULL);
+        if (selectLods(r, scene))
+            onLodsChanged(r, scene);
     }
 
-    if (asNeedUpdate)
-    {
-        buildTlas(scene, frameIndex);
-        updateASDescriptors(frameIndex);
-        asNeedUpdate--;
-    }
-    if (cameraNeedUpdate)
+    // the swapchain image already shows this slot's lit image, so there is
+    // nothing to record. the slot is left for the next call.
+    if (r->onDemand && fb->image && !r->asNeedUpdate &&
+        !r->texturesNeedUpdate &&
+        !slotBehind(r, frameIndex, region) &&
+        (r->viewCount > 1 || r->swapImageVersion[fb->index] == r->litVersion))
+        return WOAD_RENDER_IDLE;
+
+    r->frameCounter   = (r->frameCounter + 1) % r->framesInFlight;
+    r->lastFrameIndex = frameIndex;
+    r->renderCount++;
+    collectRetired(r);
+    readFeedback(r, frameIndex);
+    // the frame that last used this slot has completed
+    if (r->readbackFn && r->renderCount > r->framesInFlight)
+        deliverReadback(r, r->renderCount - r->framesInFlight);
+    prepareSlot(r, cmdbuf, frameIndex, fb->width, fb->height);
+    updateGeometryBlocks(r, frameIndex);
+
+    if (r->asNeedUpdate)
     {
-        updateCamera(scene, frameIndex);
-        cameraNeedUpdate--;
+        buildTlas(r, scene, frameIndex);
+        updateASDescriptors(r, frameIndex);
+        r->asNeedUpdate--;
     }
-    if (lightsNeedUpdate)
+    if (r->texturesNeedUpdate)
     {
-        obint       light_count;
-        OnyxLight* scene_lights = onyx_scene_get_lights(scene, &light_count);
-        Lights*     lights       = (Lights*)lightsBuffers[frameIndex].host_data;
-        memcpy(lights, scene_lights, sizeof(Light) * light_count);
-        lightsNeedUpdate--;
-        printf("Tanto: lights sync\n");
-        onyx_print_light_info(scene);
+        updateTextures(r, scene, frameIndex);
+        r->texturesNeedUpdate--;
     }
-    if (materialsNeedUpdate)
-    {
-        updateMaterials(scene, frameIndex);
-        materialsNeedUpdate--;
-    }
-    if (texturesNeedUpdate) // TODO update all tex
+
+    uploadDirty(r, cmdbuf, frameIndex);
+
+    const bool redrawn =
+        updateRenderCommands(r, cmdbuf, scene, fb, frameIndex, region);
+    // the feedback is read on the host once the frame completes. the
+    // visibility resolve writes it too.
+    VkPipelineStageFlags feedbackStages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    if (r->visibilityBuffer)
+        feedbackStages |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    onyx_v_MemoryBarrier(cmdbuf, feedbackStages, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT);
+    if (redrawn)
+        r->litVersion++;
+    if (r->viewCount == 1 && fb->image)
+        r->swapImageVersion[fb->index] = r->litVersion;
+    return redrawn ? WOAD_RENDER_DRAWN : WOAD_RENDER_REUSED;
+}
+
+bool
+woad_IsIdle(const WoadRenderer* r, const OnyxScene* scene)
+{
+    if (onyx_scene_get_dirt(scene) || r->viewsDirty || !r->mirrorsSynced ||
+        r->asNeedUpdate || r->texturesNeedUpdate)
+        return false;
+    return !slotBehind(r, r->frameCounter, r->lastRegion);
+}
+
+bool
+woad_StreamTextures(WoadRenderer* r, WoadTextureStreamer* streamer,
+                    const OnyxScene* scene, VkCommandBuffer cmd)
+{
+    obint              count    = 0;
+    const OnyxTexture* textures = onyx_scene_get_textures(scene, &count);
+    if (count > MAX_TEXTURE_COUNT)
+        count = MAX_TEXTURE_COUNT;
+
+    // images replaced now may still be sampled by the frames in flight and
+    // the last one recorded
+    const bool recorded =
+        streaming_Update(streamer, r->textureDemand, r->demandComplete,
+                         textures, count, cmd, r->renderCount,
+                         r->renderCount + r->framesInFlight);
+    memset(r->textureDemand, 0, sizeof(r->textureDemand));
+    r->demandComplete = false;
+    if (recorded)
     {
-        printf("texturesNeedUpdate %d\n", texturesNeedUpdate);
-        obint               tex_count = 0;
-        const OnyxTexture* tex = onyx_scene_get_textures(scene, &tex_count);
-        // remember, 1 is the first valid texture index
-        for (int i = 0; i < tex_count; i++)
-        {
-            updateTexture(frameIndex, tex[i].dev_image, i);
-        }
-        texturesNeedUpdate--;
+        r->texturesNeedUpdate = r->framesInFlight;
+        markDirty(r, RECT_FULL);
     }
-
-    updateRenderCommands(cmdbuf, scene, fb, x, y, width, height);
+    return recorded;
 }
 
-void
+WoadRenderer*
 woad_Init(const OnyxInstance* instance_, OnyxMemory* memory_,
           VkImageLayout finalColorLayout, VkImageLayout finalDepthLayout,
-          const OnyxSwapchain *swapchain,
-          Woad_Settings_Flags flags)
+          const OnyxSwapchain *swapchain, uint8_t frames_in_flight,
+          uint8_t view_count, Woad_Settings_Flags flags)
 {
     hell_print("Creating Woad renderer...\n");
-    instance = instance_;
+    WoadRenderer* r = calloc(1, sizeof(WoadRenderer));
+    assert(r);
+    r->instance = instance_;
     if (flags & WOAD_SETTINGS_NO_RAYTRACE_BIT)
-        raytracing_disabled = true;
+        r->raytracing_disabled = true;
+    r->coarseShadows = flags & WOAD_SETTINGS_COARSE_SHADOWS_BIT;
+    r->forward = flags & WOAD_SETTINGS_FORWARD_BIT;
+    // the forward mode has no gbuffer for the other modes to shade or fill
+    r->computeShading =
+        !r->forward && (flags & WOAD_SETTINGS_COMPUTE_SHADING_BIT);
+    r->visibilityBuffer =
+        !r->forward && (flags & WOAD_SETTINGS_VISIBILITY_BUFFER_BIT);
+    if (frames_in_flight < MIN_FRAMES_IN_FLIGHT ||
+        frames_in_flight > MAX_FRAMES_IN_FLIGHT)
+    {
+        hell_print("Woad: %d frames in flight not supported, using %d\n",
+                   frames_in_flight, MIN_FRAMES_IN_FLIGHT);
+        frames_in_flight = MIN_FRAMES_IN_FLIGHT;
+    }
+    r->framesInFlight = frames_in_flight;
+    r->frameCounter   = 0;
+    r->onDemand       = flags & WOAD_SETTINGS_ON_DEMAND_BIT;
+    r->dynamicRendering =
+        (flags & WOAD_SETTINGS_DYNAMIC_RENDERING_BIT) && view_count == 1;
+    r->litVersion     = 1;
+    if (view_count < 1 || view_count > MAX_VIEWS)
+    {
+        hell_print("Woad: %d views not supported, using 1\n", view_count);
+        view_count = 1;
+    }
+    r->viewCount = view_count;
+    r->gbufferCount =
+        (flags & WOAD_SETTINGS_PER_FRAME_GBUFFER_BIT) ? r->framesInFlight : 1;
     for (int i = 0; i < GBUFFER_PIPELINE_COUNT; i++)
     {
-        pipelinePrimLists[i] = onyx_create_prim_list(8);
+        r->pipelineDraws[i] = draw_arr_create(NULL);
     }
 
-    blas_array = accel_struct_arr_create(NULL);
+    r->blas_array = accel_struct_arr_create(NULL);
+    r->blasGeos   = blas_key_arr_create(NULL);
 
-    device = onyx_get_device(instance);
-    graphic_queue_family_index =
-        onyx_queue_family_index(instance, ONYX_QUEUE_GRAPHICS_TYPE);
-    memory = memory_;
+    r->cameraMirror    = (UploadMirror){.elem_size = sizeof(Camera)};
+    r->instancesMirror = (UploadMirror){.elem_size = sizeof(DrawInstance)};
+    r->instancePrims   = prim_handle_arr_create(NULL);
+    r->lightsMirror    = (UploadMirror){.elem_size = sizeof(Light)};
+    r->materialsMirror = (UploadMirror){.elem_size = sizeof(Material)};
 
-    uint32_t width, height;
-    VkFormat format;
-    width = onyx_get_swapchain_width(swapchain);
-    height = onyx_get_swapchain_height(swapchain);
-    format = onyx_get_swapchain_format(swapchain);
+    r->device = onyx_get_device(r->instance);
+    r->graphic_queue_family_index =
+        onyx_queue_family_index(r->instance, ONYX_QUEUE_GRAPHICS_TYPE);
+    r->memory = memory_;
 
+    const VkFormat format = onyx_get_swapchain_format(swapchain);
 
-    initAttachments(width, height);
-    hell_print(">> Woad: attachments initialized. \n");
-    initGbufRenderPass();
-    onyx_create_render_pass_color(device, VK_IMAGE_LAYOUT_UNDEFINED,
-                                finalColorLayout, VK_ATTACHMENT_LOAD_OP_CLEAR,
-                                format, &deferredRenderPass);
-    hell_print(">> Woad: renderpasses initialized. \n");
-    initGbufferFramebuffer(width, height);
-    for (int i = 0; i < 2; i++)
-    {
-        WoadFrame f = {
-            .dirty = true,
-            .format = format,
-            .width = width,
-            .height = height,
-            .index = i,
-            .view = onyx_get_swapchain_image_view(swapchain, i),
-        };
-        initSwapFramebuffer(&f);
+    pthread_mutex_lock(&shared.lock);
+    if (shared.refs++ == 0)
+    {
+        shared.device    = r->device;
+        shared.blasCache = blas_entry_arr_create(NULL);
+        for (int v = 0; v < MAX_VIEWS; v++)
+            shared.gbufferPermutations[v] = permutation_arr_create(NULL);
+        initSharedLayouts();
+        const VkSamplerCreateInfo samplerInfo = {
+            .sType        = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+            .magFilter    = VK_FILTER_NEAREST,
+            .minFilter    = VK_FILTER_NEAREST,
+            .mipmapMode   = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+            .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE};
+        V_ASSERT(vkCreateSampler(shared.device, &samplerInfo, NULL,
+                                 &shared.litSampler));
+        hell_print(">> Woad: shared layouts initialized. \n");
     }
-    hell_print(">> Woad: framebuffers initialized. \n");
-    initDescriptorSetsAndPipelineLayouts();
-    hell_print(">> Woad: descriptor sets and pipeline layouts initialized. \n");
-    updateDescriptors();
+    assert(shared.device == r->device &&
+           "all woad renderers must share a device");
+    const uint8_t v = r->viewCount - 1;
+    if (shared.gbufferRenderPass[v] == VK_NULL_HANDLE)
+        initGbufRenderPass(r->viewCount, false, false,
+                           &shared.gbufferRenderPass[v]);
+    if (r->visibilityBuffer && shared.visibilityRenderPass[v] == VK_NULL_HANDLE)
+    {
+        initVisibilityRenderPass(r->viewCount);
+        initGbufRenderPass(r->viewCount, true, true,
+                           &shared.gbufferLoadRenderPass[v]);
+    }
+    // the depth prepass can be turned on at any frame, so everything it
+    // needs is made up front
+    if (!r->visibilityBuffer && shared.depthRenderPass[v] == VK_NULL_HANDLE)
+        initDepthRenderPass(r->viewCount);
+    if (!r->visibilityBuffer && !r->forward &&
+        shared.gbufferPrepassedRenderPass[v] == VK_NULL_HANDLE)
+        initGbufRenderPass(r->viewCount, false, true,
+                           &shared.gbufferPrepassedRenderPass[v]);
+    pthread_mutex_unlock(&shared.lock);
+
+    // with one view the lit image is only ever sampled by the composite
+    // pass. compute shading stores to it in between, so it stays general.
+    r->litFormat = format;
+    r->litLayout = r->viewCount > 1 ? finalColorLayout
+                   : r->computeShading
+                       ? VK_IMAGE_LAYOUT_GENERAL
+                       : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    r->finalColorLayout = finalColorLayout;
+    // the swapchain encodes what is stored in an srgb lit image on the way
+    // out, so readbacks of it do that themselves
+    r->litLinear = format == VK_FORMAT_B8G8R8A8_SRGB ||
+                   format == VK_FORMAT_R8G8B8A8_SRGB ||
+                   format == VK_FORMAT_A8B8G8R8_SRGB_PACK32;
+    if (r->computeShading)
+        r->litFormat = storableFormat(r, format);
+    else if (r->forward)
+        initForwardRenderPass(r, r->litLayout, format);
+    else
+        initDeferredRenderPass(r, r->litLayout, format);
+    if (r->viewCount == 1 && !r->dynamicRendering)
+        onyx_create_render_pass_color(r->device, VK_IMAGE_LAYOUT_UNDEFINED,
+                                    finalColorLayout, VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                                    format, &r->compositeRenderPass);
+    hell_print(">> Woad: renderpasses initialized. \n");
+    // attachments and framebuffers are made by the first woad_Render of each
+    // frame slot, sized to the frame it is given
+    r->retired   = retired_arr_create(NULL);
+    r->imagePool = layered_image_arr_create(NULL);
+    r->deferredPermutations = permutation_arr_create(NULL);
+    for (int i = 0; i < r->gbufferCount; i++)
+        initFrameGraph(r, &r->gbuffers[i]);
+    // the first frame draws everything
+    markDirty(r, RECT_FULL);
+    initDescriptorSets(r);
+    hell_print(">> Woad: descriptor sets initialized. \n");
+    initGbufferCache(r);
+    updateDescriptors(r);
     hell_print(">> Woad: descriptors updated. \n");
-    initPipelines(false);
+    pthread_mutex_lock(&shared.lock);
+    initPipelines(r, format, false);
+    pthread_mutex_unlock(&shared.lock);
     hell_print(">> Woad: pipelines initialized. \n");
     hell_print(">> Woad: initialization complete. \n");
+    return r;
 }
 
 void
-woad_Cleanup(void)
+woad_Cleanup(WoadRenderer* r)
 {
+    vkDestroyPipeline(r->device, r->defferedPipeline, NULL);
+    for (int i = 0; i < r->deferredPermutations.count; i++)
+        vkDestroyPipeline(r->device, r->deferredPermutations.elems[i].pipeline,
+                          NULL);
+    permutation_arr_free(&r->deferredPermutations);
+    for (int i = 0; r->forward && i < GBUFFER_PIPELINE_COUNT; i++)
+        vkDestroyPipeline(r->device, r->forwardPipelines[i], NULL);
+    if (r->compositePipeline != VK_NULL_HANDLE)
+        vkDestroyPipeline(r->device, r->compositePipeline, NULL);
+    for (int i = 0; i < MAX_READBACK_RING; i++)
+        if (r->readbacks[i].info.size > 0)
+            onyx_free_buffer(&r->readbacks[i].buffer);
+    pthread_mutex_lock(&shared.lock);
+    for (int i = 0; i < r->blasGeos.count; i++)
+        releaseBlas(r, &r->blasGeos.elems[i]);
+    pthread_mutex_unlock(&shared.lock);
+    blas_key_arr_free(&r->blasGeos);
+    accel_struct_arr_free(&r->blas_array);
     for (int i = 0; i < GBUFFER_PIPELINE_COUNT; i++)
+        draw_arr_free(&r->pipelineDraws[i]);
+    free(r->drawSortScratch);
+    free(r->primBounds);
+    free(r->instanceScratch);
+    free(r->instanceLods);
+    prim_handle_arr_free(&r->instancePrims);
+    vkDestroyCommandPool(r->device, r->gbufferCachePool, NULL);
+    UploadMirror* mirrors[] = {&r->cameraMirror, &r->instancesMirror,
+                               &r->lightsMirror, &r->materialsMirror};
+    for (int i = 0; i < LEN(mirrors); i++)
+    {
+        free(mirrors[i]->elems);
+        free(mirrors[i]->dirty);
+    }
+    for (int i = 0; i < r->framesInFlight; i++)
     {
-        vkDestroyPipeline(device, gbufferPipelines[i], NULL);
+        if (r->tlas[i].buffer_region.size != 0)
+            onyx_destroy_acceleration_struct(r->device, &r->tlas[i]);
+        onyx_free_buffer(&r->cameraBuffers[i]);
+        onyx_free_buffer(&r->instancesBuffers[i]);
+        onyx_free_buffer(&r->lightsBuffers[i]);
+        onyx_free_buffer(&r->materialsBuffers[i]);
+        onyx_free_buffer(&r->stagingRing[i].buffer);
+        onyx_free_buffer(&r->feedbackBuffers[i]);
     }
-    vkDestroyPipeline(device, defferedPipeline, NULL);
-    vkDestroyPipeline(device, raytracePipeline, NULL);
-    AccelerationStructure* blasses = blas_array.elems;
-    for (int i = 0; i < blas_array.count; i++)
+    for (int i = 0; i < r->gbufferCount; i++)
     {
-        AccelerationStructure* blas = &blasses[i];
-        if (blas->buffer_region.size != 0)
-            onyx_destroy_acceleration_struct(device, blas);
+        graph_Free(&r->gbuffers[i].graph);
+        if (r->gbuffers[i].width == 0)
+            continue;
+        freeImages(r, &r->gbuffers[i]);
+        if (!r->forward)
+            onyx_destroy_framebuffer(r->device, r->gbuffers[i].framebuffer);
+        if (!r->visibilityBuffer)
+            onyx_destroy_framebuffer(r->device,
+                                     r->gbuffers[i].depthFramebuffer);
+        if (r->visibilityBuffer)
+            onyx_destroy_framebuffer(r->device,
+                                     r->gbuffers[i].visibilityFramebuffer);
+    }
+    for (int i = 0; i < MAX_SWAPCHAIN_IMAGES; i++)
+    {
+        if (r->swapImageBuffer[i] != VK_NULL_HANDLE)
+            onyx_destroy_framebuffer(r->device, r->swapImageBuffer[i]);
     }
-    onyx_destroy_shader_binding_table(&shaderBindingTable);
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    for (int i = 0; i < r->framesInFlight; i++)
     {
-        if (tlas[i].buffer_region.size != 0)
-            onyx_destroy_acceleration_struct(device, &tlas[i]);
-        vkDestroyDescriptorPool(device, descriptorPool, NULL);
-        vkDestroyDescriptorSetLayout(device, descriptorSetLayouts[i], NULL);
-        onyx_free_buffer(&cameraBuffers[i]);
-        onyx_free_buffer(&xformsBuffers[i]);
-        onyx_free_buffer(&lightsBuffers[i]);
-        onyx_free_buffer(&materialsBuffers[i]);
+        if (r->litImages[i].width == 0)
+            continue;
+        if (!r->computeShading)
+            onyx_destroy_framebuffer(r->device, r->litBuffers[i]);
+        freeLayeredImage(r, &r->litImages[i]);
     }
-    vkDestroyRenderPass(device, gbufferRenderPass, NULL);
-    vkDestroyRenderPass(device, deferredRenderPass, NULL);
-    vkDestroyPipelineLayout(device, pipelineLayout, NULL);
+    // the caller has waited for every frame by now
+    r->renderCount = UINT64_MAX;
+    collectRetired(r);
+    retired_arr_free(&r->retired);
+    for (int i = 0; i < r->imagePool.count; i++)
+        freeLayeredImage(r, &r->imagePool.elems[i]);
+    layered_image_arr_free(&r->imagePool);
+    vkDestroyDescriptorPool(r->device, r->descriptorPool, NULL);
+    if (r->deferredRenderPass != VK_NULL_HANDLE)
+        vkDestroyRenderPass(r->device, r->deferredRenderPass, NULL);
+    if (r->forwardRenderPass != VK_NULL_HANDLE)
+        vkDestroyRenderPass(r->device, r->forwardRenderPass, NULL);
+    if (r->compositeRenderPass != VK_NULL_HANDLE)
+        vkDestroyRenderPass(r->device, r->compositeRenderPass, NULL);
+    free(r);
+
+    pthread_mutex_lock(&shared.lock);
+    assert(shared.refs > 0);
+    if (--shared.refs == 0)
+    {
+        VkDevice device = shared.device;
+        for (int v = 0; v < MAX_VIEWS; v++)
+        {
+            if (shared.gbufferRenderPass[v] == VK_NULL_HANDLE)
+                continue;
+            for (int i = 0; i < GBUFFER_PIPELINE_COUNT; i++)
+                vkDestroyPipeline(device, shared.gbufferPipelines[v][i], NULL);
+            for (int i = 0; i < shared.gbufferPermutations[v].count; i++)
+                vkDestroyPipeline(
+                    device, shared.gbufferPermutations[v].elems[i].pipeline,
+                    NULL);
+            vkDestroyRenderPass(device, shared.gbufferRenderPass[v], NULL);
+            if (shared.gbufferPrepassedRenderPass[v] != VK_NULL_HANDLE)
+                vkDestroyRenderPass(device,
+                                    shared.gbufferPrepassedRenderPass[v], NULL);
+            if (shared.depthRenderPass[v] != VK_NULL_HANDLE)
+            {
+                for (int i = 0; i < GBUFFER_PIPELINE_COUNT; i++)
+                    vkDestroyPipeline(device, shared.depthPipelines[v][i],
+                                      NULL);
+                vkDestroyRenderPass(device, shared.depthRenderPass[v], NULL);
+            }
+            if (shared.visibilityRenderPass[v] == VK_NULL_HANDLE)
+                continue;
+            vkDestroyPipeline(device, shared.visibilityPipelines[v], NULL);
+            vkDestroyRenderPass(device, shared.visibilityRenderPass[v], NULL);
+            vkDestroyRenderPass(device, shared.gbufferLoadRenderPass[v], NULL);
+        }
+        if (shared.resolvePipeline != VK_NULL_HANDLE)
+            vkDestroyPipeline(device, shared.resolvePipeline, NULL);
+        if (shared.lightCullPipeline != VK_NULL_HANDLE)
+            vkDestroyPipeline(device, shared.lightCullPipeline, NULL);
+        if (shared.readbackPipeline != VK_NULL_HANDLE)
+            vkDestroyPipeline(device, shared.readbackPipeline, NULL);
+        if (shared.raytracePipeline != VK_NULL_HANDLE)
+        {
+            vkDestroyPipeline(device, shared.raytracePipeline, NULL);
+            onyx_destroy_shader_binding_table(&shared.shaderBindingTable);
+        }
+        assert(shared.blasCache.count == 0);
+        blas_entry_arr_free(&shared.blasCache);
+        for (int v = 0; v < MAX_VIEWS; v++)
+            permutation_arr_free(&shared.gbufferPermutations[v]);
+        for (int i = 0; i < DESC_SET_COUNT; i++)
+            vkDestroyDescriptorSetLayout(device, shared.descriptorSetLayouts[i],
+                                         NULL);
+        vkDestroyPipelineLayout(device, shared.pipelineLayout, NULL);
+        vkDestroySampler(device, shared.litSampler, NULL);
+        // the next woad_Init starts over
+        memset(shared.gbufferRenderPass, 0, sizeof(shared.gbufferRenderPass));
+        memset(shared.gbufferPipelines, 0, sizeof(shared.gbufferPipelines));
+        memset(shared.visibilityRenderPass, 0,
+               sizeof(shared.visibilityRenderPass));
+        memset(shared.gbufferLoadRenderPass, 0,
+               sizeof(shared.gbufferLoadRenderPass));
+        memset(shared.visibilityPipelines, 0,
+               sizeof(shared.visibilityPipelines));
+        memset(shared.gbufferPrepassedRenderPass, 0,
+               sizeof(shared.gbufferPrepassedRenderPass));
+        memset(shared.depthRenderPass, 0, sizeof(shared.depthRenderPass));
+        memset(shared.depthPipelines, 0, sizeof(shared.depthPipelines));
+        shared.lightCullPipeline  = VK_NULL_HANDLE;
+        shared.readbackPipeline   = VK_NULL_HANDLE;
+        shared.resolvePipeline    = VK_NULL_HANDLE;
+        shared.raytracePipeline   = VK_NULL_HANDLE;
+        shared.shaderBindingTable = (OnyxShaderBindingTable){0};
+        shared.litSampler         = VK_NULL_HANDLE;
+        shared.device             = VK_NULL_HANDLE;
+    }
+    pthread_mutex_unlock(&shared.lock);
 }
 
-WoadFrame
-woad_Frame(const OnyxSwapchainImage *img)
+void
+woad_SetViews(WoadRenderer* r, uint8_t count, const WoadView* views)
 {
-    // track uuid for each swapimage
-    static int64_t last_img_uuids[2] = {-1, -1};
+    assert(count == r->viewCount);
+    memcpy(r->views, views, sizeof(WoadView) * count);
+    r->viewsSet   = true;
+    r->viewsDirty = true;
+}
+
+void
+woad_SetDepthPrepass(WoadRenderer* r, bool enable)
+{
+    // the other modes draw depth first already
+    enable = enable && !r->visibilityBuffer && !r->forward;
+    if (enable == r->depthPrepass)
+        return;
+    r->depthPrepass = enable;
+    // the recorded gbuffer draws carry the depth test
+    invalidateGbufferCache(r);
+}
+
+void
+woad_SetReadback(WoadRenderer* r, uint8_t ring_size, WoadReadbackFormat format,
+                 WoadReadbackFn callback, void* user)
+{
+    // an entry is rewritten only once the frame it held has completed
+    assert(!callback || ring_size > r->framesInFlight);
+    assert(!callback || ring_size <= MAX_READBACK_RING);
+    assert(format == WOAD_READBACK_RAW || r->viewCount == 1);
+    for (int i = 0; i < MAX_READBACK_RING; i++)
+    {
+        if (r->readbacks[i].info.size > 0)
+            onyx_free_buffer(&r->readbacks[i].buffer);
+        r->readbacks[i] = (Readback){0};
+    }
+    r->readbackFn       = callback;
+    r->readbackUser     = user;
+    r->readbackFormat   = format;
+    r->readbackRingSize = ring_size;
+    if (!callback || format != WOAD_READBACK_NV12)
+        return;
+
+    pthread_mutex_lock(&shared.lock);
+    if (shared.readbackPipeline == VK_NULL_HANDLE)
+    {
+        ByteArray code;
+        if (hell_read_file(WOAD_SPV_PREFIX "/readback.comp.spv", &code))
+            fatal_error("Error reading spv files.");
+        const OnyxShaderInfo shader = {.byte_count  = code.count,
+                                       .code        = (void*)code.elems,
+                                       .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                                       .entry_point = "main"};
+        initComputePipeline(r, &shader, &shared.readbackPipeline);
+    }
+    pthread_mutex_unlock(&shared.lock);
+}
+
+// routes each readback of a batch to its pose's target
+typedef struct {
+    const WoadBatch* batch;
+    uint64_t         firstFrame;
+} BatchDelivery;
 
+static void
+deliverBatchReadback(void* user, const WoadReadback* readback)
+{
+    const BatchDelivery* d = user;
+    d->batch->callback(d->batch->targets[readback->frame - d->firstFrame],
+                       readback);
+}
+
+void
+woad_RenderBatch(WoadRenderer* r, const OnyxScene* scene,
+                 const WoadBatch* batch)
+{
+    const uint8_t            inFlight   = r->framesInFlight;
+    // put back once the batch is done
+    const WoadReadbackFn     prevFn     = r->readbackFn;
+    void* const              prevUser   = r->readbackUser;
+    const WoadReadbackFormat prevFormat = r->readbackFormat;
+    const uint8_t            prevRing   = r->readbackRingSize;
+    const bool               prevSet    = r->viewsSet;
+    WoadView                 prevViews[MAX_VIEWS];
+    memcpy(prevViews, r->views, sizeof(prevViews));
+
+    // each readback is handed over as woad_Render records the frame that
+    // reuses its slot, so one more entry than frames in flight suffices
+    BatchDelivery delivery = {.batch      = batch,
+                              .firstFrame = r->renderCount + 1};
+    woad_SetReadback(r, inFlight + 1, batch->format, deliverBatchReadback,
+                     &delivery);
+
+    OnyxCommandPool pool = onyx_create_command_pool_(
+        r->device, r->graphic_queue_family_index,
+        VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, inFlight);
+    VkFence fences[MAX_FRAMES_IN_FLIGHT];
+    const VkFenceCreateInfo fenceInfo = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    for (int i = 0; i < inFlight; i++)
+        V_ASSERT(vkCreateFence(r->device, &fenceInfo, NULL, &fences[i]));
+    VkQueue queue = onyx_get_graphics_queue(r->instance, 0);
+
+    // no swapchain image, so only the lit image is written
+    const WoadFrame frame = {.width  = batch->width,
+                             .height = batch->height};
+    for (uint32_t i = 0; i < batch->count; i++)
+    {
+        const uint32_t slot = i % inFlight;
+        if (i >= inFlight)
+        {
+            V_ASSERT(vkWaitForFences(r->device, 1, &fences[slot], VK_TRUE,
+                                     UINT64_MAX));
+            V_ASSERT(vkResetFences(r->device, 1, &fences[slot]));
+        }
+        // only the cameras change, so the scene's buffers, blas and tlas
+        // are uploaded and built once for the whole batch
+        woad_SetViews(r, r->viewCount, &batch->views[i * r->viewCount]);
+
+        VkCommandBuffer cmd = pool.cmdbufs[slot];
+        onyx_begin_command_buffer_one_time_submit(cmd);
+        woad_Render(r, scene, &frame, 0, 0, batch->width, batch->height,
+                    cmd);
+        onyx_end_command_buffer(cmd);
+        const VkSubmitInfo info =
+            onyx_submit_info(0, NULL, NULL, 1, &cmd, 0, NULL);
+        pthread_mutex_lock(&shared.lock);
+        V_ASSERT(vkQueueSubmit(queue, 1, &info, fences[slot]));
+        pthread_mutex_unlock(&shared.lock);
+    }
+
+    // the last frames are never reused, so they are handed over here
+    const uint32_t pending = batch->count < inFlight ? batch->count : inFlight;
+    if (pending > 0)
+        V_ASSERT(vkWaitForFences(r->device, pending, fences, VK_TRUE,
+                                 UINT64_MAX));
+    for (uint32_t i = pending; i > 0; i--)
+        deliverReadback(r, r->renderCount - i + 1);
+
+    for (int i = 0; i < inFlight; i++)
+        vkDestroyFence(r->device, fences[i], NULL);
+    onyx_destroy_command_pool(r->device, &pool);
+    woad_SetReadback(r, prevRing, prevFormat, prevFn, prevUser);
+    // so the next woad_Render uploads the cameras from before the batch
+    memcpy(r->views, prevViews, sizeof(prevViews));
+    r->viewsSet   = prevSet;
+    r->viewsDirty = true;
+}
+
+void
+woad_SetSceneCache(WoadRenderer* r, WoadSceneCache* cache)
+{
+    r->sceneCache = cache;
+}
+
+VkImage
+woad_GetViewImage(const WoadRenderer* r, VkImageView* view)
+{
+    const LayeredImage* img = &r->litImages[r->lastFrameIndex];
+    if (view)
+        *view = img->view;
+    return img->handle;
+}
+
+WoadFrame
+woad_Frame(WoadRenderer* r, const OnyxSwapchainImage *img)
+{
     const uint32_t idx = img->index;
+    assert(idx < MAX_SWAPCHAIN_IMAGES);
     int64_t cur_uuid = img->swapchain->image_uuid[idx];
 
-    bool dirty = last_img_uuids[idx] != cur_uuid;
-    last_img_uuids[idx] = cur_uuid;
+    bool dirty = !r->swapImageSeen[idx] || r->swapImageUuids[idx] != cur_uuid;
+    r->swapImageUuids[idx] = cur_uuid;
+    r->swapImageSeen[idx]  = true;
 
     WoadFrame f = {
         .dirty = dirty,
@@ -1510,6 +5508,7 @@ woad_Frame(const OnyxSwapchainImage *img)
         .height = onyx_get_swapchain_height(img->swapchain),
         .index = idx,
         .view = onyx_get_swapchain_image_view(img->swapchain, idx),
+        .image = onyx_get_swapchain_image(img->swapchain, idx),
     };
 
     return f;